@@ -1,8 +1,50 @@
 #include "viewer_facade/viewer_facade.h"
 
 int main(int argc, char *argv[]) {
+  bool benchmark = argc > 2 && QString(argv[1]) == "--benchmark";
+  bool render = argc > 3 && QString(argv[1]) == "--render";
+  bool lineBenchmark = argc > 1 && QString(argv[1]) == "--line-benchmark";
+  bool turntable = argc > 3 && QString(argv[1]) == "--turntable";
+  // Сравнение путей отрисовки и отрисовка в файл выполняются на
+  // программном растеризаторе Mesa (llvmpipe), чтобы результаты не
+  // зависели от видеокарты.
+  bool softwareGL = benchmark || render;
+  if (softwareGL && !qEnvironmentVariableIsSet("LIBGL_ALWAYS_SOFTWARE"))
+    qputenv("LIBGL_ALWAYS_SOFTWARE", "1");
+  // Отрисовка в файл не требует дисплея: окно не показывается, а кадр
+  // строится на внеэкранной поверхности.
+  bool headless = render || lineBenchmark || turntable;
+  if (headless && !qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+    qputenv("QT_QPA_PLATFORM", "offscreen");
   QApplication a(argc, argv);
   s21::ViewerFacade viewerFacade;
+  if (benchmark) {
+    int frames = argc > 3 ? QString(argv[3]).toInt() : 100;
+    return viewerFacade.runBenchmark(QString(argv[2]), frames);
+  }
+  if (render) {
+    int width = argc > 4 ? QString(argv[4]).toInt() : 1920;
+    int height = argc > 5 ? QString(argv[5]).toInt() : 1080;
+    return viewerFacade.renderImage(QString(argv[2]), QString(argv[3]),
+                                    QSize(width, height));
+  }
+  if (lineBenchmark) {
+    qulonglong edges = argc > 2 ? QString(argv[2]).toULongLong() : 1000000;
+    return viewerFacade.runLineBenchmark(static_cast<size_t>(edges));
+  }
+  if (turntable) {
+    // --turntable <obj> <gif> [кадры] [ось x|y|z] [ширина высота]
+    TurntableSettings_t settings;
+    if (argc > 4) settings.frames = QString(argv[4]).toInt();
+    if (argc > 5) {
+      QString axis = QString(argv[5]).toLower();
+      settings.axis = axis == "x" ? AxisX : axis == "z" ? AxisZ : AxisY;
+    }
+    if (argc > 7)
+      settings.size = QSize(QString(argv[6]).toInt(), QString(argv[7]).toInt());
+    return viewerFacade.exportTurntable(QString(argv[2]), QString(argv[3]),
+                                        settings);
+  }
   viewerFacade.startViewer();
   return a.exec();
-}
\ No newline at end of file
+}
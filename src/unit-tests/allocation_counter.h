@@ -0,0 +1,37 @@
+#ifndef ALLOCATION_COUNTERH
+#define ALLOCATION_COUNTERH
+
+#include <cstdlib>
+#include <new>
+
+// Счетчик выделений памяти для проверки кода без аллокаций. Выделения
+// считаются только в потоке и только пока открыта AllocationScope; в
+// остальное время замена operator new ведет себя как стандартная.
+// Заголовок подключается в одном файле каждой тестовой программы.
+static long allocationCount = 0;
+static thread_local bool countAllocations = false;
+
+void *operator new(std::size_t size) {
+  if (countAllocations) ++allocationCount;
+  for (;;) {
+    if (void *memory = std::malloc(size ? size : 1)) return memory;
+    std::new_handler handler = std::get_new_handler();
+    if (!handler) throw std::bad_alloc();
+    handler();
+  }
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+
+void operator delete(void *memory, std::size_t) noexcept { std::free(memory); }
+
+/**
+ * @brief Подсчет выделений памяти текущего потока в пределах области
+ */
+class AllocationScope {
+ public:
+  AllocationScope() { countAllocations = true; }
+  ~AllocationScope() { countAllocations = false; }
+};
+
+#endif
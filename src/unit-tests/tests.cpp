@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
 
+#include <cstdio>
+
 #include "../viewer_model/viewer_model.h"
+#include "allocation_counter.h"
 
 class ViewerModelTest : public ::testing::Test {};
 
@@ -106,4 +109,421 @@ TEST_F(ViewerModelTest, loadobj) {
   QString text = "123.45";
   float float_num = model.makeFloat(text);
   EXPECT_EQ(float_num, 123.45f);
-}
\ No newline at end of file
+}
+TEST_F(ViewerModelTest, Test_Quaternion) {
+  s21::ViewerModel model;
+  model.rotateAxis(rotateYPlus, 90.0f);
+  QVector3D v = model.getModelMatrix().map(QVector3D(1.0f, 0.0f, 0.0f));
+  EXPECT_NEAR(v.x(), 0.0f, 1e-5);
+  EXPECT_NEAR(v.z(), -1.0f, 1e-5);
+  model.rotateAxis(rotateYMinus, 90.0f);
+  v = model.getModelMatrix().map(QVector3D(1.0f, 0.0f, 0.0f));
+  EXPECT_NEAR(v.x(), 1.0f, 1e-5);
+  model.MouseButtonMove(QPoint(0, 90));
+  v = model.getModelMatrix().map(QVector3D(0.0f, 1.0f, 0.0f));
+  EXPECT_NEAR(v.z(), 1.0f, 1e-5);
+  model.MouseWheelMove(QPoint(90, 0));
+  EXPECT_NEAR(model.getAffineTransform().orientation.length(), 1.0f, 1e-5);
+  model.setDefault(0);
+  EXPECT_TRUE(model.getModelMatrix().isIdentity());
+}
+
+TEST_F(ViewerModelTest, Test_DirtyFlags) {
+  s21::ViewerModel model;
+  EXPECT_EQ(model.getDirtyFlags(), static_cast<unsigned int>(DirtyAll));
+  model.clearDirtyFlags(DirtyAll);
+  EXPECT_EQ(model.getDirtyFlags(), static_cast<unsigned int>(DirtyNone));
+  model.setBackGroundColor(QColor(Qt::red));
+  EXPECT_EQ(model.getDirtyFlags(), static_cast<unsigned int>(DirtyStyle));
+  model.clearDirtyFlags(DirtyStyle);
+  model.translateFigure(translateXPlus, 1.0f);
+  model.setProjection(Perspective);
+  EXPECT_EQ(model.getDirtyFlags(), static_cast<unsigned int>(DirtyTransform));
+  model.clearDirtyFlags(DirtyAll);
+  model.loadOBJ("../samples/boat.obj");
+  EXPECT_TRUE(model.getDirtyFlags() & DirtyGeometry);
+}
+
+TEST_F(ViewerModelTest, Test_DeltaUndo) {
+  s21::ViewerModel model;
+  QQuaternion rotation = s21::ViewerModel::arcballRotation(QPoint(30, -40));
+  model.applyRotation(rotation);
+  model.applyRotation(rotation.conjugated());
+  QQuaternion orientation = model.getAffineTransform().orientation;
+  EXPECT_NEAR(orientation.scalar(), 1.0f, 1e-5);
+  EXPECT_NEAR(orientation.vector().length(), 0.0f, 1e-5);
+  model.setProjection(Parallel);
+  model.scaleFigure(scalePlus, 20.0f);
+  float scaleDelta = model.getAffineTransform().scaleFactor - 1.0f;
+  model.adjustScale(-scaleDelta, 0.0f);
+  EXPECT_FLOAT_EQ(model.getAffineTransform().scaleFactor, 1.0f);
+  model.setFacetWidthValue(0.01f);
+  EXPECT_FLOAT_EQ(model.getModelDefinition().facetWidth, 0.01f);
+  model.setDefault(1);
+}
+
+TEST_F(ViewerModelTest, Test_Edges) {
+  s21::ViewerModel model;
+  model.loadOBJ("../samples/boat.obj");
+  const std::vector<unsigned int> &edges = model.getEdges();
+  ASSERT_FALSE(edges.empty());
+  EXPECT_EQ(edges.size() % 2, 0u);
+  // ребра переставлены по частям сетки, но образуют тот же замкнутый контур
+  const std::vector<unsigned int> &facets = model.getFacets();
+  std::vector<std::pair<unsigned int, unsigned int>> expected, actual;
+  for (size_t i = 0; i < facets.size(); ++i)
+    expected.emplace_back(facets[i], facets[(i + 1) % facets.size()]);
+  for (size_t i = 0; i < edges.size(); i += 2)
+    actual.emplace_back(edges[i], edges[i + 1]);
+  std::sort(expected.begin(), expected.end());
+  std::sort(actual.begin(), actual.end());
+  EXPECT_EQ(actual, expected);
+  unsigned long long generation = model.getMeshGeneration();
+  model.translateFigure(translateXPlus, 1.0f);
+  EXPECT_EQ(model.getMeshGeneration(), generation);
+}
+
+TEST_F(ViewerModelTest, Test_ThickEdgeCache) {
+  s21::ViewerModel model;
+  model.loadOBJ("../samples/boat.obj");
+  model.setFacetWidthValue(0.01f);
+  const std::vector<float> &quads = model.getThickEdgeQuads();
+  ASSERT_EQ(quads.size(), model.getEdges().size() / 2 * 12);
+  QVector3D p1(quads[0], quads[1], quads[2]);
+  QVector3D p2(quads[3], quads[4], quads[5]);
+  EXPECT_NEAR((p2 - p1).length(), 0.01f, 1e-5);
+  model.translateFigure(translateXPlus, 1.0f);
+  model.getThickEdgeQuads();
+  EXPECT_EQ(model.getThickEdgeRebuildCount(), 1);
+  model.setFacetWidthValue(0.02f);
+  model.getThickEdgeQuads();
+  EXPECT_EQ(model.getThickEdgeRebuildCount(), 2);
+}
+
+TEST_F(ViewerModelTest, Test_ChunkCulling) {
+  s21::ViewerModel model;
+  model.loadOBJ("../samples/boat.obj");
+  const std::vector<MeshChunk_t> &chunks = model.getChunks();
+  ASSERT_FALSE(chunks.empty());
+  size_t covered = 0;
+  for (const MeshChunk_t &chunk : chunks) covered += chunk.edgeCount;
+  EXPECT_EQ(covered, model.getEdges().size() / 2);
+  std::vector<EdgeRange_t> ranges;
+  QMatrix4x4 mvp = model.getProjectionMatrix(1.0f) * model.getModelMatrix();
+  EXPECT_EQ(model.collectVisibleEdges(mvp, ranges),
+            static_cast<int>(chunks.size()));
+  ASSERT_EQ(ranges.size(), 1u);
+  EXPECT_EQ(ranges[0].edgeCount, covered);
+  mvp.translate(100.0f, 0.0f, 0.0f);
+  EXPECT_EQ(model.collectVisibleEdges(mvp, ranges), 0);
+  EXPECT_TRUE(ranges.empty());
+}
+
+TEST_F(ViewerModelTest, Test_InteractionLod) {
+  s21::ViewerModel model;
+  model.loadOBJ("../samples/boat.obj");
+  size_t edgeCount = model.getEdges().size() / 2;
+  EXPECT_TRUE(model.getLodEdges(edgeCount).empty());
+  EXPECT_TRUE(model.getLodEdges(0).empty());
+  const std::vector<unsigned int> &lod = model.getLodEdges(1000);
+  EXPECT_GT(lod.size(), 0u);
+  EXPECT_LE(lod.size() / 2, 1000u);
+  unsigned long long revision = model.getLodRevision();
+  model.getLodEdges(1000);
+  EXPECT_EQ(model.getLodRevision(), revision);
+}
+
+TEST_F(ViewerModelTest, Test_SubPixelCulling) {
+  s21::ViewerModel model;
+  model.loadOBJ("../samples/boat.obj");
+  size_t edgeCount = model.getEdges().size() / 2;
+  QMatrix4x4 mvp = model.getProjectionMatrix(1.0f) * model.getModelMatrix();
+  std::vector<EdgeRange_t> ranges;
+  model.collectVisibleEdges(mvp, ranges);
+  std::vector<unsigned int> kept;
+  EXPECT_EQ(model.cullSubPixelEdges(mvp, QSizeF(1, 1), 4.0f, ranges, kept),
+            edgeCount);
+  EXPECT_TRUE(kept.empty());
+  size_t culled =
+      model.cullSubPixelEdges(mvp, QSizeF(1e6, 1e6), 1.0f, ranges, kept);
+  EXPECT_EQ(culled + kept.size() / 2, edgeCount);
+  EXPECT_GT(kept.size() / 2, culled);
+}
+
+TEST_F(ViewerModelTest, Test_WorkerPool) {
+  std::vector<long long> values(1 << 20);
+  for (size_t i = 0; i < values.size(); ++i) values[i] = i;
+  long long expected = static_cast<long long>(values.size()) *
+                       (static_cast<long long>(values.size()) - 1) / 2;
+  s21::WorkerPool pool;
+  for (int run = 0; run < 20; ++run) {
+    std::atomic<long long> sum{0};
+    auto add = [&](size_t begin, size_t end) {
+      long long part = 0;
+      for (size_t i = begin; i < end; ++i) part += values[i];
+      sum += part;
+    };
+    // потоки создаются при первом запуске, дальше задания не выделяют память
+    if (run == 0) {
+      pool.run(values.size(), 4096, add);
+    } else {
+      allocationCount = 0;
+      AllocationScope scope;
+      pool.run(values.size(), 4096, add);
+    }
+    EXPECT_EQ(sum.load(), expected);
+    if (run > 0) EXPECT_EQ(allocationCount, 0);
+  }
+}
+
+TEST_F(ViewerModelTest, Test_BmpStreamWriter) {
+  QImage frame(5, 4, QImage::Format_RGB32);
+  for (int y = 0; y < frame.height(); ++y)
+    for (int x = 0; x < frame.width(); ++x)
+      frame.setPixel(x, y, qRgb(x * 50, y * 60, 200));
+  s21::BmpStreamWriter writer;
+  ASSERT_TRUE(writer.open("stream_test.bmp", frame.size()));
+  EXPECT_TRUE(writer.writeRows(frame.copy(0, 0, 5, 3)));
+  EXPECT_FALSE(writer.writeRows(frame.copy(0, 0, 4, 1)));
+  EXPECT_TRUE(writer.writeRows(frame.copy(0, 3, 5, 1)));
+  EXPECT_TRUE(writer.close());
+  QImage loaded("stream_test.bmp");
+  std::remove("stream_test.bmp");
+  ASSERT_EQ(loaded.size(), frame.size());
+  EXPECT_TRUE(loaded.convertToFormat(QImage::Format_RGB32) == frame);
+}
+
+TEST_F(ViewerModelTest, Test_GifEncoder) {
+  // первый кадр - полосы из 16 цветов, чтобы декодирование проверялось
+  // не на одном цвете
+  QImage frame(32, 24, QImage::Format_RGB32);
+  for (int y = 0; y < frame.height(); ++y)
+    for (int x = 0; x < frame.width(); ++x)
+      frame.setPixel(x, y, qRgb(x / 8 * 60, y / 6 * 60, 120));
+  std::vector<QImage> frames;
+  s21::GifStreamWriter writer;
+  ASSERT_TRUE(writer.open("gif_test.gif", frame.size(), 10, 2));
+  for (int i = 0; i < 4; ++i) {
+    if (i == 2)
+      for (int x = 5; x < 9; ++x) frame.setPixel(x, 7, qRgb(255, 255, 0));
+    if (i == 3) frame.setPixel(30, 20, qRgb(0, 0, 0));
+    frames.push_back(frame.copy());
+    writer.push(frames.back());
+  }
+  EXPECT_TRUE(writer.finish());
+  EXPECT_EQ(writer.framesWritten(), 4);
+  // второй кадр не изменился, третий записан прямоугольником 4x1
+  std::vector<uchar> previous, current;
+  std::vector<QRgb> palette;
+  std::vector<uchar> lookup;
+  s21::GifEncoder::buildPalette(frames[0], palette, lookup);
+  s21::GifEncoder::mapToPalette(frames[1], lookup, previous);
+  s21::GifEncoder::mapToPalette(frames[2], lookup, current);
+  EXPECT_EQ(s21::GifEncoder::changedRect(previous, current, frame.size()),
+            QRect(5, 7, 4, 1));
+  // каждый кадр декодируется и сравнивается попиксельно
+  QImageReader reader("gif_test.gif");
+  EXPECT_EQ(reader.imageCount(), 4);
+  for (const QImage &expected : frames) {
+    ASSERT_TRUE(reader.canRead());
+    QImage decoded = reader.read().convertToFormat(QImage::Format_RGB32);
+    ASSERT_EQ(decoded.size(), expected.size());
+    int mismatches = 0;
+    for (int y = 0; y < decoded.height(); ++y)
+      for (int x = 0; x < decoded.width(); ++x)
+        if (decoded.pixel(x, y) != expected.pixel(x, y)) ++mismatches;
+    EXPECT_EQ(mismatches, 0);
+  }
+  std::ifstream file("gif_test.gif", std::ios::binary | std::ios::ate);
+  EXPECT_EQ(static_cast<long long>(file.tellg()), writer.bytesWritten());
+  file.close();
+  std::remove("gif_test.gif");
+}
+
+TEST_F(ViewerModelTest, Test_FrameRing) {
+  s21::FrameRing ring(2);
+  QImage frame(4, 4, QImage::Format_RGB32);
+  for (int i = 0; i < 3; ++i) {
+    frame.fill(qRgb(i, 0, 0));
+    ring.tryPush(frame.copy());
+  }
+  EXPECT_EQ(ring.pushed(), 2);
+  EXPECT_EQ(ring.dropped(), 1);
+  std::thread producer([&ring]() {
+    ring.tryPush(QImage(4, 4, QImage::Format_RGB32));
+    ring.close();
+  });
+  QImage popped;
+  int count = 0;
+  while (ring.pop(popped)) {
+    if (count == 0) EXPECT_EQ(popped.pixel(0, 0), qRgb(0, 0, 0));
+    if (count == 1) EXPECT_EQ(popped.pixel(0, 0), qRgb(1, 0, 0));
+    ++count;
+  }
+  producer.join();
+  EXPECT_GE(count, 2);
+  EXPECT_EQ(count, ring.pushed());
+  EXPECT_FALSE(ring.tryPush(frame));
+}
+
+TEST_F(ViewerModelTest, Test_YuvConversion) {
+  QImage frame(37, 21, QImage::Format_RGB32);
+  for (int y = 0; y < frame.height(); ++y)
+    for (int x = 0; x < frame.width(); ++x)
+      frame.setPixel(x, y, qRgb(x * 7 % 256, y * 13 % 256, (x * y) % 256));
+  std::vector<uchar> scalar, vectorized;
+  s21::Y4mStreamWriter::convertToYuv420(frame, scalar, false);
+  s21::Y4mStreamWriter::convertToYuv420(frame, vectorized, true);
+  ASSERT_EQ(scalar.size(), 37u * 21u + 2u * 19u * 11u);
+  EXPECT_EQ(scalar, vectorized);
+  frame.fill(qRgb(255, 255, 255));
+  s21::Y4mStreamWriter::convertToYuv420(frame, scalar);
+  EXPECT_EQ(scalar.front(), 235);
+  EXPECT_EQ(scalar.back(), 128);
+}
+
+TEST_F(ViewerModelTest, Test_VideoWriters) {
+  QImage frame(40, 30, QImage::Format_RGB32);
+  frame.fill(qRgb(10, 200, 30));
+  s21::Y4mStreamWriter y4m;
+  ASSERT_TRUE(y4m.open("video_test.y4m", QSize(20, 16), 25));
+  for (int i = 0; i < 3; ++i) y4m.push(frame);
+  EXPECT_TRUE(y4m.finish());
+  std::ifstream y4mFile("video_test.y4m", std::ios::binary | std::ios::ate);
+  EXPECT_EQ(static_cast<long long>(y4mFile.tellg()), y4m.bytesWritten());
+  y4mFile.close();
+  std::string header = "YUV4MPEG2 W20 H16 F25:1 Ip A1:1 C420jpeg\n";
+  EXPECT_EQ(y4m.bytesWritten(),
+            static_cast<long long>(header.size() + 3 * (6 + 20 * 16 * 3 / 2)));
+  std::remove("video_test.y4m");
+
+  s21::MjpegAviWriter avi;
+  ASSERT_TRUE(avi.open("video_test.avi", QSize(40, 30), 25));
+  for (int i = 0; i < 3; ++i) avi.push(frame);
+  EXPECT_TRUE(avi.finish());
+  EXPECT_EQ(avi.framesWritten(), 3);
+  std::ifstream aviFile("video_test.avi", std::ios::binary);
+  std::vector<char> bytes((std::istreambuf_iterator<char>(aviFile)),
+                          std::istreambuf_iterator<char>());
+  aviFile.close();
+  std::remove("video_test.avi");
+  ASSERT_EQ(static_cast<long long>(bytes.size()), avi.bytesWritten());
+  EXPECT_EQ(std::string(bytes.data(), 4), "RIFF");
+  EXPECT_EQ(std::string(bytes.data() + 8, 4), "AVI ");
+  auto dword = [&bytes](size_t offset) {
+    unsigned int value = 0;
+    std::memcpy(&value, bytes.data() + offset, 4);
+    return value;
+  };
+  EXPECT_EQ(dword(4), bytes.size() - 8);
+  EXPECT_EQ(dword(48), 3u);
+  std::string contents(bytes.begin(), bytes.end());
+  size_t movi = contents.find("movi");
+  size_t index = contents.find("idx1");
+  ASSERT_NE(index, std::string::npos);
+  // первая запись индекса указывает на первый кадр JPEG
+  unsigned int offset = dword(index + 16), size = dword(index + 20);
+  QImage decoded = QImage::fromData(
+      reinterpret_cast<const uchar *>(bytes.data() + movi + offset + 8),
+      static_cast<int>(size), "JPG");
+  EXPECT_EQ(decoded.size(), QSize(40, 30));
+
+  // при пределе размера лишние кадры отбрасываются, файл остается целым
+  s21::MjpegAviWriter limited;
+  ASSERT_TRUE(limited.open("video_limit.avi", QSize(40, 30), 25));
+  limited.setSizeLimit(limited.bytesWritten() + 2 * (size + 40));
+  for (int i = 0; i < 5; ++i) limited.push(frame);
+  EXPECT_TRUE(limited.full());
+  EXPECT_GE(limited.framesWritten(), 1);
+  EXPECT_LT(limited.framesWritten(), 5);
+  EXPECT_TRUE(limited.finish());
+  std::ifstream limitedFile("video_limit.avi",
+                            std::ios::binary | std::ios::ate);
+  EXPECT_EQ(static_cast<long long>(limitedFile.tellg()),
+            limited.bytesWritten());
+  limitedFile.close();
+  std::remove("video_limit.avi");
+
+  // кадр, который не удалось сжать, останавливает запись с ошибкой
+  s21::MjpegAviWriter failed;
+  ASSERT_TRUE(failed.open("video_failed.avi", QSize(40, 30), 25));
+  failed.push(frame);
+  failed.push(QImage());
+  failed.push(frame);
+  EXPECT_TRUE(failed.full());
+  EXPECT_EQ(failed.framesWritten(), 1);
+  EXPECT_FALSE(failed.finish());
+  std::remove("video_failed.avi");
+
+  // незавершенная запись не оставляет временный файл индекса
+  {
+    s21::MjpegAviWriter unfinished;
+    ASSERT_TRUE(unfinished.open("video_unfinished.avi", QSize(40, 30), 25));
+    unfinished.push(frame);
+    EXPECT_TRUE(QFile::exists("video_unfinished.avi.idx"));
+  }
+  EXPECT_FALSE(QFile::exists("video_unfinished.avi.idx"));
+  std::remove("video_unfinished.avi");
+}
+
+TEST_F(ViewerModelTest, Test_LodChain) {
+  s21::ViewerModel model;
+  model.loadOBJ("../samples/boat.obj");
+  model.waitForLodChain();
+  const std::vector<LodLevel_t> &chain = model.getLodChain();
+  ASSERT_FALSE(chain.empty());
+  size_t previous = model.getTriangles().size() / 3;
+  for (const LodLevel_t &level : chain) {
+    size_t count = level.triangles.size() / 3;
+    EXPECT_LT(count, previous);
+    EXPECT_GE(count, s21::ViewerModel::kMinLodTriangles);
+    for (unsigned int index : level.triangles)
+      ASSERT_LT(index, level.vertices.size());
+    previous = count;
+  }
+  EXPECT_EQ(model.selectLodLevel(10000.0f), -1);
+  EXPECT_EQ(model.selectLodLevel(1.0f), static_cast<int>(chain.size()) - 1);
+  EXPECT_TRUE(model.exportLodLevel(0, "lod_test.obj"));
+  s21::ViewerModel exported;
+  exported.loadOBJ("lod_test.obj");
+  EXPECT_EQ(exported.getTriangles().size(), chain[0].triangles.size());
+  std::remove("lod_test.obj");
+  // почти плоская сетка: вершины не должны уходить от поверхности
+  std::vector<QVector3D> grid;
+  std::vector<unsigned int> cells;
+  const int side = 30;
+  for (int y = 0; y <= side; ++y)
+    for (int x = 0; x <= side; ++x)
+      grid.emplace_back(x / float(side), y / float(side),
+                        ((x * 7 + y * 13) % 5) * 1e-5f);
+  for (int y = 0; y < side; ++y)
+    for (int x = 0; x < side; ++x) {
+      unsigned int corner = y * (side + 1) + x;
+      cells.insert(cells.end(), {corner, corner + 1, corner + side + 2,
+                                 corner, corner + side + 2, corner + side + 1});
+    }
+  LodLevel_t flat = s21::MeshSimplifier::simplify(grid, cells, 200);
+  EXPECT_LT(flat.triangles.size() / 3, cells.size() / 3);
+  for (const QVector3D &vertex : flat.vertices) {
+    EXPECT_GE(vertex.x(), -1e-4f);
+    EXPECT_LE(vertex.x(), 1.0f + 1e-4f);
+    EXPECT_GE(vertex.y(), -1e-4f);
+    EXPECT_LE(vertex.y(), 1.0f + 1e-4f);
+    EXPECT_NEAR(vertex.z(), 0.0f, 1e-3f);
+  }
+  // граница сетки сохраняется: углы на месте, площадь не меняется
+  int corners = 0;
+  for (const QVector3D &vertex : flat.vertices)
+    if (std::min(vertex.x(), 1.0f - vertex.x()) < 1e-4f &&
+        std::min(vertex.y(), 1.0f - vertex.y()) < 1e-4f)
+      ++corners;
+  EXPECT_EQ(corners, 4);
+  double area = 0.0;
+  for (size_t i = 0; i + 2 < flat.triangles.size(); i += 3) {
+    QVector3D a = flat.vertices[flat.triangles[i]];
+    QVector3D ab = flat.vertices[flat.triangles[i + 1]] - a;
+    QVector3D ac = flat.vertices[flat.triangles[i + 2]] - a;
+    area += 0.5 * (ab.x() * ac.y() - ab.y() * ac.x());
+  }
+  EXPECT_NEAR(area, 1.0, 1e-3);
+}
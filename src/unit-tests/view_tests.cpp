@@ -0,0 +1,553 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+#include "../viewer_view/viewer_view.h"
+#include "allocation_counter.h"
+
+// Тесты контроллера и представления собираются отдельной программой вместе
+// с исходниками viewer_controller и viewer_view; tests.cpp проверяет
+// только модель.
+
+/**
+ * @brief Обработка событий Qt в течение заданного времени
+ */
+static void processEventsFor(int milliseconds) {
+  QElapsedTimer timer;
+  timer.start();
+  while (timer.elapsed() < milliseconds)
+    QApplication::processEvents(QEventLoop::AllEvents, 10);
+}
+
+// поэлементное сравнение матриц с допуском на ошибку округления
+static bool matricesNear(const QMatrix4x4 &a, const QMatrix4x4 &b) {
+  for (int i = 0; i < 16; ++i)
+    if (std::abs(a.constData()[i] - b.constData()[i]) > 1e-5f) return false;
+  return true;
+}
+
+class ViewerViewTest : public ::testing::Test {};
+
+int main(int argc, char **argv) {
+  // виджеты и контексты OpenGL создаются без дисплея
+  if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  QApplication app(argc, argv);
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+
+TEST_F(ViewerViewTest, Test_CommandHistory) {
+  s21::ViewerModel model;
+  s21::ViewerController controller(&model);
+  s21::CommandHistory history(3);
+  auto run = [&history](std::unique_ptr<s21::Command> command) {
+    command->execute();
+    history.push(std::move(command));
+  };
+  auto rotation = [&controller](QPoint delta) {
+    return std::make_unique<s21::MouseRotateCommand>(
+        &controller, s21::ViewerModel::arcballRotation(delta),
+        s21::ViewerModel::mouseAngles(delta));
+  };
+  QMatrix4x4 initial = model.getModelMatrix();
+  run(std::make_unique<s21::TranslateCommand>(&controller, 0.5f,
+                                              translateXPlus));
+  QMatrix4x4 translated = model.getModelMatrix();
+  // перетаскивание из трех перемещений мыши занимает одну запись
+  history.beginInteraction();
+  run(rotation(QPoint(20, 0)));
+  run(rotation(QPoint(0, 30)));
+  run(rotation(QPoint(-5, 10)));
+  history.endInteraction();
+  EXPECT_EQ(history.size(), 2u);
+  QMatrix4x4 rotated = model.getModelMatrix();
+  // углы накапливаются так же, как при вращении кнопками
+  EXPECT_FLOAT_EQ(model.getAffineTransform().rotateAngleX, 40.0f);
+  EXPECT_FLOAT_EQ(model.getAffineTransform().rotateAngleY, 15.0f);
+
+  EXPECT_TRUE(history.undo());
+  EXPECT_TRUE(matricesNear(model.getModelMatrix(), translated));
+  EXPECT_FLOAT_EQ(model.getAffineTransform().rotateAngleX, 0.0f);
+  EXPECT_FLOAT_EQ(model.getAffineTransform().rotateAngleY, 0.0f);
+  EXPECT_TRUE(history.undo());
+  EXPECT_TRUE(matricesNear(model.getModelMatrix(), initial));
+  EXPECT_FALSE(history.undo());
+  EXPECT_TRUE(history.redo());
+  EXPECT_TRUE(history.redo());
+  EXPECT_FALSE(history.redo());
+  EXPECT_TRUE(matricesNear(model.getModelMatrix(), rotated));
+  EXPECT_FLOAT_EQ(model.getAffineTransform().rotateAngleX, 40.0f);
+
+  // при переполнении удаляется самая старая запись (перемещение)
+  run(std::make_unique<s21::RotateCommand>(&controller, 10.0f, rotateZPlus));
+  run(std::make_unique<s21::RotateCommand>(&controller, 10.0f, rotateZPlus));
+  EXPECT_EQ(history.size(), 3u);
+  while (history.undo()) {
+  }
+  EXPECT_FLOAT_EQ(model.getAffineTransform().translateX, 0.5f);
+  EXPECT_FLOAT_EQ(model.getAffineTransform().rotateAngleZ, 0.0f);
+  EXPECT_TRUE(matricesNear(model.getModelMatrix(), translated));
+}
+
+TEST_F(ViewerViewTest, Test_StyleCommandHistory) {
+  s21::ViewerModel model;
+  s21::ViewerController controller(&model);
+  s21::CommandHistory history;
+  auto run = [&history](std::unique_ptr<s21::Command> command) {
+    command->execute();
+    history.push(std::move(command));
+  };
+  ProjectionType_t projection = model.getAffineTransform().projectionType;
+  VerticeType_t verticeType = model.getModelDefinition().verticeType;
+  QColor background = model.getModelDefinition().backgroundColor;
+  ProjectionType_t otherProjection =
+      projection == Parallel ? Perspective : Parallel;
+  run(std::make_unique<s21::ChangeProjectionCommand>(&controller,
+                                                     otherProjection));
+  run(std::make_unique<s21::ChangeVerticeTypeCommand>(&controller, Circle));
+  run(std::make_unique<s21::ChangeBackgroundColorCommand>(&controller,
+                                                          Qt::darkRed));
+  EXPECT_EQ(history.size(), 3u);
+  EXPECT_EQ(model.getAffineTransform().projectionType, otherProjection);
+  EXPECT_EQ(model.getModelDefinition().verticeType, Circle);
+  EXPECT_EQ(model.getModelDefinition().backgroundColor, QColor(Qt::darkRed));
+
+  EXPECT_TRUE(history.undo());
+  EXPECT_EQ(model.getModelDefinition().backgroundColor, background);
+  EXPECT_TRUE(history.undo());
+  EXPECT_EQ(model.getModelDefinition().verticeType, verticeType);
+  EXPECT_TRUE(history.undo());
+  EXPECT_EQ(model.getAffineTransform().projectionType, projection);
+  EXPECT_TRUE(history.redo());
+  EXPECT_EQ(model.getAffineTransform().projectionType, otherProjection);
+}
+
+TEST_F(ViewerViewTest, Test_WheelZoomHistory) {
+  s21::ViewerModel model;
+  s21::ViewerController controller(&model);
+  s21::CommandHistory history;
+  s21::OpenGLWidget widget(&controller);
+  widget.setCommandHistory(&history);
+  widget.setFrameBudget(0);
+  widget.setLodIdleTimeout(200);
+  widget.resize(320, 240);
+  widget.show();
+  processEventsFor(100);
+  if (!widget.isValid()) GTEST_SKIP() << "OpenGL context is unavailable";
+  controller.modelSetProjection(Parallel);
+  float initialScale = model.getAffineTransform().scaleFactor;
+  // прокрутка колесика с перерисовкой между шагами
+  for (int step = 0; step < 5; ++step) {
+    QWheelEvent wheel(QPointF(50, 50), QPointF(50, 50), QPoint(),
+                      QPoint(0, 120), Qt::NoButton, Qt::NoModifier,
+                      Qt::NoScrollPhase, false);
+    QApplication::sendEvent(&widget, &wheel);
+    processEventsFor(30);
+  }
+  processEventsFor(400);
+  EXPECT_GT(model.getAffineTransform().scaleFactor, initialScale);
+  EXPECT_EQ(history.size(), 1u);
+  EXPECT_TRUE(history.undo());
+  EXPECT_FLOAT_EQ(model.getAffineTransform().scaleFactor, initialScale);
+  EXPECT_FALSE(history.undo());
+}
+
+TEST_F(ViewerViewTest, Test_SteadyFrameAllocations) {
+  s21::ViewerModel model;
+  s21::ViewerController controller(&model);
+  s21::OpenGLWidget widget(&controller);
+  widget.resize(320, 240);
+  widget.grabFramebuffer();  // создает контекст и вызывает initializeGL
+  if (!widget.isValid()) GTEST_SKIP() << "OpenGL context is unavailable";
+  controller.Model_loadOBJ("../samples/boat.obj");
+  model.waitForLodChain();
+  widget.makeCurrent();
+  // первые кадры загружают буферы и собирают проход отрисовки
+  for (int frame = 0; frame < 3; ++frame) {
+    controller.modelRotateAxis(rotateYPlus, 1.0f);
+    widget.renderFrame();
+  }
+  long long drawnBefore = widget.frameStats().totalFrames;
+  allocationCount = 0;
+  for (int frame = 0; frame < 100; ++frame) {
+    controller.modelRotateAxis(rotateYPlus, 1.0f);
+    AllocationScope scope;
+    widget.renderFrame();
+  }
+  widget.doneCurrent();
+  EXPECT_EQ(allocationCount, 0);
+  EXPECT_EQ(widget.frameStats().totalFrames - drawnBefore, 100);
+}
+
+TEST_F(ViewerViewTest, Test_ProgressiveRefinement) {
+  // сетка с числом ребер в несколько частей kProgressiveSlice
+  const int side = 300;
+  std::FILE *file = std::fopen("progressive_test.obj", "w");
+  ASSERT_NE(file, nullptr);
+  for (int y = 0; y <= side; ++y)
+    for (int x = 0; x <= side; ++x)
+      std::fprintf(file, "v %f %f 0\n", x / float(side) - 0.5f,
+                   y / float(side) - 0.5f);
+  for (int y = 0; y < side; ++y)
+    for (int x = 0; x < side; ++x) {
+      int corner = y * (side + 1) + x + 1;
+      std::fprintf(file, "f %d %d %d\nf %d %d %d\n", corner, corner + 1,
+                   corner + side + 2, corner, corner + side + 2,
+                   corner + side + 1);
+    }
+  std::fclose(file);
+  s21::ViewerModel model;
+  s21::ViewerController controller(&model);
+  s21::OpenGLWidget widget(&controller);
+  widget.resize(320, 240);
+  widget.grabFramebuffer();
+  if (!widget.isValid()) GTEST_SKIP() << "OpenGL context is unavailable";
+  controller.Model_loadOBJ("progressive_test.obj");
+  std::remove("progressive_test.obj");
+  model.waitForLodChain();
+  widget.setProgressiveBudget(1);
+  widget.setProgressiveRendering(true);
+  widget.makeCurrent();
+  float previous = 0.0f;
+  for (int frame = 0; frame < 100 && previous < 1.0f; ++frame) {
+    widget.renderFrame();
+    float done = widget.frameStats().progressiveDone;
+    EXPECT_GE(done, previous);
+    previous = done;
+  }
+  EXPECT_FLOAT_EQ(previous, 1.0f);
+  // готовый кадр без изменений не начинается заново
+  long long drawn = widget.frameStats().totalFrames;
+  widget.renderFrame();
+  EXPECT_EQ(widget.frameStats().totalFrames, drawn);
+  widget.setLodBudget(widget.lodBudget());
+  widget.renderFrame();
+  EXPECT_EQ(widget.frameStats().totalFrames, drawn + 1);
+  EXPECT_FLOAT_EQ(widget.frameStats().progressiveDone, 1.0f);
+  widget.doneCurrent();
+}
+
+TEST_F(ViewerViewTest, Test_BenchmarkStats) {
+  s21::ViewerModel model;
+  s21::ViewerController controller(&model);
+  s21::OpenGLWidget widget(&controller);
+  widget.resize(320, 240);
+  widget.grabFramebuffer();
+  if (!widget.isValid()) GTEST_SKIP() << "OpenGL context is unavailable";
+  controller.Model_loadOBJ("../samples/boat.obj");
+  RenderBenchmark_t result = widget.benchmark(2);
+  EXPECT_EQ(result.frames, 2);
+  // статистика кадра выводится в --benchmark вместе со временем
+  EXPECT_EQ(static_cast<size_t>(result.lastFrame.visibleChunks +
+                                result.lastFrame.culledChunks),
+            model.getChunks().size());
+  EXPECT_GT(result.lastFrame.visibleChunks, 0);
+  EXPECT_GE(result.lastFrame.lodLevel, -1);
+  EXPECT_EQ(result.lastFrame.subPixelCulled, 0);
+}
+
+TEST_F(ViewerViewTest, Test_SoftwareRenderer) {
+  s21::ViewerModel model;
+  model.loadOBJ("../samples/boat.obj");
+  QMatrix4x4 mvp = model.getProjectionMatrix(320.0f / 240.0f) *
+                   model.getModelMatrix();
+  s21::SoftwareRenderer renderer;
+  QImage image = renderer.render(model.getVertices(), model.getEdges(), mvp,
+                                 model.getModelDefinition(), QSize(320, 240));
+  ASSERT_EQ(image.size(), QSize(320, 240));
+  EXPECT_EQ(image.format(), QImage::Format_RGB32);
+  QRgb background = model.getModelDefinition().backgroundColor.rgb();
+  EXPECT_EQ(image.pixel(0, 0), background);
+  int drawn = 0;
+  for (int y = 0; y < image.height(); ++y)
+    for (int x = 0; x < image.width(); ++x)
+      drawn += image.pixel(x, y) != background;
+  EXPECT_GT(drawn, 0);
+  // кадр, строка которого не помещается в QImage, возвращается пустым
+  EXPECT_TRUE(renderer
+                  .render(model.getVertices(), model.getEdges(), mvp,
+                          model.getModelDefinition(), QSize(1 << 30, 1))
+                  .isNull());
+}
+
+TEST_F(ViewerViewTest, Test_SmoothLineKernel) {
+  s21::ViewerModel model;
+  model.loadOBJ("../samples/boat.obj");
+  QMatrix4x4 mvp = model.getProjectionMatrix(1.0f) * model.getModelMatrix();
+  ModelDefinition_t definition = model.getModelDefinition();
+  definition.facetWidth = 0.01f;
+  s21::SoftwareRenderer renderer;
+  renderer.setAntialiasing(true);
+  renderer.setVectorized(false);
+  QImage scalar = renderer.render(model.getVertices(), model.getEdges(), mvp,
+                                  definition, QSize(256, 256));
+  renderer.setAntialiasing(false);
+  EXPECT_FALSE(scalar == renderer.render(model.getVertices(), model.getEdges(),
+                                         mvp, definition, QSize(256, 256)));
+
+  // концы ребра (x = 7.75 и 24.25) покрывают четверть крайних пикселей
+  std::vector<QVector3D> segment = {QVector3D(-0.515625f, -0.03125f, 0.0f),
+                                    QVector3D(0.515625f, -0.03125f, 0.0f)};
+  ModelDefinition_t line = definition;
+  line.facetWidth = 0.0f;
+  line.facetColor = Qt::white;
+  line.backgroundColor = Qt::black;
+  line.verticeType = None;
+  renderer.setAntialiasing(true);
+  for (bool enabled : {false, true}) {
+    renderer.setVectorized(enabled);
+    QImage image =
+        renderer.render(segment, {0, 1}, QMatrix4x4(), line, QSize(32, 32));
+    EXPECT_EQ(qRed(image.pixel(6, 16)), 0);
+    EXPECT_EQ(qRed(image.pixel(7, 16)), 64);
+    EXPECT_EQ(qRed(image.pixel(16, 16)), 255);
+    EXPECT_EQ(qRed(image.pixel(24, 16)), 64);
+    EXPECT_EQ(qRed(image.pixel(25, 16)), 0);
+  }
+
+  if (!s21::hasAvx2())
+    GTEST_SKIP() << "AVX2 is not supported, the kernels cannot be compared";
+  renderer.setVectorized(true);
+  QImage vectorized = renderer.render(model.getVertices(), model.getEdges(),
+                                      mvp, definition, QSize(256, 256));
+  EXPECT_TRUE(scalar == vectorized);
+}
+
+TEST_F(ViewerViewTest, Test_SoftwareMatchesOpenGL) {
+  s21::ViewerModel model;
+  s21::ViewerController controller(&model);
+  controller.Model_loadOBJ("../samples/boat.obj");
+  ModelDefinition_t style = model.getModelDefinition();
+  style.facetWidth = 0.0f;
+  style.facetColor = Qt::white;
+  style.backgroundColor = Qt::black;
+  style.verticeType = None;
+  QSize size(200, 150);
+  s21::OffscreenRenderer offscreen(&controller);
+  QImage hardware = offscreen.render(model.getAffineTransform(), style, size);
+  if (!offscreen.lastFrameHardware())
+    GTEST_SKIP() << "OpenGL context is unavailable";
+  s21::SoftwareRenderer renderer;
+  QMatrix4x4 mvp =
+      s21::ViewerModel::projectionMatrixFor(model.getAffineTransform(),
+                                            200.0f / 150.0f) *
+      s21::ViewerModel::modelMatrixFor(model.getAffineTransform());
+  QImage software = renderer.render(model.getVertices(), model.getEdges(),
+                                    mvp, style, size);
+  ASSERT_EQ(hardware.size(), size);
+  ASSERT_EQ(software.size(), size);
+  // правила растеризации линий различаются, поэтому пиксель совпадает,
+  // если в соседних пикселях другого кадра есть цвет с допуском по каналам
+  const int tolerance = 8;
+  auto similar = [tolerance](QRgb a, QRgb b) {
+    return std::abs(qRed(a) - qRed(b)) <= tolerance &&
+           std::abs(qGreen(a) - qGreen(b)) <= tolerance &&
+           std::abs(qBlue(a) - qBlue(b)) <= tolerance;
+  };
+  auto mismatches = [&](const QImage &from, const QImage &to) {
+    int count = 0;
+    for (int y = 0; y < from.height(); ++y)
+      for (int x = 0; x < from.width(); ++x) {
+        bool found = false;
+        for (int dy = -1; dy <= 1 && !found; ++dy)
+          for (int dx = -1; dx <= 1 && !found; ++dx) {
+            int nx = x + dx, ny = y + dy;
+            found = nx >= 0 && ny >= 0 && nx < to.width() &&
+                    ny < to.height() &&
+                    similar(from.pixel(x, y), to.pixel(nx, ny));
+          }
+        count += !found;
+      }
+    return count;
+  };
+  int drawn = 0;
+  for (int y = 0; y < software.height(); ++y)
+    for (int x = 0; x < software.width(); ++x)
+      drawn += software.pixel(x, y) != style.backgroundColor.rgb();
+  EXPECT_GT(drawn, 0);
+  int limit = size.width() * size.height() / 100;
+  EXPECT_LE(mismatches(software, hardware), limit);
+  EXPECT_LE(mismatches(hardware, software), limit);
+}
+
+TEST_F(ViewerViewTest, Test_Turntable) {
+  s21::ViewerModel model;
+  s21::ViewerController controller(&model);
+  controller.Model_loadOBJ("../samples/boat.obj");
+  TurntableSettings_t settings;
+  settings.frames = 24;
+  settings.axis = AxisX;
+  settings.size = QSize(64, 48);
+  ASSERT_TRUE(s21::OffscreenRenderer::turntableExport(
+      &controller, "turntable_test.gif", settings)());
+  QImageReader reader("turntable_test.gif");
+  EXPECT_EQ(reader.imageCount(), 24);
+  EXPECT_EQ(reader.size(), settings.size);
+  std::vector<QImage> frames;
+  for (QImage frame = reader.read(); !frame.isNull(); frame = reader.read())
+    frames.push_back(frame);
+
+  // запись в другом потоке использует копию модели, снятую до изменения
+  std::function<bool()> task = s21::OffscreenRenderer::turntableExport(
+      &controller, "turntable_task.gif", settings);
+  controller.modelTranslateFigure(translateXPlus, 1.0f);
+  ASSERT_TRUE(std::async(std::launch::async, task).get());
+  QImageReader copy("turntable_task.gif");
+  for (const QImage &frame : frames) EXPECT_TRUE(copy.read() == frame);
+  std::remove("turntable_test.gif");
+  std::remove("turntable_task.gif");
+  settings.frames = 0;
+  EXPECT_FALSE(s21::OffscreenRenderer::turntableExport(
+      &controller, "turntable_test.gif", settings)());
+}
+
+TEST_F(ViewerViewTest, Test_TiledExport) {
+  s21::ViewerModel model;
+  s21::ViewerController controller(&model);
+  controller.Model_loadOBJ("../samples/boat.obj");
+  controller.modelSetFacetWidthValue(0.0f);
+  controller.modelSetVerticeType(Circle);
+  controller.modelSetVerticeWidthValue(9.0f);
+  controller.modelSetVerticeColor(Qt::red);
+  controller.modelSetFacetColor(Qt::white);
+  controller.modelSetBackGroundColor(Qt::black);
+  // шов между плитками проходит через середину кадра, то есть через модель
+  const int seam = s21::OffscreenRenderer::kExportTile;
+  QSize size(2 * seam, 64);
+  auto exportImage = [&](int viewHeight) {
+    if (!s21::OffscreenRenderer::tiledExport(&controller, "tiled_test.bmp",
+                                             size, viewHeight)())
+      return QImage();
+    QImage image("tiled_test.bmp");
+    std::remove("tiled_test.bmp");
+    return image.convertToFormat(QImage::Format_RGB32);
+  };
+  auto markerPixels = [](const QImage &image, int from, int to) {
+    int count = 0;
+    for (int y = 0; y < image.height(); ++y)
+      for (int x = from; x < to; ++x)
+        count += qRed(image.pixel(x, y)) > 128 &&
+                 qGreen(image.pixel(x, y)) < 64;
+    return count;
+  };
+  QImage tiled = exportImage(size.height());
+  ASSERT_EQ(tiled.size(), size);
+  s21::SoftwareRenderer renderer;
+  QMatrix4x4 mvp =
+      s21::ViewerModel::projectionMatrixFor(
+          model.getAffineTransform(),
+          static_cast<float>(size.width()) / size.height()) *
+      s21::ViewerModel::modelMatrixFor(model.getAffineTransform());
+  QImage whole = renderer.render(model.getVertices(), model.getEdges(), mvp,
+                                 model.getModelDefinition(), size);
+  // маркеры у шва не обрезаются плитками
+  int expected = markerPixels(whole, seam - 8, seam + 8);
+  EXPECT_GT(expected, 0);
+  EXPECT_NEAR(markerPixels(tiled, seam - 8, seam + 8), expected,
+              expected / 20 + 2);
+
+  // кадр вдвое выше окна: вершины увеличиваются вместе с ребрами
+  QImage scaled = exportImage(size.height() / 2);
+  ASSERT_EQ(scaled.size(), size);
+  EXPECT_GT(markerPixels(scaled, 0, size.width()),
+            markerPixels(tiled, 0, size.width()));
+  size = QSize(0, 64);
+  EXPECT_TRUE(exportImage(size.height()).isNull());
+}
+
+TEST_F(ViewerViewTest, Test_ImageSavePaths) {
+  QStringList formats = {"BMP", "JPEG", "PNG", "WEBP"};
+  QStringList expected = {"shot.bmp", "shot.jpg", "shot.png", "shot.webp"};
+  EXPECT_EQ(s21::MainWindow::imageSavePaths("shot", formats), expected);
+  EXPECT_EQ(s21::MainWindow::imageSavePaths("shot.PNG", formats), expected);
+  EXPECT_EQ(s21::MainWindow::imageSavePaths("shot.v1", {"PNG"}),
+            QStringList{"shot.v1.png"});
+}
+
+TEST_F(ViewerViewTest, Test_BackgroundTasks) {
+  QImage image(8, 6, QImage::Format_RGB32);
+  image.fill(Qt::red);
+  std::vector<std::pair<QString, bool>> reports;
+  std::vector<int> pendingSeen;
+  {
+    s21::BackgroundTasks tasks;
+    QStringList paths =
+        s21::MainWindow::imageSavePaths("tasks_test", {"BMP", "PNG"});
+    paths << "missing_directory/tasks_test.png";
+    for (const QString &path : paths)
+      tasks.start([image, path]() { return image.save(path); },
+                  [&, path](bool saved) {
+                    reports.emplace_back(path, saved);
+                    pendingSeen.push_back(tasks.pending());
+                  });
+    EXPECT_EQ(tasks.pending(), 3);
+    tasks.waitForDone();
+    // отчеты передаются только через очередь событий
+    EXPECT_TRUE(reports.empty());
+    processEventsFor(100);
+    EXPECT_EQ(tasks.pending(), 0);
+  }
+  ASSERT_EQ(reports.size(), 3u);
+  EXPECT_EQ(pendingSeen.back(), 0);
+  for (const auto &report : reports) {
+    EXPECT_EQ(report.second, !report.first.startsWith("missing_directory"));
+    if (!report.second) continue;
+    EXPECT_EQ(QImage(report.first).size(), image.size());
+    std::remove(report.first.toLocal8Bit().constData());
+  }
+
+  // удаление с незавершенными задачами: деструктор дожидается задач, а
+  // их отчеты отбрасываются
+  int late = 0;
+  {
+    s21::BackgroundTasks tasks;
+    for (int i = 0; i < 4; ++i)
+      tasks.start(
+          []() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            return true;
+          },
+          [&late](bool) { ++late; });
+  }
+  processEventsFor(100);
+  EXPECT_EQ(late, 0);
+}
+
+TEST_F(ViewerViewTest, Test_LodIdleFrame) {
+  s21::ViewerModel model;
+  s21::ViewerController controller(&model);
+  s21::OpenGLWidget widget(&controller);
+  widget.setFrameBudget(0);
+  widget.setLodIdleTimeout(500);
+  widget.resize(320, 240);
+  widget.show();
+  processEventsFor(200);
+  if (!widget.isValid()) GTEST_SKIP() << "OpenGL context is unavailable";
+  controller.Model_loadOBJ("../samples/boat.obj");
+  model.waitForLodChain();
+  ASSERT_FALSE(model.getLodChain().empty());
+  // бюджет меньше исходной сетки, но вмещает первый уровень цепочки
+  widget.setLodBudget(model.getLodChain()[0].edges.size() / 2);
+  widget.requestUpdate();
+  processEventsFor(200);
+  // перетаскивание рисуется упрощенной сеткой
+  QMouseEvent press(QEvent::MouseButtonPress, QPointF(10, 10), QPointF(10, 10),
+                    Qt::LeftButton, Qt::LeftButton, Qt::NoModifier);
+  QMouseEvent move(QEvent::MouseMove, QPointF(40, 30), QPointF(40, 30),
+                   Qt::NoButton, Qt::LeftButton, Qt::NoModifier);
+  QMouseEvent release(QEvent::MouseButtonRelease, QPointF(40, 30),
+                      QPointF(40, 30), Qt::LeftButton, Qt::NoButton,
+                      Qt::NoModifier);
+  QApplication::sendEvent(&widget, &press);
+  QApplication::sendEvent(&widget, &move);
+  QApplication::sendEvent(&widget, &release);
+  processEventsFor(200);
+  EXPECT_EQ(controller.modelGetDirtyFlags(),
+            static_cast<unsigned int>(DirtyNone));
+  EXPECT_GE(widget.frameStats().lodLevel, 0);
+  long long drawn = widget.frameStats().totalFrames;
+  // после паузы модель без изменений перерисовывается полностью
+  processEventsFor(800);
+  EXPECT_GT(widget.frameStats().totalFrames, drawn);
+}
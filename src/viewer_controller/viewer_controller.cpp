@@ -95,6 +95,41 @@ void ViewerController::modelSetVerticeWidth(const ScaleType_t &scaleF) {
   viewer_model->setVerticeWidth(scaleF);
 }
 
+/**
+ * @brief Установка точного значения толщины ребра.
+ * @param facetWidth Толщина ребра.
+ */
+void ViewerController::modelSetFacetWidthValue(float facetWidth) {
+  viewer_model->setFacetWidthValue(facetWidth);
+}
+
+/**
+ * @brief Установка точного значения толщины вершины.
+ * @param verticeWidth Толщина вершины.
+ */
+void ViewerController::modelSetVerticeWidthValue(float verticeWidth) {
+  viewer_model->setVerticeWidthValue(verticeWidth);
+}
+
+/**
+ * @brief Изменение масштаба и угла обзора на заданные приращения.
+ * @param scaleDelta Приращение коэффициента масштабирования.
+ * @param fovDelta Приращение угла обзора.
+ */
+void ViewerController::modelAdjustScale(float scaleDelta, float fovDelta) {
+  viewer_model->adjustScale(scaleDelta, fovDelta);
+}
+
+/**
+ * @brief Поворот модели на заданный кватернион в экранных осях.
+ * @param rotation Приращение поворота.
+ * @param angles Приращение углов rotateAngleX/Y/Z в градусах.
+ */
+void ViewerController::modelApplyRotation(const QQuaternion &rotation,
+                                          const QVector3D &angles) {
+  viewer_model->applyRotation(rotation, angles);
+}
+
 /**
  * @brief Установка типа вершин модели.
  * @param verticeType Тип вершин.
@@ -140,7 +175,7 @@ float ViewerController::modelMakeFloat(QString inputText) {
  * @brief Получение списка вершин модели.
  * @return Вектор вершин модели.
  */
-std::vector<QVector3D> ViewerController::modelGetVertices() {
+const std::vector<QVector3D> &ViewerController::modelGetVertices() {
   return viewer_model->getVertices();
 }
 
@@ -148,10 +183,139 @@ std::vector<QVector3D> ViewerController::modelGetVertices() {
  * @brief Получение списка ребер модели.
  * @return Вектор ребер модели.
  */
-std::vector<unsigned int> ViewerController::modelGetFacets() {
+const std::vector<unsigned int> &ViewerController::modelGetFacets() {
   return viewer_model->getFacets();
 }
 
+/**
+ * @brief Получение ребер модели в виде пар индексов.
+ * @return Вектор пар индексов вершин.
+ */
+const std::vector<unsigned int> &ViewerController::modelGetEdges() {
+  return viewer_model->getEdges();
+}
+
+/**
+ * @brief Получение закэшированных четырехугольников толстых ребер.
+ * @return Координаты вершин четырехугольников (по 4 вершины на ребро).
+ */
+const std::vector<float> &ViewerController::modelGetThickEdgeQuads() {
+  return viewer_model->getThickEdgeQuads();
+}
+
+/**
+ * @brief Получение частей сетки для отсечения.
+ * @return Вектор частей сетки.
+ */
+const std::vector<MeshChunk_t> &ViewerController::modelGetChunks() {
+  return viewer_model->getChunks();
+}
+
+/**
+ * @brief Сбор диапазонов ребер видимых частей сетки.
+ * @param mvp Произведение матриц проекции и модели.
+ * @param ranges Диапазоны ребер видимых частей.
+ * @return Число видимых частей.
+ */
+int ViewerController::modelCollectVisibleEdges(
+    const QMatrix4x4 &mvp, std::vector<EdgeRange_t> &ranges) {
+  return viewer_model->collectVisibleEdges(mvp, ranges);
+}
+
+/**
+ * @brief Отбрасывание ребер короче порога в пикселях.
+ * @param mvp Произведение матриц проекции и модели.
+ * @param viewport Размер области вывода в пикселях.
+ * @param threshold Минимальная длина ребра в пикселях.
+ * @param ranges Диапазоны проверяемых ребер.
+ * @param kept Пары индексов сохраненных ребер.
+ * @return Число отброшенных ребер.
+ */
+size_t ViewerController::modelCullSubPixelEdges(
+    const QMatrix4x4 &mvp, const QSizeF &viewport, float threshold,
+    const std::vector<EdgeRange_t> &ranges, std::vector<unsigned int> &kept) {
+  return viewer_model->cullSubPixelEdges(mvp, viewport, threshold, ranges,
+                                         kept);
+}
+
+/**
+ * @brief Получение упрощенного набора ребер для вращения мышью.
+ * @param budget Максимальное число ребер (0 - упрощение отключено).
+ * @return Пары индексов вершин.
+ */
+const std::vector<unsigned int> &ViewerController::modelGetLodEdges(
+    size_t budget) {
+  return viewer_model->getLodEdges(budget);
+}
+
+/**
+ * @brief Получение версии упрощенного набора ребер.
+ * @return Номер, меняющийся при пересчете набора.
+ */
+unsigned long long ViewerController::modelGetLodRevision() {
+  return viewer_model->getLodRevision();
+}
+
+/**
+ * @brief Получение цепочки упрощенных сеток.
+ * @return Уровни от самого подробного к самому грубому.
+ */
+const std::vector<LodLevel_t> &ViewerController::modelGetLodChain() {
+  return viewer_model->getLodChain();
+}
+
+/**
+ * @brief Проверка, строится ли цепочка упрощенных сеток в фоне.
+ * @return true, если построение еще не завершено.
+ */
+bool ViewerController::modelIsLodChainBuilding() {
+  return viewer_model->isLodChainBuilding();
+}
+
+/**
+ * @brief Получение версии цепочки упрощенных сеток.
+ * @return Номер, меняющийся при смене цепочки.
+ */
+unsigned long long ViewerController::modelGetLodChainRevision() {
+  return viewer_model->getLodChainRevision();
+}
+
+/**
+ * @brief Получение радиуса описанной сферы модели.
+ * @return Радиус в координатах модели.
+ */
+float ViewerController::modelGetBoundingRadius() {
+  return viewer_model->getBoundingRadius();
+}
+
+/**
+ * @brief Выбор уровня детализации по размеру модели на экране.
+ * @param projectedPixels Диаметр модели на экране в пикселях.
+ * @return Номер уровня или -1 для исходной сетки.
+ */
+int ViewerController::modelSelectLodLevel(float projectedPixels) {
+  return viewer_model->selectLodLevel(projectedPixels);
+}
+
+/**
+ * @brief Сохранение уровня детализации в файл OBJ.
+ * @param level Номер уровня.
+ * @param filePath Путь к файлу.
+ * @return true, если файл записан.
+ */
+bool ViewerController::modelExportLodLevel(size_t level,
+                                           const QString &filePath) {
+  return viewer_model->exportLodLevel(level, filePath);
+}
+
+/**
+ * @brief Получение поколения сетки модели.
+ * @return Номер поколения, меняющийся при изменении вершин или ребер.
+ */
+unsigned long long ViewerController::modelGetMeshGeneration() {
+  return viewer_model->getMeshGeneration();
+}
+
 /**
  * @brief Получение аффинного преобразования модели.
  * @return Структура с аффинным преобразованием.
@@ -168,4 +332,37 @@ ModelDefinition_t ViewerController::modelGetModelDefinition() {
   return viewer_model->getModelDefinition();
 }
 
+/**
+ * @brief Получение кэшированной матрицы модели.
+ * @return Матрица масштаба, поворота и переноса модели.
+ */
+const QMatrix4x4 &ViewerController::modelGetModelMatrix() {
+  return viewer_model->getModelMatrix();
+}
+
+/**
+ * @brief Получение матрицы проекции.
+ * @param aspectRatio Отношение ширины области вывода к высоте.
+ * @return Матрица текущей проекции.
+ */
+QMatrix4x4 ViewerController::modelGetProjectionMatrix(float aspectRatio) {
+  return viewer_model->getProjectionMatrix(aspectRatio);
+}
+
+/**
+ * @brief Получение флагов измененного состояния модели.
+ * @return Комбинация значений DirtyFlag.
+ */
+unsigned int ViewerController::modelGetDirtyFlags() {
+  return viewer_model->getDirtyFlags();
+}
+
+/**
+ * @brief Сброс обработанных флагов измененного состояния модели.
+ * @param flags Комбинация значений DirtyFlag.
+ */
+void ViewerController::modelClearDirtyFlags(unsigned int flags) {
+  viewer_model->clearDirtyFlags(flags);
+}
+
 }  // namespace s21
\ No newline at end of file
@@ -24,6 +24,11 @@ class ViewerController {
 
   void modelSetFacetWidth(const ScaleType_t &scaleF);
   void modelSetVerticeWidth(const ScaleType_t &scaleF);
+  void modelSetFacetWidthValue(float facetWidth);
+  void modelSetVerticeWidthValue(float verticeWidth);
+  void modelAdjustScale(float scaleDelta, float fovDelta);
+  void modelApplyRotation(const QQuaternion &rotation,
+                          const QVector3D &angles);
 
   void modelSetVerticeColor(const QColor &VerticeColor);
   void modelSetFacetColor(const QColor &FacetColor);
@@ -34,10 +39,32 @@ class ViewerController {
   float modelMakeFloat(QString inputText);
 
   // getters
-  std::vector<QVector3D> modelGetVertices();
-  std::vector<unsigned int> modelGetFacets();
+  const std::vector<QVector3D> &modelGetVertices();
+  const std::vector<unsigned int> &modelGetFacets();
+  const std::vector<unsigned int> &modelGetEdges();
+  const std::vector<float> &modelGetThickEdgeQuads();
+  const std::vector<MeshChunk_t> &modelGetChunks();
+  int modelCollectVisibleEdges(const QMatrix4x4 &mvp,
+                               std::vector<EdgeRange_t> &ranges);
+  size_t modelCullSubPixelEdges(const QMatrix4x4 &mvp, const QSizeF &viewport,
+                                float threshold,
+                                const std::vector<EdgeRange_t> &ranges,
+                                std::vector<unsigned int> &kept);
+  const std::vector<unsigned int> &modelGetLodEdges(size_t budget);
+  unsigned long long modelGetLodRevision();
+  const std::vector<LodLevel_t> &modelGetLodChain();
+  unsigned long long modelGetLodChainRevision();
+  bool modelIsLodChainBuilding();
+  float modelGetBoundingRadius();
+  int modelSelectLodLevel(float projectedPixels);
+  bool modelExportLodLevel(size_t level, const QString &filePath);
+  unsigned long long modelGetMeshGeneration();
   AffineTransform_t modelGetAffineTransform();
   ModelDefinition_t modelGetModelDefinition();
+  const QMatrix4x4 &modelGetModelMatrix();
+  QMatrix4x4 modelGetProjectionMatrix(float aspectRatio);
+  unsigned int modelGetDirtyFlags();
+  void modelClearDirtyFlags(unsigned int flags);
 
  private:
   ViewerModel *viewer_model;
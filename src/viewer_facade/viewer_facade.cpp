@@ -25,4 +25,163 @@ ViewerFacade::~ViewerFacade() {
  */
 void ViewerFacade::startViewer() { mainWindow->show(); }
 
+/**
+ * @brief Запуск сравнения путей отрисовки без интерактивного цикла
+ *
+ * @param filePath Путь к файлу OBJ.
+ * @param frames Число кадров для каждого пути.
+ * @return Код завершения приложения.
+ */
+int ViewerFacade::runBenchmark(const QString& filePath, int frames) {
+  mainWindow->show();
+  QApplication::processEvents();
+  RenderBenchmark_t result = mainWindow->benchmarkRendering(filePath, frames);
+  QTextStream out(stdout);
+  out << "renderer: " << result.renderer << "\n"
+      << "frames: " << result.frames << "\n"
+      << "immediate: " << result.immediateMs << " ms/frame\n"
+      << "retained: " << result.retainedMs << " ms/frame\n"
+      << "visible chunks: " << result.lastFrame.visibleChunks << "\n"
+      << "culled chunks: " << result.lastFrame.culledChunks << "\n"
+      << "lod level: " << result.lastFrame.lodLevel << "\n"
+      << "sub-pixel culled edges: " << result.lastFrame.subPixelCulled
+      << "\n";
+  return 0;
+}
+
+/**
+ * @brief Отрисовка модели в файл без окна
+ *
+ * Кадр рисуется внеэкранным OpenGL, а если он недоступен - программным
+ * растеризатором; в выводе указывается использованный путь.
+ *
+ * @param filePath Путь к файлу OBJ.
+ * @param imagePath Путь к изображению (формат определяется расширением).
+ * @param size Размер изображения в пикселях.
+ * @return Код завершения приложения.
+ */
+int ViewerFacade::renderImage(const QString& filePath, const QString& imagePath,
+                              const QSize& size) {
+  viewerController->Model_loadOBJ(filePath);
+  OffscreenRenderer renderer(viewerController);
+  QElapsedTimer timer;
+  timer.start();
+  QImage image =
+      renderer.render(viewerController->modelGetAffineTransform(),
+                      viewerController->modelGetModelDefinition(), size);
+  qint64 elapsed = timer.elapsed();
+  QTextStream out(stdout);
+  if (image.isNull()) {
+    out << "failed to render " << size.width() << "x" << size.height()
+        << ": the image is too large\n";
+    return 1;
+  }
+  if (!image.save(imagePath)) {
+    out << "failed to save " << imagePath << "\n";
+    return 1;
+  }
+  out << "rendered " << size.width() << "x" << size.height() << " in "
+      << elapsed << " ms ("
+      << (renderer.lastFrameHardware() ? "OpenGL" : "software") << ")\n";
+  return 0;
+}
+
+/**
+ * @brief Запись ролика с полным оборотом модели без окна
+ *
+ * @param filePath Путь к файлу модели.
+ * @param gifPath Путь к файлу GIF.
+ * @param settings Число кадров, ось, размер и частота кадров.
+ * @return Код завершения приложения.
+ */
+int ViewerFacade::exportTurntable(const QString& filePath,
+                                  const QString& gifPath,
+                                  const TurntableSettings_t& settings) {
+  viewerController->Model_loadOBJ(filePath);
+  QElapsedTimer timer;
+  timer.start();
+  bool written =
+      OffscreenRenderer::turntableExport(viewerController, gifPath, settings)();
+  qint64 elapsed = timer.elapsed();
+  QTextStream out(stdout);
+  if (!written) {
+    out << "failed to save " << gifPath << "\n";
+    return 1;
+  }
+  out << "turntable of " << settings.frames << " frames "
+      << settings.size.width() << "x" << settings.size.height() << " in "
+      << elapsed << " ms, " << QFileInfo(gifPath).size() / 1024 << " KB\n";
+  return 0;
+}
+
+/**
+ * @brief Замер скорости программной растеризации ребер
+ *
+ * Сетка - квадратная решетка со случайным смещением вершин, каждая вершина
+ * соединена с соседями справа и снизу. Кадр 1920x1080 рисуется без
+ * сглаживания, со сглаживанием скалярно и со сглаживанием командами AVX2.
+ *
+ * @param edgeCount Число ребер синтетической сетки.
+ * @return Код завершения приложения.
+ */
+int ViewerFacade::runLineBenchmark(size_t edgeCount) {
+  size_t side = static_cast<size_t>(std::sqrt(edgeCount / 2.0)) + 2;
+  std::mt19937 random(21);
+  std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+  std::vector<QVector3D> vertices;
+  vertices.reserve(side * side);
+  float step = 2.0f / (side - 1);
+  for (size_t y = 0; y < side; ++y)
+    for (size_t x = 0; x < side; ++x)
+      vertices.emplace_back(-1.0f + (x + jitter(random)) * step,
+                            -1.0f + (y + jitter(random)) * step,
+                            jitter(random));
+  std::vector<unsigned int> edges;
+  edges.reserve(edgeCount * 2);
+  for (size_t i = 0; i < vertices.size() && edges.size() < edgeCount * 2;
+       ++i) {
+    unsigned int index = static_cast<unsigned int>(i);
+    if ((i + 1) % side != 0) {
+      edges.push_back(index);
+      edges.push_back(index + 1);
+    }
+    if (i + side < vertices.size() && edges.size() < edgeCount * 2) {
+      edges.push_back(index);
+      edges.push_back(static_cast<unsigned int>(index + side));
+    }
+  }
+  ModelDefinition_t definition;
+  definition.facetColor = Qt::white;
+  definition.backgroundColor = Qt::black;
+  definition.verticeType = None;
+  QMatrix4x4 mvp;
+  mvp.ortho(-1.1f, 1.1f, -1.1f, 1.1f, -2.0f, 2.0f);
+  QSize size(1920, 1080);
+
+  QTextStream out(stdout);
+  out << "edges: " << edges.size() / 2 << "\n"
+      << "threads: " << std::thread::hardware_concurrency() << "\n";
+  SoftwareRenderer renderer;
+  const int runs = 5;
+  auto measure = [&](const char* name, bool antialiased, bool vectorized) {
+    renderer.setAntialiasing(antialiased);
+    renderer.setVectorized(vectorized);
+    renderer.render(vertices, edges, mvp, definition, size);
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < runs; ++i)
+      renderer.render(vertices, edges, mvp, definition, size);
+    double seconds = timer.nsecsElapsed() / 1.0e9;
+    out << name << ": " << edges.size() / 2 * runs / seconds / 1.0e6
+        << " Medges/s\n";
+  };
+  measure("aliased", false, false);
+  measure("antialiased scalar", true, false);
+  if (hasAvx2())
+    measure("antialiased avx2", true, true);
+  else
+    out << "antialiased avx2: unsupported\n";
+  return 0;
+}
+
 }  // namespace s21
\ No newline at end of file
@@ -13,6 +13,12 @@ class ViewerFacade {
   ViewerFacade();
   ~ViewerFacade();
   void startViewer();
+  int runBenchmark(const QString& filePath, int frames);
+  int renderImage(const QString& filePath, const QString& imagePath,
+                  const QSize& size);
+  int runLineBenchmark(size_t edgeCount);
+  int exportTurntable(const QString& filePath, const QString& gifPath,
+                      const TurntableSettings_t& settings);
 
  private:
   ViewerModel* viewerModel;
@@ -2,23 +2,62 @@
 #include <GL/glut.h>
 
 #include <QApplication>
+#include <QBuffer>
 #include <QButtonGroup>
+#include <QCheckBox>
 #include <QColorDialog>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFileDialog>
+#include <QImage>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QInputDialog>
 #include <QLabel>
 #include <QLineEdit>
 #include <QMainWindow>
+#include <QMatrix4x4>
 #include <QMessageBox>
+#include <QOffscreenSurface>
+#include <QOpenGLBuffer>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLFramebufferObject>
 #include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
 #include <QOpenGLWidget>
 #include <QPushButton>
+#include <QQuaternion>
 #include <QRadioButton>
+#include <QRegularExpression>
+#include <QShortcut>
+#include <QStatusBar>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QTimer>
 #include <QVBoxLayout>
 #include <QtOpenGL>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <future>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <thread>
 #include <vector>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
 
 typedef enum ProjectionType { Parallel, Perspective } ProjectionType_t;
 
@@ -34,8 +73,19 @@ typedef struct AffineTransform {
   float translateY = 0.0f;  // To-DO смещение по Y
   float translateZ = 0.0f;  // To-DO смещение по Z
   float fov = 45.0f;
+  QQuaternion orientation;  // текущая ориентация модели (единичный кватернион)
 } AffineTransform_t;
 
+typedef enum TurntableAxis { AxisX = 0, AxisY, AxisZ } TurntableAxis_t;
+
+typedef struct TurntableSettings {
+  int frames = 120;              // кадров на полный оборот
+  TurntableAxis_t axis = AxisY;  // ось вращения в мировых координатах
+  QSize size = QSize(640, 480);  // размер кадра
+  int fps = 30;                  // частота кадров ролика
+  bool antialiased = true;       // сглаживание ребер
+} TurntableSettings_t;
+
 typedef struct ModelDefinition {
   QColor facetColor;
   float facetWidth = 0;
@@ -64,3 +114,54 @@ typedef enum rotateAction {
 } rotateAction_t;
 
 typedef enum ScaleType { scalePlus, scaleMinus } ScaleType_t;
+
+typedef enum DirtyFlag {
+  DirtyNone = 0,
+  DirtyGeometry = 1 << 0,   // вершины и ребра
+  DirtyTransform = 1 << 1,  // аффинные преобразования и проекция
+  DirtyStyle = 1 << 2,      // цвета, толщины, тип вершин
+  DirtyAll = DirtyGeometry | DirtyTransform | DirtyStyle
+} DirtyFlag_t;
+
+typedef struct FrameStats {
+  int coalescedEvents = 0;     // событий ввода, примененных в последнем кадре
+  int maxCoalescedEvents = 0;  // максимум событий ввода за один кадр
+  long long totalEvents = 0;   // всего событий ввода
+  long long totalFrames = 0;   // всего отрисованных кадров
+  long long skippedFrames = 0;  // кадров без изменений, отрисовка пропущена
+  float frameTimeMs = 0.0f;    // время последнего вызова paintGL
+  int visibleChunks = 0;       // частей сетки, попавших в область видимости
+  int culledChunks = 0;        // частей сетки, отброшенных отсечением
+  int lodLevel = -1;           // уровень детализации (-1 - исходная сетка)
+  long long subPixelCulled = 0;  // ребер короче порога в пикселях
+  float progressiveDone = 1.0f;  // доля ребер, накопленных в режиме
+                                 // прогрессивной отрисовки
+  long long capturedFrames = 0;  // кадров, переданных на запись
+  long long droppedFrames = 0;   // кадров захвата, потерянных при записи
+} FrameStats_t;
+
+typedef struct MeshChunk {
+  unsigned int firstEdge = 0;  // первое ребро части в списке ребер
+  unsigned int edgeCount = 0;  // число ребер части
+  QVector3D boundsMin;         // ограничивающий параллелепипед части
+  QVector3D boundsMax;
+} MeshChunk_t;
+
+typedef struct LodLevel {
+  std::vector<QVector3D> vertices;       // вершины упрощенной сетки
+  std::vector<unsigned int> triangles;   // по 3 индекса на треугольник
+  std::vector<unsigned int> edges;       // пары индексов для отрисовки
+} LodLevel_t;
+
+typedef struct EdgeRange {
+  unsigned int firstEdge = 0;  // первое ребро непрерывного диапазона
+  unsigned int edgeCount = 0;  // число ребер диапазона
+} EdgeRange_t;
+
+typedef struct RenderBenchmark {
+  QString renderer;           // строка GL_RENDERER (например, llvmpipe)
+  int frames = 0;             // кадров на каждый путь отрисовки
+  double immediateMs = 0.0;   // среднее время кадра glBegin/glEnd
+  double retainedMs = 0.0;    // среднее время кадра из буферов VBO/IBO
+  FrameStats_t lastFrame;     // статистика последнего кадра из буферов
+} RenderBenchmark_t;
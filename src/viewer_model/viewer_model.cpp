@@ -12,7 +12,7 @@ namespace s21 {
  */
 void ViewerModel::translateFigure(const translateAction_t &translateAct,
                                   float translateValue) {
-  if (translateValue == 0.0) translateValue = 0.5f;
+  if (translateValue == 0.0) translateValue = kDefaultTranslateStep;
   switch (translateAct) {
     case translateXPlus:
       affine_transform.translateX += translateValue;
@@ -35,42 +35,110 @@ void ViewerModel::translateFigure(const translateAction_t &translateAct,
     default:
       break;
   }
+  invalidateModelMatrix();
 }
 
 /**
  * @brief Вращение фигуры вокруг осей X, Y или Z
  *
+ * Поворот применяется к кватерниону ориентации относительно экранных осей.
+ * Углы rotateAngleX/Y/Z продолжают накапливаться для совместимости.
+ *
  * @param rotateAct Действие вращения (например, rotateXPlus, rotateYMinus)
  * @param rotateValue Угол вращения (если 0.0, используется значение по
  * умолчанию 15.0)
  */
 void ViewerModel::rotateAxis(const rotateAction_t &rotateAct,
                              float rotateValue) {
-  if (rotateValue == 0.0) rotateValue = 15.0f;
+  if (rotateValue == 0.0) rotateValue = kDefaultRotateStep;
+  QVector3D axis;
+  float angle = rotateValue;
   switch (rotateAct) {
     case rotateXPlus:
       affine_transform.rotateAngleX += rotateValue;
+      axis = QVector3D(1.0f, 0.0f, 0.0f);
       break;
     case rotateXMinus:
       affine_transform.rotateAngleX -= rotateValue;
+      axis = QVector3D(1.0f, 0.0f, 0.0f);
+      angle = -rotateValue;
       break;
     case rotateYPlus:
       affine_transform.rotateAngleY += rotateValue;
+      axis = QVector3D(0.0f, 1.0f, 0.0f);
       break;
     case rotateYMinus:
       affine_transform.rotateAngleY -= rotateValue;
+      axis = QVector3D(0.0f, 1.0f, 0.0f);
+      angle = -rotateValue;
       break;
     case rotateZPlus:
       affine_transform.rotateAngleZ += rotateValue;
+      axis = QVector3D(0.0f, 0.0f, 1.0f);
       break;
     case rotateZMinus:
       affine_transform.rotateAngleZ -= rotateValue;
+      axis = QVector3D(0.0f, 0.0f, 1.0f);
+      angle = -rotateValue;
       break;
     default:
-      break;
+      return;
   }
+  applyRotation(QQuaternion::fromAxisAndAngle(axis, angle));
+}
+
+/**
+ * @brief Домножение текущей ориентации на приращение поворота
+ *
+ * Приращение задается в экранных осях, поэтому умножается слева.
+ * Кватернион нормализуется, чтобы ошибка округления не накапливалась.
+ * Углы rotateAngleX/Y/Z увеличиваются на angles, как при вращении кнопками.
+ *
+ * @param rotation Приращение поворота
+ * @param angles Приращение углов вокруг осей X, Y и Z в градусах
+ */
+void ViewerModel::applyRotation(const QQuaternion &rotation,
+                                const QVector3D &angles) {
+  affine_transform.rotateAngleX += angles.x();
+  affine_transform.rotateAngleY += angles.y();
+  affine_transform.rotateAngleZ += angles.z();
+  affine_transform.orientation =
+      (rotation * affine_transform.orientation).normalized();
+  invalidateModelMatrix();
+}
+
+/**
+ * @brief Пометка кэшированной матрицы модели как устаревшей
+ */
+void ViewerModel::invalidateModelMatrix() {
+  modelMatrixValid = false;
+  markDirty(DirtyTransform);
+}
+
+/**
+ * @brief Пометка части состояния модели как измененной
+ *
+ * @param flags Комбинация значений DirtyFlag
+ */
+void ViewerModel::markDirty(unsigned int flags) {
+  dirtyFlags |= flags;
+  if (flags & DirtyGeometry) ++meshGeneration;
 }
 
+/**
+ * @brief Получение флагов измененного состояния
+ *
+ * @return Комбинация значений DirtyFlag, измененных после последнего сброса
+ */
+unsigned int ViewerModel::getDirtyFlags() const { return dirtyFlags; }
+
+/**
+ * @brief Сброс флагов измененного состояния после их обработки
+ *
+ * @param flags Комбинация значений DirtyFlag, которые нужно сбросить
+ */
+void ViewerModel::clearDirtyFlags(unsigned int flags) { dirtyFlags &= ~flags; }
+
 /**
  * @brief Установка типа проекции (параллельная или перспективная)
  *
@@ -81,6 +149,7 @@ void ViewerModel::setProjection(const ProjectionType_t &prog_type) {
     affine_transform.projectionType = Parallel;
   else
     affine_transform.projectionType = Perspective;
+  markDirty(DirtyTransform);
 }
 
 /**
@@ -124,6 +193,7 @@ void ViewerModel::scaleFigure(const ScaleType_t &scaleF, float scaleValue) {
     if (affine_transform.scaleFactor > 10.0f)
       affine_transform.scaleFactor = 10.0f;
   }
+  invalidateModelMatrix();
 }
 
 /**
@@ -141,10 +211,13 @@ void ViewerModel::setDefault(int flag) {
   affine_transform.translateY = 0.0f;
   affine_transform.translateZ = 0.0f;
   affine_transform.fov = 45.0f;
+  affine_transform.orientation = QQuaternion();
+  invalidateModelMatrix();
   if (flag) {
     modelDefinition.facetWidth = 0.0f;
     modelDefinition.verticeType = Square;
     modelDefinition.verticeWidth = 5.0f;
+    markDirty(DirtyStyle);
   }
 }
 
@@ -167,6 +240,7 @@ void ViewerModel::setFacetWidth(const ScaleType_t &scaleF) {
       modelDefinition.facetWidth -= 0.0005;
     }
   }
+  markDirty(DirtyStyle);
 }
 
 /**
@@ -211,6 +285,7 @@ ViewerModel::ViewerModel() : setColor_(nullptr) { readModelDefinition(); };
  * @brief Деструктор класса ViewerModel
  */
 ViewerModel::~ViewerModel() {
+  cancelLodChainBuild();
   saveModelDefinition();
   delete setColor_;
 };
@@ -227,6 +302,7 @@ void ViewerModel::SetColorStrategy(SetColor *strategy, const QColor &color) {
   }
   setColor_ = strategy;
   setColor_->setColor(color, modelDefinition);
+  markDirty(DirtyStyle);
 }
 
 /**
@@ -272,6 +348,42 @@ void ViewerModel::setVerticeWidth(const ScaleType_t &scaleF) {
     if (modelDefinition.verticeWidth >= 2.0f)
       modelDefinition.verticeWidth -= 1.0f;
   }
+  markDirty(DirtyStyle);
+}
+
+/**
+ * @brief Установка точного значения толщины ребер (для отмены команд)
+ *
+ * @param facetWidth Толщина ребер
+ */
+void ViewerModel::setFacetWidthValue(float facetWidth) {
+  modelDefinition.facetWidth = std::max(0.0f, facetWidth);
+  markDirty(DirtyStyle);
+}
+
+/**
+ * @brief Установка точного значения размера вершин (для отмены команд)
+ *
+ * @param verticeWidth Размер вершин
+ */
+void ViewerModel::setVerticeWidthValue(float verticeWidth) {
+  modelDefinition.verticeWidth = verticeWidth;
+  markDirty(DirtyStyle);
+}
+
+/**
+ * @brief Изменение масштаба и угла обзора на заданные приращения
+ *
+ * В отличие от scaleFigure, приращения применяются к обоим параметрам
+ * независимо от текущей проекции. Используется для отмены масштабирования.
+ *
+ * @param scaleDelta Приращение коэффициента масштабирования
+ * @param fovDelta Приращение угла обзора
+ */
+void ViewerModel::adjustScale(float scaleDelta, float fovDelta) {
+  affine_transform.scaleFactor += scaleDelta;
+  affine_transform.fov += fovDelta;
+  invalidateModelMatrix();
 }
 
 /**
@@ -281,16 +393,19 @@ void ViewerModel::setVerticeWidth(const ScaleType_t &scaleF) {
  */
 void ViewerModel::setVerticeType(const VerticeType_t &verticeType) {
   modelDefinition.verticeType = verticeType;
+  markDirty(DirtyStyle);
 }
 
 /**
  * @brief Обработка перемещения мыши (вращение фигуры)
  *
+ * Смещение курсора превращается в приращение поворота по принципу arcball
+ * и домножается на текущую ориентацию.
+ *
  * @param delta Изменение координат мыши
  */
 void ViewerModel::MouseButtonMove(QPoint delta) {
-  affine_transform.rotateAngleX += delta.y();  // вращение вокруг оси X
-  affine_transform.rotateAngleY += delta.x();  // вращение вокруг оси Y
+  applyRotation(arcballRotation(delta), mouseAngles(delta));
 }
 
 /**
@@ -299,7 +414,55 @@ void ViewerModel::MouseButtonMove(QPoint delta) {
  * @param delta Изменение координат колеса мыши
  */
 void ViewerModel::MouseWheelMove(QPoint delta) {
-  affine_transform.rotateAngleZ += delta.x();  // вращение вокруг оси Z
+  applyRotation(rollRotation(delta), rollAngles(delta));
+}
+
+/**
+ * @brief Приращение углов rotateAngleX/Y для смещения курсора
+ *
+ * @param delta Смещение курсора в пикселях
+ * @return Приращение углов вокруг осей X, Y и Z в градусах
+ */
+QVector3D ViewerModel::mouseAngles(QPoint delta) {
+  // вертикальное смещение вращает вокруг оси X, горизонтальное - вокруг Y
+  return QVector3D(delta.y(), delta.x(), 0.0f);
+}
+
+/**
+ * @brief Приращение угла rotateAngleZ для вращения вокруг оси взгляда
+ *
+ * @param delta Смещение колеса или курсора
+ * @return Приращение углов вокруг осей X, Y и Z в градусах
+ */
+QVector3D ViewerModel::rollAngles(QPoint delta) {
+  return QVector3D(0.0f, 0.0f, delta.x());
+}
+
+/**
+ * @brief Приращение поворота arcball для смещения курсора
+ *
+ * Ось поворота лежит в плоскости экрана перпендикулярно смещению, угол равен
+ * длине смещения в градусах (один пиксель - один градус).
+ *
+ * @param delta Смещение курсора в пикселях
+ * @return Кватернион приращения поворота
+ */
+QQuaternion ViewerModel::arcballRotation(QPoint delta) {
+  float dx = static_cast<float>(delta.x());
+  float dy = static_cast<float>(delta.y());
+  float angle = std::sqrt(dx * dx + dy * dy);
+  if (angle == 0.0f) return QQuaternion();
+  return QQuaternion::fromAxisAndAngle(QVector3D(dy, dx, 0.0f) / angle, angle);
+}
+
+/**
+ * @brief Приращение поворота вокруг оси Z (взгляда) для смещения курсора
+ *
+ * @param delta Смещение курсора в пикселях, используется только по X
+ * @return Кватернион приращения поворота
+ */
+QQuaternion ViewerModel::rollRotation(QPoint delta) {
+  return QQuaternion::fromAxisAndAngle(0.0f, 0.0f, 1.0f, delta.x());
 }
 
 /**
@@ -309,14 +472,15 @@ void ViewerModel::MouseWheelMove(QPoint delta) {
  */
 void ViewerModel::loadOBJ(const QString &filePath) {
   ViewerModel::setDefault(0);
-  affine_transform.rotateAngleX = 0.0f;
-  affine_transform.rotateAngleY = 0.0f;
-  affine_transform.rotateAngleZ = 0.0f;
-  affine_transform.scaleFactor = 1.0f;
-  affine_transform.translateX = 0.0f;
-  affine_transform.projectionType = Parallel;
+  cancelLodChainBuild();
   vertices.clear();
   facets.clear();
+  edges.clear();
+  chunks.clear();
+  triangles.clear();
+  lodChain.clear();
+  ++lodChainRevision;
+  markDirty(DirtyGeometry);
 
   std::string path = filePath.toStdString();
   std::ifstream file(path);
@@ -326,6 +490,7 @@ void ViewerModel::loadOBJ(const QString &filePath) {
   }
 
   std::string line;
+  std::vector<unsigned int> face;
   while (std::getline(file, line)) {
     if (line.substr(0, 2) == "v ") {
       std::istringstream s(line.substr(2));
@@ -335,29 +500,364 @@ void ViewerModel::loadOBJ(const QString &filePath) {
     } else if (line.substr(0, 2) == "f ") {
       std::istringstream s(line.substr(2));
       std::string token;
+      face.clear();
       while (s >> token) {
         unsigned int index = std::stoul(token.substr(0, token.find('/'))) - 1;
         facets.push_back(index);
+        face.push_back(index);
+      }
+      // веерная триангуляция грани для упрощения сетки
+      for (size_t i = 2; i < face.size(); ++i) {
+        triangles.push_back(face[0]);
+        triangles.push_back(face[i - 1]);
+        triangles.push_back(face[i]);
       }
     }
   }
   file.close();
   normalizeVertices();
+  buildEdges();
+  boundingRadius = 0;
+  for (const QVector3D &v : vertices)
+    boundingRadius = std::max(boundingRadius, v.length());
+  startLodChainBuild();
+}
+
+/**
+ * @brief Запуск построения цепочки упрощенных сеток в фоновом потоке
+ *
+ * Поток работает с копией вершин и треугольников, поэтому модель можно
+ * изменять во время построения. Треугольники с индексами за пределами
+ * списка вершин отбрасываются.
+ */
+void ViewerModel::startLodChainBuild() {
+  std::vector<unsigned int> valid;
+  valid.reserve(triangles.size());
+  for (size_t i = 0; i + 2 < triangles.size(); i += 3) {
+    if (triangles[i] < vertices.size() && triangles[i + 1] < vertices.size() &&
+        triangles[i + 2] < vertices.size())
+      valid.insert(valid.end(), triangles.begin() + i,
+                   triangles.begin() + i + 3);
+  }
+  if (valid.size() / 3 < 2 * kMinLodTriangles) return;
+  lodChainCancel = std::make_shared<std::atomic<bool>>(false);
+  pendingLodChain = std::async(
+      std::launch::async,
+      [cancel = lodChainCancel, snapshot = vertices,
+       indices = std::move(valid)]() {
+        return MeshSimplifier::buildChain(snapshot, indices, kMinLodTriangles,
+                                          kMaxLodLevels, cancel.get());
+      });
+}
+
+/**
+ * @brief Остановка фонового построения цепочки упрощенных сеток
+ */
+void ViewerModel::cancelLodChainBuild() {
+  if (!pendingLodChain.valid()) return;
+  lodChainCancel->store(true);
+  pendingLodChain.wait();
+  pendingLodChain = std::future<std::vector<LodLevel_t>>();
+}
+
+/**
+ * @brief Проверка, идет ли фоновое построение цепочки упрощенных сеток
+ *
+ * @return true, если результат построения еще не готов
+ */
+bool ViewerModel::isLodChainBuilding() const {
+  return pendingLodChain.valid() &&
+         pendingLodChain.wait_for(std::chrono::seconds(0)) !=
+             std::future_status::ready;
+}
+
+/**
+ * @brief Ожидание завершения фонового построения цепочки упрощенных сеток
+ */
+void ViewerModel::waitForLodChain() {
+  if (pendingLodChain.valid()) pendingLodChain.wait();
+  getLodChain();
+}
+
+/**
+ * @brief Получение цепочки упрощенных сеток
+ *
+ * Если фоновое построение завершилось, результат забирается в модель.
+ * Пока построение идет, возвращается пустая цепочка.
+ *
+ * @return Уровни от самого подробного к самому грубому
+ */
+const std::vector<LodLevel_t> &ViewerModel::getLodChain() {
+  if (pendingLodChain.valid() &&
+      pendingLodChain.wait_for(std::chrono::seconds(0)) ==
+          std::future_status::ready) {
+    lodChain = pendingLodChain.get();
+    ++lodChainRevision;
+  }
+  return lodChain;
+}
+
+/**
+ * @brief Получение версии цепочки упрощенных сеток
+ *
+ * @return Номер, увеличивающийся при каждой смене цепочки
+ */
+unsigned long long ViewerModel::getLodChainRevision() const {
+  return lodChainRevision;
+}
+
+/**
+ * @brief Выбор уровня детализации по размеру модели на экране
+ *
+ * Нужное число треугольников оценивается по площади описанного круга
+ * модели на экране. Выбирается самый грубый уровень, в котором
+ * треугольников не меньше нужного.
+ *
+ * @param projectedPixels Диаметр описанной сферы модели на экране в пикселях.
+ * @return Номер уровня или -1 для исходной сетки
+ */
+int ViewerModel::selectLodLevel(float projectedPixels) {
+  const std::vector<LodLevel_t> &chain = getLodChain();
+  float radius = projectedPixels / 2.0f;
+  float area = static_cast<float>(M_PI) * radius * radius;
+  float needed = area / kPixelsPerTriangle;
+  for (int level = static_cast<int>(chain.size()) - 1; level >= 0; --level)
+    if (chain[level].triangles.size() / 3 >= needed) return level;
+  return -1;
+}
+
+/**
+ * @brief Сохранение уровня детализации в файл OBJ
+ *
+ * @param level Номер уровня в цепочке.
+ * @param filePath Путь к файлу OBJ.
+ * @return true, если файл записан
+ */
+bool ViewerModel::exportLodLevel(size_t level, const QString &filePath) {
+  const std::vector<LodLevel_t> &chain = getLodChain();
+  if (level >= chain.size()) return false;
+  std::ofstream file(filePath.toStdString());
+  if (!file) {
+    qWarning() << "Failed to open file:" << filePath;
+    return false;
+  }
+  const LodLevel_t &lod = chain[level];
+  for (const QVector3D &v : lod.vertices)
+    file << "v " << v.x() << " " << v.y() << " " << v.z() << "\n";
+  for (size_t i = 0; i + 2 < lod.triangles.size(); i += 3)
+    file << "f " << lod.triangles[i] + 1 << " " << lod.triangles[i + 1] + 1
+         << " " << lod.triangles[i + 2] + 1 << "\n";
+  return static_cast<bool>(file);
+}
+
+/**
+ * @brief Получение треугольников модели (веерная триангуляция граней)
+ *
+ * @return Вектор индексов вершин, по 3 на треугольник
+ */
+const std::vector<unsigned int> &ViewerModel::getTriangles() {
+  return triangles;
 }
 
+/**
+ * @brief Получение радиуса описанной сферы нормализованной модели
+ */
+float ViewerModel::getBoundingRadius() const { return boundingRadius; }
+
 /**
  * @brief Получение вершин модели
  *
  * @return Вектор вершин модели
  */
-std::vector<QVector3D> ViewerModel::getVertices() { return vertices; };
+const std::vector<QVector3D> &ViewerModel::getVertices() { return vertices; };
 
 /**
  * @brief Получение ребер модели
  *
  * @return Вектор ребер модели
  */
-std::vector<unsigned int> ViewerModel::getFacets() { return facets; };
+const std::vector<unsigned int> &ViewerModel::getFacets() { return facets; };
+
+/**
+ * @brief Получение ребер модели в виде пар индексов (для GL_LINES)
+ *
+ * @return Вектор пар индексов вершин
+ */
+const std::vector<unsigned int> &ViewerModel::getEdges() { return edges; }
+
+/**
+ * @brief Получение упрощенного набора ребер для отрисовки во время вращения
+ *
+ * Из списка ребер берется каждое k-е так, чтобы их число не превышало
+ * бюджета. Ребра упорядочены по частям сетки, поэтому выборка равномерно
+ * покрывает всю модель. Набор пересчитывается только при смене сетки или
+ * бюджета.
+ *
+ * @param budget Максимальное число ребер (0 - упрощение отключено).
+ * @return Пары индексов вершин; пустой вектор, если упрощение не нужно
+ */
+const std::vector<unsigned int> &ViewerModel::getLodEdges(size_t budget) {
+  if (lodValid && lodGeneration == meshGeneration && lodBudget == budget)
+    return lodEdges;
+  lodEdges.clear();
+  size_t edgeCount = edges.size() / 2;
+  if (budget > 0 && edgeCount > budget) {
+    size_t stride = (edgeCount + budget - 1) / budget;
+    lodEdges.reserve((edgeCount / stride + 1) * 2);
+    for (size_t i = 0; i < edgeCount; i += stride) {
+      lodEdges.push_back(edges[2 * i]);
+      lodEdges.push_back(edges[2 * i + 1]);
+    }
+  }
+  lodGeneration = meshGeneration;
+  lodBudget = budget;
+  lodValid = true;
+  ++lodRevision;
+  return lodEdges;
+}
+
+/**
+ * @brief Получение номера версии упрощенного набора ребер
+ *
+ * @return Номер, увеличивающийся при каждом пересчете набора
+ */
+unsigned long long ViewerModel::getLodRevision() const { return lodRevision; }
+
+/**
+ * @brief Получение частей сетки для отсечения по пирамиде видимости
+ *
+ * @return Вектор частей с диапазонами ребер и ограничивающими
+ * параллелепипедами
+ */
+const std::vector<MeshChunk_t> &ViewerModel::getChunks() { return chunks; }
+
+/**
+ * @brief Получение поколения сетки модели
+ *
+ * Поколение увеличивается при каждом изменении вершин или ребер, поэтому
+ * по нему можно определить, что загруженные в видеопамять данные устарели.
+ *
+ * @return Номер поколения сетки
+ */
+unsigned long long ViewerModel::getMeshGeneration() const {
+  return meshGeneration;
+}
+
+/**
+ * @brief Получение четырехугольников толстых ребер для текущей ширины
+ *
+ * @return Координаты вершин четырехугольников (по 4 вершины на ребро)
+ */
+const std::vector<float> &ViewerModel::getThickEdgeQuads() {
+  return thickEdgeCache.quads(vertices, edges, meshGeneration,
+                              modelDefinition.facetWidth);
+}
+
+/**
+ * @brief Число перестроений кэша толстых ребер
+ */
+int ViewerModel::getThickEdgeRebuildCount() const {
+  return thickEdgeCache.rebuildCount();
+}
+
+/**
+ * @brief Получение четырехугольников толстых ребер
+ *
+ * Четырехугольники перестраиваются параллельно, только если изменилось
+ * поколение сетки или ширина ребер.
+ *
+ * @param vertices Вершины модели.
+ * @param edges Пары индексов вершин.
+ * @param generation Поколение сетки.
+ * @param width Ширина ребер.
+ * @return Координаты вершин четырехугольников (по 4 вершины на ребро)
+ */
+const std::vector<float> &ThickEdgeCache::quads(
+    const std::vector<QVector3D> &vertices,
+    const std::vector<unsigned int> &edges, unsigned long long generation,
+    float width) {
+  if (valid && generation == cachedGeneration && width == cachedWidth)
+    return corners;
+  gatherEndpoints(vertices, edges);
+  corners.resize(startX.size() * 12);
+  float halfWidth = width / 2.0f;
+  parallelFor(startX.size(), 4096, [this, halfWidth](size_t begin, size_t end) {
+    buildQuads(begin, end, halfWidth);
+  });
+  cachedGeneration = generation;
+  cachedWidth = width;
+  valid = true;
+  ++rebuilds;
+  return corners;
+}
+
+/**
+ * @brief Число перестроений кэша
+ */
+int ThickEdgeCache::rebuildCount() const { return rebuilds; }
+
+/**
+ * @brief Раскладка концов ребер по массивам координат
+ */
+void ThickEdgeCache::gatherEndpoints(const std::vector<QVector3D> &vertices,
+                                     const std::vector<unsigned int> &edges) {
+  size_t count = edges.size() / 2;
+  for (std::vector<float> *array :
+       {&startX, &startY, &startZ, &endX, &endY, &endZ})
+    array->resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    const QVector3D &start = vertices[edges[2 * i]];
+    const QVector3D &end = vertices[edges[2 * i + 1]];
+    startX[i] = start.x();
+    startY[i] = start.y();
+    startZ[i] = start.z();
+    endX[i] = end.x();
+    endY[i] = end.y();
+    endZ[i] = end.z();
+  }
+}
+
+/**
+ * @brief Расчет четырехугольников для ребер [begin, end)
+ *
+ * Перпендикуляр строится так же, как раньше в DrawFacetThick: векторное
+ * произведение направления ребра на ось X, а для ребер вдоль оси X - на
+ * ось Y. Ветвления заменены выбором значений, чтобы цикл векторизовался.
+ */
+void ThickEdgeCache::buildQuads(size_t begin, size_t end, float halfWidth) {
+  float *out = corners.data();
+  for (size_t i = begin; i < end; ++i) {
+    float dx = endX[i] - startX[i];
+    float dy = endY[i] - startY[i];
+    float dz = endZ[i] - startZ[i];
+    float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+    // ребро вдоль оси X: вместо (1, 0, 0) берется (0, 1, 0)
+    float alongX = dx > 0.99f * length && length > 0.0f ? 1.0f : 0.0f;
+    float ax = 1.0f - alongX;
+    float ay = alongX;
+    float px = -dz * ay;
+    float py = dz * ax;
+    float pz = dx * ay - dy * ax;
+    float cross = std::sqrt(px * px + py * py + pz * pz);
+    float scale = cross > 0.0f ? halfWidth / cross : 0.0f;
+    px *= scale;
+    py *= scale;
+    pz *= scale;
+    float *quad = out + i * 12;
+    quad[0] = startX[i] - px;
+    quad[1] = startY[i] - py;
+    quad[2] = startZ[i] - pz;
+    quad[3] = startX[i] + px;
+    quad[4] = startY[i] + py;
+    quad[5] = startZ[i] + pz;
+    quad[6] = endX[i] + px;
+    quad[7] = endY[i] + py;
+    quad[8] = endZ[i] + pz;
+    quad[9] = endX[i] - px;
+    quad[10] = endY[i] - py;
+    quad[11] = endZ[i] - pz;
+  }
+}
 
 /**
  * @brief Получение параметров аффинных преобразований
@@ -375,6 +875,64 @@ AffineTransform_t ViewerModel::getAffineTransform() {
  */
 ModelDefinition_t ViewerModel::getModelDefinition() { return modelDefinition; }
 
+/**
+ * @brief Получение матрицы модели (масштаб, поворот, перенос)
+ *
+ * Матрица пересчитывается только после изменения аффинных преобразований,
+ * в остальное время возвращается кэшированное значение.
+ *
+ * @return Матрица модели
+ */
+const QMatrix4x4 &ViewerModel::getModelMatrix() {
+  if (!modelMatrixValid) {
+    modelMatrix = modelMatrixFor(affine_transform);
+    modelMatrixValid = true;
+  }
+  return modelMatrix;
+}
+
+/**
+ * @brief Получение матрицы проекции для текущего типа проекции
+ *
+ * @param aspectRatio Отношение ширины области вывода к высоте
+ * @return Матрица проекции
+ */
+QMatrix4x4 ViewerModel::getProjectionMatrix(float aspectRatio) {
+  return projectionMatrixFor(affine_transform, aspectRatio);
+}
+
+/**
+ * @brief Матрица модели для заданных аффинных преобразований
+ *
+ * @param transform Масштаб, поворот и перенос модели
+ * @return Матрица модели
+ */
+QMatrix4x4 ViewerModel::modelMatrixFor(const AffineTransform_t &transform) {
+  QMatrix4x4 matrix;
+  matrix.scale(transform.scaleFactor);
+  matrix.rotate(transform.orientation);
+  matrix.translate(transform.translateX, transform.translateY,
+                   transform.translateZ);
+  return matrix;
+}
+
+/**
+ * @brief Матрица проекции для заданного типа проекции
+ *
+ * @param transform Тип проекции и угол обзора
+ * @param aspectRatio Отношение ширины области вывода к высоте
+ * @return Матрица проекции
+ */
+QMatrix4x4 ViewerModel::projectionMatrixFor(const AffineTransform_t &transform,
+                                            float aspectRatio) {
+  QMatrix4x4 projection;
+  if (transform.projectionType == Perspective)
+    projection.perspective(transform.fov, aspectRatio, 0.01f, 100.0f);
+  else
+    projection.ortho(-2.0f, 2.0f, -2.0f, 2.0f, -2.0f, 2.0f);
+  return projection;
+}
+
 /**
  * @brief Нормализация вершин модели (центрирование и масштабирование)
  */
@@ -412,69 +970,385 @@ void ViewerModel::normalizeVertices() {
     v.setY((v.y() - centerY) / maxSize * 2.0f);  // Нормализация по Y
     v.setZ((v.z() - centerZ) / maxSize * 2.0f);  // Нормализация по Z
   }
+  markDirty(DirtyGeometry);
 }
 
 /**
- * @brief Сохранение параметров модели в файл
+ * @brief Построение списка ребер модели в виде пар индексов
+ *
+ * Ребра соединяют соседние индексы списка граней и замыкаются в контур, как
+ * при отрисовке GL_LINE_LOOP. Индексы за пределами списка вершин
+ * пропускаются. Затем ребра группируются по частям сетки для отсечения.
  */
-void ViewerModel::saveModelDefinition() {
-  QFile file("../model.txt");
-  if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-    qWarning() << "File not found";
-    return;
+void ViewerModel::buildEdges() {
+  edges.clear();
+  std::vector<unsigned int> valid;
+  valid.reserve(facets.size());
+  for (unsigned int facet : facets)
+    if (facet < vertices.size()) valid.push_back(facet);
+  if (valid.size() >= 2) {
+    edges.reserve(valid.size() * 2);
+    for (size_t i = 0; i < valid.size(); ++i) {
+      edges.push_back(valid[i]);
+      edges.push_back(valid[(i + 1) % valid.size()]);
+    }
   }
-  QTextStream out(&file);
-  out << modelDefinition.facetColor.name() << " "
-      << modelDefinition.verticeColor.name() << " "
-      << modelDefinition.backgroundColor.name() << " "
-      << modelDefinition.facetWidth << " " << modelDefinition.verticeType << " "
-      << modelDefinition.verticeWidth;
-  file.close();
+  buildChunks();
+  markDirty(DirtyGeometry);
 }
 
 /**
- * @brief Чтение параметров модели из файла
+ * @brief Разбиение ребер на пространственные части
+ *
+ * Ограничивающий параллелепипед модели делится на равномерную сетку ячеек,
+ * число которых рассчитано на kChunkEdges ребер в ячейке. Ребра
+ * переставляются сортировкой подсчетом по ячейке середины, так что ребра
+ * одной части идут в списке подряд.
  */
-void ViewerModel::readModelDefinition() {
-  QFile file("../model.txt");
-  if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-    qWarning() << "File not found";
-    return;
+void ViewerModel::buildChunks() {
+  chunks.clear();
+  size_t edgeCount = edges.size() / 2;
+  if (edgeCount == 0) return;
+  QVector3D lo = vertices[edges[0]];
+  QVector3D hi = lo;
+  for (unsigned int index : edges) {
+    const QVector3D &v = vertices[index];
+    lo = QVector3D(std::min(lo.x(), v.x()), std::min(lo.y(), v.y()),
+                   std::min(lo.z(), v.z()));
+    hi = QVector3D(std::max(hi.x(), v.x()), std::max(hi.y(), v.y()),
+                   std::max(hi.z(), v.z()));
   }
-  QTextStream in(&file);
-  QString line = in.readLine().trimmed();
-  file.close();
-  QStringList definition = line.split(" ");
-  if (definition.size() != 6) {
-    qWarning() << "Файл не содержит корректных значений:" << line;
+  size_t cells = (edgeCount + kChunkEdges - 1) / kChunkEdges;
+  int grid = std::max(1, static_cast<int>(std::ceil(std::cbrt(cells))));
+  QVector3D extent = hi - lo;
+  auto cellAxis = [grid](float value, float low, float size) {
+    if (size <= 0.0f) return 0;
+    int cell = static_cast<int>((value - low) / size * grid);
+    return std::min(std::max(cell, 0), grid - 1);
+  };
+  std::vector<unsigned int> cellOf(edgeCount);
+  std::vector<unsigned int> offsets(grid * grid * grid + 1, 0);
+  for (size_t i = 0; i < edgeCount; ++i) {
+    QVector3D middle =
+        (vertices[edges[2 * i]] + vertices[edges[2 * i + 1]]) / 2.0f;
+    int x = cellAxis(middle.x(), lo.x(), extent.x());
+    int y = cellAxis(middle.y(), lo.y(), extent.y());
+    int z = cellAxis(middle.z(), lo.z(), extent.z());
+    cellOf[i] = (z * grid + y) * grid + x;
+    ++offsets[cellOf[i] + 1];
+  }
+  for (size_t cell = 1; cell < offsets.size(); ++cell)
+    offsets[cell] += offsets[cell - 1];
+  std::vector<unsigned int> sorted(edges.size());
+  std::vector<unsigned int> next(offsets.begin(), offsets.end() - 1);
+  for (size_t i = 0; i < edgeCount; ++i) {
+    unsigned int slot = next[cellOf[i]]++;
+    sorted[2 * slot] = edges[2 * i];
+    sorted[2 * slot + 1] = edges[2 * i + 1];
+  }
+  edges.swap(sorted);
+  for (size_t cell = 0; cell + 1 < offsets.size(); ++cell) {
+    if (offsets[cell] == offsets[cell + 1]) continue;
+    MeshChunk_t chunk;
+    chunk.firstEdge = offsets[cell];
+    chunk.edgeCount = offsets[cell + 1] - offsets[cell];
+    chunk.boundsMin = chunk.boundsMax = vertices[edges[2 * chunk.firstEdge]];
+    for (unsigned int i = 2 * chunk.firstEdge;
+         i < 2 * (chunk.firstEdge + chunk.edgeCount); ++i) {
+      const QVector3D &v = vertices[edges[i]];
+      chunk.boundsMin =
+          QVector3D(std::min(chunk.boundsMin.x(), v.x()),
+                    std::min(chunk.boundsMin.y(), v.y()),
+                    std::min(chunk.boundsMin.z(), v.z()));
+      chunk.boundsMax =
+          QVector3D(std::max(chunk.boundsMax.x(), v.x()),
+                    std::max(chunk.boundsMax.y(), v.y()),
+                    std::max(chunk.boundsMax.z(), v.z()));
+    }
+    chunks.push_back(chunk);
   }
-  QString facetColorHex = definition[0];
-  QString verticeColorHex = definition[1];
-  QString backgroundColorHex = definition[2];
-  modelDefinition.facetColor = QColor(facetColorHex);
-  modelDefinition.verticeColor = QColor(verticeColorHex);
-  modelDefinition.backgroundColor = QColor(backgroundColorHex);
-
-  float facetWidth = definition[3].toFloat();
-  VerticeType_t verticeType;
-  if (definition[4] == "0")
-    verticeType = Square;
-  else if (definition[4] == "1")
-    verticeType = Circle;
-  else if (definition[4] == "2")
-    verticeType = None;
-  float verticeWidth = definition[5].toFloat();
-
-  modelDefinition.facetWidth = facetWidth;
-  modelDefinition.verticeType = verticeType;
-  modelDefinition.verticeWidth = verticeWidth;
 }
 
 /**
- * @brief Преобразование строки в число с плавающей точкой
+ * @brief Проверка пересечения части сетки с пирамидой видимости
  *
- * @param inputText Входная строка
- * @return Число с плавающей точкой
+ * Углы ограничивающего параллелепипеда переводятся в пространство
+ * отсечения. Часть невидима, если все углы лежат за одной плоскостью
+ * отсечения; проверка консервативна.
+ *
+ * @param chunk Часть сетки.
+ * @param mvp Произведение матриц проекции и модели.
+ * @return true, если часть может быть видна.
+ */
+bool ViewerModel::isChunkVisible(const MeshChunk_t &chunk,
+                                 const QMatrix4x4 &mvp) {
+  unsigned int outside = 0x3f;
+  for (int corner = 0; corner < 8; ++corner) {
+    QVector4D point(corner & 1 ? chunk.boundsMax.x() : chunk.boundsMin.x(),
+                    corner & 2 ? chunk.boundsMax.y() : chunk.boundsMin.y(),
+                    corner & 4 ? chunk.boundsMax.z() : chunk.boundsMin.z(),
+                    1.0f);
+    QVector4D clip = mvp * point;
+    unsigned int planes = 0;
+    if (clip.x() < -clip.w()) planes |= 1;
+    if (clip.x() > clip.w()) planes |= 2;
+    if (clip.y() < -clip.w()) planes |= 4;
+    if (clip.y() > clip.w()) planes |= 8;
+    if (clip.z() < -clip.w()) planes |= 16;
+    if (clip.z() > clip.w()) planes |= 32;
+    outside &= planes;
+    if (outside == 0) return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Остановка потоков пула
+ */
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread &worker : workers) worker.join();
+}
+
+/**
+ * @brief Выполнение задания частями на потоках пула и вызывающем потоке
+ *
+ * Возвращается, когда обработаны все части и ни один поток пула больше не
+ * обращается к заданию.
+ *
+ * @param count Размер диапазона.
+ * @param chunks Число частей.
+ * @param task Вызов функции для части [begin, end).
+ * @param function Функция задания.
+ */
+void WorkerPool::execute(size_t count, size_t chunks, Task task,
+                         void *function) {
+  if (workers.empty()) {
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 1; i < threads; ++i)
+      workers.emplace_back(&WorkerPool::work, this);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    task_ = task;
+    function_ = function;
+    count_ = count;
+    chunks_ = chunks;
+    chunkSize = (count + chunks - 1) / chunks;
+    nextChunk.store(0);
+    doneChunks = 0;
+    ++generation;
+  }
+  wake.notify_all();
+  processChunks();
+  std::unique_lock<std::mutex> lock(mutex);
+  finished.wait(lock, [this] { return doneChunks == chunks_ && active == 0; });
+  task_ = nullptr;
+}
+
+/**
+ * @brief Обработка частей текущего задания, пока они не закончатся
+ */
+void WorkerPool::processChunks() {
+  size_t done = 0;
+  for (size_t chunk = nextChunk++; chunk < chunks_; chunk = nextChunk++) {
+    size_t begin = chunk * chunkSize;
+    size_t end = std::min(begin + chunkSize, count_);
+    if (begin < end) task_(function_, begin, end);
+    ++done;
+  }
+  if (done == 0) return;
+  std::lock_guard<std::mutex> lock(mutex);
+  doneChunks += done;
+  if (doneChunks == chunks_) finished.notify_all();
+}
+
+/**
+ * @brief Цикл потока пула: ожидание задания и обработка его частей
+ */
+void WorkerPool::work() {
+  unsigned long long seen = 0;
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    wake.wait(lock, [&] {
+      return stopping || (task_ != nullptr && generation != seen);
+    });
+    if (stopping) return;
+    seen = generation;
+    ++active;
+    lock.unlock();
+    processChunks();
+    lock.lock();
+    if (--active == 0) finished.notify_all();
+  }
+}
+
+/**
+ * @brief Отбрасывание ребер, проекция которых короче порога в пикселях
+ *
+ * Вершины проецируются матрицей mvp один раз, затем ребра диапазонов
+ * проверяются по экранной длине. Обе стадии выполняются параллельно на
+ * постоянных потоках cullPool (малые сетки - в вызывающем потоке); каждый
+ * поток пишет в свою часть cullSlices, и части склеиваются по порядку.
+ * Ребра с концом за наблюдателем сохраняются.
+ *
+ * @param mvp Произведение матриц проекции и модели.
+ * @param viewport Размер области вывода в пикселях.
+ * @param threshold Минимальная длина ребра в пикселях.
+ * @param ranges Диапазоны проверяемых ребер.
+ * @param kept Пары индексов сохраненных ребер (перезаписываются).
+ * @return Число отброшенных ребер
+ */
+size_t ViewerModel::cullSubPixelEdges(const QMatrix4x4 &mvp,
+                                      const QSizeF &viewport, float threshold,
+                                      const std::vector<EdgeRange_t> &ranges,
+                                      std::vector<unsigned int> &kept) {
+  kept.clear();
+  float halfWidth = static_cast<float>(viewport.width()) / 2.0f;
+  float halfHeight = static_cast<float>(viewport.height()) / 2.0f;
+  projected.resize(vertices.size() * 2);
+  cullPool.run(vertices.size(), 16384, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      QVector4D clip = mvp * QVector4D(vertices[i], 1.0f);
+      bool behind = clip.w() <= 0.0f;
+      projected[2 * i] = behind ? NAN : clip.x() / clip.w() * halfWidth;
+      projected[2 * i + 1] = behind ? NAN : clip.y() / clip.w() * halfHeight;
+    }
+  });
+  size_t total = 0;
+  for (const EdgeRange_t &range : ranges) total += range.edgeCount;
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  size_t slices = std::max<size_t>(1, std::min(threads, total / 16384));
+  cullSlices.resize(slices);
+  float limit = threshold * threshold;
+  cullPool.run(slices, 1, [&](size_t first, size_t last) {
+    for (size_t slice = first; slice < last; ++slice) {
+      std::vector<unsigned int> &out = cullSlices[slice];
+      out.clear();
+      size_t begin = total * slice / slices;
+      size_t end = total * (slice + 1) / slices;
+      size_t offset = 0;
+      for (const EdgeRange_t &range : ranges) {
+        if (offset >= end) break;
+        size_t from = std::max(begin, offset);
+        size_t to = std::min(end, offset + range.edgeCount);
+        for (size_t k = from; k < to; ++k) {
+          size_t edge = range.firstEdge + (k - offset);
+          unsigned int a = edges[2 * edge], b = edges[2 * edge + 1];
+          float dx = projected[2 * a] - projected[2 * b];
+          float dy = projected[2 * a + 1] - projected[2 * b + 1];
+          // NAN (конец за наблюдателем) не проходит сравнение
+          if (!(dx * dx + dy * dy < limit)) {
+            out.push_back(a);
+            out.push_back(b);
+          }
+        }
+        offset += range.edgeCount;
+      }
+    }
+  });
+  for (const std::vector<unsigned int> &slice : cullSlices)
+    kept.insert(kept.end(), slice.begin(), slice.end());
+  return total - kept.size() / 2;
+}
+
+/**
+ * @brief Сбор диапазонов ребер видимых частей сетки
+ *
+ * Соседние в списке ребер видимые части объединяются в один диапазон,
+ * чтобы уменьшить число вызовов отрисовки. Вектор диапазонов переиспользуется
+ * между кадрами.
+ *
+ * @param mvp Произведение матриц проекции и модели.
+ * @param ranges Диапазоны ребер видимых частей (перезаписываются).
+ * @return Число видимых частей.
+ */
+int ViewerModel::collectVisibleEdges(const QMatrix4x4 &mvp,
+                                     std::vector<EdgeRange_t> &ranges) {
+  ranges.clear();
+  int visible = 0;
+  for (const MeshChunk_t &chunk : chunks) {
+    if (!isChunkVisible(chunk, mvp)) continue;
+    ++visible;
+    if (!ranges.empty() &&
+        ranges.back().firstEdge + ranges.back().edgeCount == chunk.firstEdge) {
+      ranges.back().edgeCount += chunk.edgeCount;
+    } else {
+      EdgeRange_t range;
+      range.firstEdge = chunk.firstEdge;
+      range.edgeCount = chunk.edgeCount;
+      ranges.push_back(range);
+    }
+  }
+  return visible;
+}
+
+/**
+ * @brief Сохранение параметров модели в файл
+ */
+void ViewerModel::saveModelDefinition() {
+  QFile file("../model.txt");
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    qWarning() << "File not found";
+    return;
+  }
+  QTextStream out(&file);
+  out << modelDefinition.facetColor.name() << " "
+      << modelDefinition.verticeColor.name() << " "
+      << modelDefinition.backgroundColor.name() << " "
+      << modelDefinition.facetWidth << " " << modelDefinition.verticeType << " "
+      << modelDefinition.verticeWidth;
+  file.close();
+}
+
+/**
+ * @brief Чтение параметров модели из файла
+ */
+void ViewerModel::readModelDefinition() {
+  QFile file("../model.txt");
+  if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    qWarning() << "File not found";
+    return;
+  }
+  QTextStream in(&file);
+  QString line = in.readLine().trimmed();
+  file.close();
+  QStringList definition = line.split(" ");
+  if (definition.size() != 6) {
+    qWarning() << "Файл не содержит корректных значений:" << line;
+  }
+  QString facetColorHex = definition[0];
+  QString verticeColorHex = definition[1];
+  QString backgroundColorHex = definition[2];
+  modelDefinition.facetColor = QColor(facetColorHex);
+  modelDefinition.verticeColor = QColor(verticeColorHex);
+  modelDefinition.backgroundColor = QColor(backgroundColorHex);
+
+  float facetWidth = definition[3].toFloat();
+  VerticeType_t verticeType;
+  if (definition[4] == "0")
+    verticeType = Square;
+  else if (definition[4] == "1")
+    verticeType = Circle;
+  else if (definition[4] == "2")
+    verticeType = None;
+  float verticeWidth = definition[5].toFloat();
+
+  modelDefinition.facetWidth = facetWidth;
+  modelDefinition.verticeType = verticeType;
+  modelDefinition.verticeWidth = verticeWidth;
+  markDirty(DirtyStyle);
+}
+
+/**
+ * @brief Преобразование строки в число с плавающей точкой
+ *
+ * @param inputText Входная строка
+ * @return Число с плавающей точкой
  */
 float ViewerModel::makeFloat(const QString &inputText) {
   QRegularExpression regex("[^0-9.]");
@@ -484,4 +1358,1636 @@ float ViewerModel::makeFloat(const QString &inputText) {
   return translateValue;
 }
 
+// Квадрика ошибки: симметричная матрица 4x4, хранится верхний треугольник
+// (aa, ab, ac, ad, bb, bc, bd, cc, cd, dd).
+typedef std::array<double, 10> Quadric;
+
+// Вес плоскостей границы: стягивание, сдвигающее край открытой сетки,
+// обходится во много раз дороже отклонения от поверхности.
+static constexpr double kBoundaryWeight = 1000.0;
+
+/**
+ * @brief Добавление к квадрике плоскости ax + by + cz + d = 0 с весом
+ */
+static void addPlane(Quadric &q, double a, double b, double c, double d,
+                     double weight = 1.0) {
+  q[0] += weight * a * a;
+  q[1] += weight * a * b;
+  q[2] += weight * a * c;
+  q[3] += weight * a * d;
+  q[4] += weight * b * b;
+  q[5] += weight * b * c;
+  q[6] += weight * b * d;
+  q[7] += weight * c * c;
+  q[8] += weight * c * d;
+  q[9] += weight * d * d;
+}
+
+/**
+ * @brief Значение квадрики в точке (сумма квадратов расстояний до плоскостей)
+ */
+static double quadricError(const Quadric &q, const QVector3D &v) {
+  double x = v.x(), y = v.y(), z = v.z();
+  return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x +
+         q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y + q[7] * z * z +
+         2 * q[8] * z + q[9];
+}
+
+/**
+ * @brief Положение вершины после стягивания ребра с минимальной ошибкой
+ *
+ * Решается система 3x3 по правилу Крамера. Решение принимается, только если
+ * определитель не мал по сравнению с масштабом квадрики и точка лежит рядом
+ * с ребром (в его ограничивающем параллелепипеде, расширенном на половину
+ * длины ребра): почти вырожденная квадрика плоского или вытянутого
+ * окружения иначе уводит вершину далеко от сетки. Иначе выбирается лучший
+ * из концов ребра и его середины.
+ */
+static QVector3D optimalPosition(const Quadric &q, const QVector3D &v0,
+                                 const QVector3D &v1, double &error) {
+  QVector3D candidates[4] = {v0, v1, (v0 + v1) / 2.0f, QVector3D()};
+  int count = 3;
+  // матрица системы [[a, b, c], [b, e, f], [c, f, h]]
+  double a = q[0], b = q[1], c = q[2], e = q[4], f = q[5], h = q[7];
+  double det = a * (e * h - f * f) - b * (b * h - f * c) + c * (b * f - e * c);
+  double scale = std::max({std::fabs(a), std::fabs(b), std::fabs(c),
+                           std::fabs(e), std::fabs(f), std::fabs(h)});
+  if (scale > 0.0 && std::fabs(det) > 1e-6 * scale * scale * scale) {
+    double bx = -q[3], by = -q[6], bz = -q[8];
+    double x =
+        (bx * (e * h - f * f) - b * (by * h - f * bz) + c * (by * f - e * bz)) /
+        det;
+    double y =
+        (a * (by * h - f * bz) - bx * (b * h - f * c) + c * (b * bz - by * c)) /
+        det;
+    double z =
+        (a * (e * bz - by * f) - b * (b * bz - by * c) + bx * (b * f - e * c)) /
+        det;
+    QVector3D solution(static_cast<float>(x), static_cast<float>(y),
+                       static_cast<float>(z));
+    float margin = (v1 - v0).length() / 2.0f;
+    bool inside = true;
+    for (int axis = 0; axis < 3; ++axis) {
+      float low = std::min(v0[axis], v1[axis]) - margin;
+      float high = std::max(v0[axis], v1[axis]) + margin;
+      inside = inside && solution[axis] >= low && solution[axis] <= high;
+    }
+    if (inside) candidates[count++] = solution;
+  }
+  QVector3D best = candidates[0];
+  error = quadricError(q, best);
+  for (int i = 1; i < count; ++i) {
+    double candidateError = quadricError(q, candidates[i]);
+    if (candidateError < error) {
+      error = candidateError;
+      best = candidates[i];
+    }
+  }
+  return best;
+}
+
+/**
+ * @brief Кандидат на стягивание ребра в очереди с приоритетом
+ *
+ * Метки версий концов позволяют отбрасывать устаревшие записи без
+ * перестройки очереди.
+ */
+typedef struct Collapse {
+  double cost;
+  unsigned int keep;
+  unsigned int remove;
+  unsigned int keepStamp;
+  unsigned int removeStamp;
+  QVector3D target;
+  bool operator>(const Collapse &other) const { return cost > other.cost; }
+} Collapse_t;
+
+/**
+ * @brief Упрощение треугольной сетки до заданного числа треугольников
+ *
+ * @param vertices Вершины сетки.
+ * @param triangles Индексы вершин, по 3 на треугольник.
+ * @param targetTriangles Целевое число треугольников.
+ * @param cancel Флаг отмены (проверяется перед каждым стягиванием).
+ * @return Упрощенная сетка с ребрами для отрисовки
+ */
+LodLevel_t MeshSimplifier::simplify(const std::vector<QVector3D> &vertices,
+                                    const std::vector<unsigned int> &triangles,
+                                    size_t targetTriangles,
+                                    const std::atomic<bool> *cancel) {
+  std::vector<QVector3D> positions(vertices);
+  std::vector<unsigned int> tris(triangles);
+  size_t triangleCount = tris.size() / 3;
+  std::vector<char> removed(triangleCount, 0);
+  std::vector<char> alive(positions.size(), 1);
+  std::vector<unsigned int> stamps(positions.size(), 0);
+  std::vector<Quadric> quadrics(positions.size(), Quadric{});
+  std::vector<std::vector<unsigned int>> incident(positions.size());
+  auto normalOf = [&](size_t t) {
+    const QVector3D &a = positions[tris[3 * t]];
+    return QVector3D::crossProduct(positions[tris[3 * t + 1]] - a,
+                                   positions[tris[3 * t + 2]] - a);
+  };
+  // квадрики вершин из плоскостей смежных треугольников
+  std::vector<std::array<unsigned int, 3>> sides;  // концы ребра, треугольник
+  sides.reserve(triangleCount * 3);
+  for (size_t t = 0; t < triangleCount; ++t) {
+    QVector3D normal = normalOf(t).normalized();
+    double d = -QVector3D::dotProduct(normal, positions[tris[3 * t]]);
+    for (int corner = 0; corner < 3; ++corner) {
+      unsigned int v = tris[3 * t + corner];
+      unsigned int next = tris[3 * t + (corner + 1) % 3];
+      addPlane(quadrics[v], normal.x(), normal.y(), normal.z(), d);
+      incident[v].push_back(static_cast<unsigned int>(t));
+      sides.push_back(
+          {std::min(v, next), std::max(v, next), static_cast<unsigned int>(t)});
+    }
+  }
+  std::sort(sides.begin(), sides.end());
+  // ребро одного треугольника лежит на границе сетки: его концы получают
+  // плоскость, проходящую через ребро перпендикулярно треугольнику, чтобы
+  // край не стягивался внутрь
+  std::vector<std::pair<unsigned int, unsigned int>> pairs;
+  pairs.reserve(sides.size());
+  for (size_t i = 0; i < sides.size();) {
+    size_t next = i + 1;
+    while (next < sides.size() && sides[next][0] == sides[i][0] &&
+           sides[next][1] == sides[i][1])
+      ++next;
+    unsigned int a = sides[i][0], b = sides[i][1];
+    pairs.emplace_back(a, b);
+    if (next - i == 1) {
+      QVector3D edge = positions[b] - positions[a];
+      QVector3D normal =
+          QVector3D::crossProduct(edge, normalOf(sides[i][2])).normalized();
+      double d = -QVector3D::dotProduct(normal, positions[a]);
+      for (unsigned int v : {a, b})
+        addPlane(quadrics[v], normal.x(), normal.y(), normal.z(), d,
+                 kBoundaryWeight);
+    }
+    i = next;
+  }
+
+  std::priority_queue<Collapse_t, std::vector<Collapse_t>,
+                      std::greater<Collapse_t>>
+      queue;
+  auto pushCollapse = [&](unsigned int keep, unsigned int remove) {
+    if (keep == remove) return;
+    Quadric sum;
+    for (size_t i = 0; i < sum.size(); ++i)
+      sum[i] = quadrics[keep][i] + quadrics[remove][i];
+    Collapse_t collapse;
+    collapse.target =
+        optimalPosition(sum, positions[keep], positions[remove], collapse.cost);
+    collapse.keep = keep;
+    collapse.remove = remove;
+    collapse.keepStamp = stamps[keep];
+    collapse.removeStamp = stamps[remove];
+    queue.push(collapse);
+  };
+  for (const auto &pair : pairs) pushCollapse(pair.first, pair.second);
+
+  // стягивание меняет ориентацию треугольника - такое стягивание пропускается
+  auto flips = [&](unsigned int moved, unsigned int other,
+                   const QVector3D &target) {
+    for (unsigned int t : incident[moved]) {
+      if (removed[t]) continue;
+      const unsigned int *tri = &tris[3 * t];
+      if (tri[0] == other || tri[1] == other || tri[2] == other) continue;
+      QVector3D before = normalOf(t);
+      QVector3D saved = positions[moved];
+      positions[moved] = target;
+      QVector3D after = normalOf(t);
+      positions[moved] = saved;
+      if (QVector3D::dotProduct(before, after) <= 0.0f) return true;
+    }
+    return false;
+  };
+
+  size_t live = triangleCount;
+  while (live > targetTriangles && !queue.empty()) {
+    if (cancel && cancel->load(std::memory_order_relaxed)) break;
+    Collapse_t collapse = queue.top();
+    queue.pop();
+    unsigned int keep = collapse.keep, remove = collapse.remove;
+    if (!alive[keep] || !alive[remove] || stamps[keep] != collapse.keepStamp ||
+        stamps[remove] != collapse.removeStamp)
+      continue;
+    if (flips(keep, remove, collapse.target) ||
+        flips(remove, keep, collapse.target))
+      continue;
+    positions[keep] = collapse.target;
+    for (size_t i = 0; i < quadrics[keep].size(); ++i)
+      quadrics[keep][i] += quadrics[remove][i];
+    alive[remove] = 0;
+    for (unsigned int t : incident[remove]) {
+      if (removed[t]) continue;
+      unsigned int *tri = &tris[3 * t];
+      for (int corner = 0; corner < 3; ++corner)
+        if (tri[corner] == remove) tri[corner] = keep;
+      if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) {
+        removed[t] = 1;
+        --live;
+      } else {
+        incident[keep].push_back(t);
+      }
+    }
+    incident[remove].clear();
+    std::vector<unsigned int> &around = incident[keep];
+    around.erase(std::remove_if(around.begin(), around.end(),
+                                [&](unsigned int t) { return removed[t]; }),
+                 around.end());
+    ++stamps[keep];
+    ++stamps[remove];
+    for (unsigned int t : around)
+      for (int corner = 0; corner < 3; ++corner)
+        pushCollapse(keep, tris[3 * t + corner]);
+  }
+
+  // перенумерация оставшихся вершин
+  LodLevel_t level;
+  const unsigned int kUnmapped = std::numeric_limits<unsigned int>::max();
+  std::vector<unsigned int> remap(positions.size(), kUnmapped);
+  for (size_t t = 0; t < triangleCount; ++t) {
+    if (removed[t]) continue;
+    for (int corner = 0; corner < 3; ++corner) {
+      unsigned int &index = remap[tris[3 * t + corner]];
+      if (index == kUnmapped) {
+        index = static_cast<unsigned int>(level.vertices.size());
+        level.vertices.push_back(positions[tris[3 * t + corner]]);
+      }
+      level.triangles.push_back(index);
+    }
+  }
+  buildLevelEdges(level);
+  return level;
+}
+
+/**
+ * @brief Построение цепочки уровней детализации
+ *
+ * Каждый уровень получается из предыдущего и содержит вдвое меньше
+ * треугольников. Построение прекращается, когда уровень становится меньше
+ * minTriangles, упрощение перестает уменьшать сетку или поступает отмена.
+ *
+ * @param vertices Вершины исходной сетки.
+ * @param triangles Треугольники исходной сетки.
+ * @param minTriangles Минимальное число треугольников уровня.
+ * @param maxLevels Максимальное число уровней.
+ * @param cancel Флаг отмены.
+ * @return Уровни от самого подробного к самому грубому
+ */
+std::vector<LodLevel_t> MeshSimplifier::buildChain(
+    const std::vector<QVector3D> &vertices,
+    const std::vector<unsigned int> &triangles, size_t minTriangles,
+    size_t maxLevels, const std::atomic<bool> *cancel) {
+  std::vector<LodLevel_t> chain;
+  const std::vector<QVector3D> *sourceVertices = &vertices;
+  const std::vector<unsigned int> *sourceTriangles = &triangles;
+  while (chain.size() < maxLevels) {
+    size_t current = sourceTriangles->size() / 3;
+    size_t target = current / 2;
+    if (target < minTriangles) break;
+    LodLevel_t level =
+        simplify(*sourceVertices, *sourceTriangles, target, cancel);
+    if (cancel && cancel->load()) return {};
+    if (level.triangles.size() / 3 >= current) break;
+    chain.push_back(std::move(level));
+    sourceVertices = &chain.back().vertices;
+    sourceTriangles = &chain.back().triangles;
+  }
+  return chain;
+}
+
+/**
+ * @brief Построение списка уникальных ребер уровня для отрисовки
+ *
+ * @param level Уровень детализации, ребра которого заполняются.
+ */
+void MeshSimplifier::buildLevelEdges(LodLevel_t &level) {
+  std::vector<std::pair<unsigned int, unsigned int>> pairs;
+  pairs.reserve(level.triangles.size());
+  for (size_t i = 0; i + 2 < level.triangles.size(); i += 3) {
+    for (int corner = 0; corner < 3; ++corner) {
+      unsigned int a = level.triangles[i + corner];
+      unsigned int b = level.triangles[i + (corner + 1) % 3];
+      pairs.emplace_back(std::min(a, b), std::max(a, b));
+    }
+  }
+  std::sort(pairs.begin(), pairs.end());
+  pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+  level.edges.clear();
+  level.edges.reserve(pairs.size() * 2);
+  for (const auto &pair : pairs) {
+    level.edges.push_back(pair.first);
+    level.edges.push_back(pair.second);
+  }
+}
+
+/**
+ * @brief Проверка поддержки команд AVX2 процессором
+ */
+bool hasAvx2() {
+#if defined(__x86_64__) && defined(__GNUC__)
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+/**
+ * @brief Создание файла и запись заголовка BMP
+ *
+ * @param filePath Путь к файлу.
+ * @param size Размер кадра в пикселях.
+ * @return false, если файл не удалось создать или кадр слишком велик.
+ */
+bool BmpStreamWriter::open(const QString &filePath, const QSize &size) {
+  frameSize = size;
+  rowsWritten = 0;
+  size_t stride = (static_cast<size_t>(size.width()) * 3 + 3) & ~size_t(3);
+  size_t imageBytes = stride * size.height();
+  // поля размеров в заголовке 32-битные
+  if (size.isEmpty() || imageBytes + 54 > 0xffffffffu) return false;
+  file.open(filePath.toStdString(), std::ios::binary | std::ios::trunc);
+  if (!file) {
+    qWarning() << "Failed to open file:" << filePath;
+    return false;
+  }
+  row.assign(stride, 0);
+  auto put16 = [this](uint16_t value) {
+    char bytes[2] = {static_cast<char>(value), static_cast<char>(value >> 8)};
+    file.write(bytes, 2);
+  };
+  auto put32 = [this](uint32_t value) {
+    char bytes[4];
+    for (int i = 0; i < 4; ++i) bytes[i] = static_cast<char>(value >> (8 * i));
+    file.write(bytes, 4);
+  };
+  // BITMAPFILEHEADER
+  file.write("BM", 2);
+  put32(static_cast<uint32_t>(imageBytes + 54));
+  put32(0);
+  put32(54);
+  // BITMAPINFOHEADER, отрицательная высота - строки сверху вниз
+  put32(40);
+  put32(static_cast<uint32_t>(size.width()));
+  put32(static_cast<uint32_t>(-size.height()));
+  put16(1);
+  put16(24);
+  put32(0);
+  put32(static_cast<uint32_t>(imageBytes));
+  put32(2835);  // 72 точки на дюйм
+  put32(2835);
+  put32(0);
+  put32(0);
+  return static_cast<bool>(file);
+}
+
+/**
+ * @brief Дописывание полосы строк кадра
+ *
+ * @param band Полоса шириной в кадр (любой формат QImage).
+ * @return false, если полоса не подходит по размеру или запись не удалась.
+ */
+bool BmpStreamWriter::writeRows(const QImage &band) {
+  if (!file.is_open() || band.width() != frameSize.width() ||
+      rowsWritten + band.height() > frameSize.height())
+    return false;
+  QImage source = band.format() == QImage::Format_RGB32 ||
+                          band.format() == QImage::Format_ARGB32
+                      ? band
+                      : band.convertToFormat(QImage::Format_RGB32);
+  for (int y = 0; y < source.height(); ++y) {
+    const QRgb *pixels =
+        reinterpret_cast<const QRgb *>(source.constScanLine(y));
+    for (int x = 0; x < source.width(); ++x) {
+      row[3 * x] = static_cast<char>(qBlue(pixels[x]));
+      row[3 * x + 1] = static_cast<char>(qGreen(pixels[x]));
+      row[3 * x + 2] = static_cast<char>(qRed(pixels[x]));
+    }
+    file.write(row.data(), static_cast<std::streamsize>(row.size()));
+  }
+  rowsWritten += source.height();
+  return static_cast<bool>(file);
+}
+
+/**
+ * @brief Завершение записи
+ *
+ * @return true, если записаны все строки кадра.
+ */
+bool BmpStreamWriter::close() {
+  if (!file.is_open()) return false;
+  file.close();
+  return !file.fail() && rowsWritten == frameSize.height();
+}
+
+/**
+ * @brief Ключи ячеек цвета 5:5:5 для строки пикселей
+ */
+static void cellKeysScalar(const QRgb *pixels, int count,
+                           unsigned short *keys) {
+  for (int i = 0; i < count; ++i)
+    keys[i] = static_cast<unsigned short>(((pixels[i] >> 9) & 0x7c00) |
+                                          ((pixels[i] >> 6) & 0x03e0) |
+                                          ((pixels[i] >> 3) & 0x001f));
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+/**
+ * @brief Ключи ячеек цвета для 8 пикселей за шаг командами AVX2
+ */
+__attribute__((target("avx2"))) static void cellKeysAvx2(
+    const QRgb *pixels, int count, unsigned short *keys) {
+  const __m256i redMask = _mm256_set1_epi32(0x7c00);
+  const __m256i greenMask = _mm256_set1_epi32(0x03e0);
+  const __m256i blueMask = _mm256_set1_epi32(0x001f);
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i pixel =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pixels + i));
+    __m256i key = _mm256_or_si256(
+        _mm256_or_si256(
+            _mm256_and_si256(_mm256_srli_epi32(pixel, 9), redMask),
+            _mm256_and_si256(_mm256_srli_epi32(pixel, 6), greenMask)),
+        _mm256_and_si256(_mm256_srli_epi32(pixel, 3), blueMask));
+    __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(key),
+                                      _mm256_extracti128_si256(key, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(keys + i), packed);
+  }
+  cellKeysScalar(pixels + i, count - i, keys + i);
+}
+#endif
+
+/**
+ * @brief Ключи ячеек цвета с выбором набора команд процессора
+ */
+static void cellKeys(const QRgb *pixels, int count, unsigned short *keys) {
+#if defined(__x86_64__) && defined(__GNUC__)
+  if (hasAvx2()) {
+    cellKeysAvx2(pixels, count, keys);
+    return;
+  }
+#endif
+  cellKeysScalar(pixels, count, keys);
+}
+
+/**
+ * @brief Кадр в формате RGB32 нужного размера
+ */
+static QImage scaledFrame(const QImage &frame, const QSize &size) {
+  QImage scaled = frame.size() == size
+                      ? frame
+                      : frame.scaled(size, Qt::IgnoreAspectRatio,
+                                     Qt::SmoothTransformation);
+  return scaled.convertToFormat(QImage::Format_RGB32);
+}
+
+typedef struct ColorBox {
+  size_t begin;  // диапазон ячеек в списке используемых ячеек
+  size_t end;
+  int channel;   // канал с наибольшим разбросом (0 - R, 1 - G, 2 - B)
+  int range;     // разброс по этому каналу
+} ColorBox_t;
+
+/**
+ * @brief Канал ячейки цвета 5:5:5
+ */
+static int cellChannel(int cell, int channel) {
+  return (cell >> (10 - 5 * channel)) & 31;
+}
+
+/**
+ * @brief Разброс ячеек параллелепипеда по каналам
+ */
+static void measureBox(const std::vector<int> &cells, ColorBox_t &box) {
+  int low[3] = {31, 31, 31}, high[3] = {0, 0, 0};
+  for (size_t i = box.begin; i < box.end; ++i)
+    for (int channel = 0; channel < 3; ++channel) {
+      int value = cellChannel(cells[i], channel);
+      low[channel] = std::min(low[channel], value);
+      high[channel] = std::max(high[channel], value);
+    }
+  box.channel = 0;
+  box.range = -1;
+  for (int channel = 0; channel < 3; ++channel)
+    if (high[channel] - low[channel] > box.range) {
+      box.range = high[channel] - low[channel];
+      box.channel = channel;
+    }
+}
+
+/**
+ * @brief Построение общей палитры анимации медианным сечением
+ *
+ * Гистограмма ячеек 5:5:5 собирается параллельно по полосам строк (ключи
+ * ячеек считаются командами AVX2), затем параллелепипед с наибольшим
+ * разбросом делится по медиане числа пикселей, пока не получится 256
+ * цветов. Цвет палитры - среднее пикселей параллелепипеда, оставшиеся
+ * цвета заполняются равномерной решеткой. Ячейки, не встретившиеся в
+ * кадре, отображаются на ближайший цвет палитры.
+ *
+ * @param frame Кадр в формате QImage::Format_RGB32.
+ * @param palette Палитра (до 256 цветов).
+ * @param lookup Индекс палитры для каждой из 32768 ячеек.
+ */
+void GifEncoder::buildPalette(const QImage &frame, std::vector<QRgb> &palette,
+                              std::vector<uchar> &lookup) {
+  const int cells = 1 << 15;
+  std::vector<unsigned int> count(cells, 0);
+  std::vector<unsigned long long> sums(cells * 3, 0);
+  std::mutex merge;
+  parallelFor(static_cast<size_t>(frame.height()), 16, [&](size_t begin,
+                                                          size_t end) {
+    std::vector<unsigned int> localCount(cells, 0);
+    std::vector<unsigned long long> localSums(cells * 3, 0);
+    std::vector<unsigned short> keys(frame.width());
+    for (size_t y = begin; y < end; ++y) {
+      const QRgb *line = reinterpret_cast<const QRgb *>(
+          frame.constScanLine(static_cast<int>(y)));
+      cellKeys(line, frame.width(), keys.data());
+      for (int x = 0; x < frame.width(); ++x) {
+        unsigned short key = keys[x];
+        ++localCount[key];
+        localSums[3 * key] += qRed(line[x]);
+        localSums[3 * key + 1] += qGreen(line[x]);
+        localSums[3 * key + 2] += qBlue(line[x]);
+      }
+    }
+    std::lock_guard<std::mutex> lock(merge);
+    for (int cell = 0; cell < cells; ++cell) {
+      if (localCount[cell] == 0) continue;
+      count[cell] += localCount[cell];
+      for (int channel = 0; channel < 3; ++channel)
+        sums[3 * cell + channel] += localSums[3 * cell + channel];
+    }
+  });
+
+  std::vector<int> used;
+  for (int cell = 0; cell < cells; ++cell)
+    if (count[cell] > 0) used.push_back(cell);
+  std::vector<ColorBox_t> boxes;
+  if (!used.empty()) {
+    boxes.push_back({0, used.size(), 0, 0});
+    measureBox(used, boxes[0]);
+  }
+  while (boxes.size() < 256) {
+    auto widest = std::max_element(
+        boxes.begin(), boxes.end(),
+        [](const ColorBox_t &a, const ColorBox_t &b) {
+          return a.range < b.range;
+        });
+    if (widest == boxes.end() || widest->range <= 0) break;
+    ColorBox_t box = *widest;
+    auto first = used.begin() + box.begin, last = used.begin() + box.end;
+    std::sort(first, last, [&box](int a, int b) {
+      return cellChannel(a, box.channel) < cellChannel(b, box.channel);
+    });
+    unsigned long long total = 0, half = 0;
+    for (auto it = first; it != last; ++it) total += count[*it];
+    size_t split = box.begin + 1;
+    for (size_t i = box.begin; i + 1 < box.end; ++i) {
+      half += count[used[i]];
+      split = i + 1;
+      if (2 * half >= total) break;
+    }
+    ColorBox_t lower = {box.begin, split, 0, 0};
+    ColorBox_t upper = {split, box.end, 0, 0};
+    measureBox(used, lower);
+    measureBox(used, upper);
+    *widest = lower;
+    boxes.push_back(upper);
+  }
+
+  palette.clear();
+  lookup.assign(cells, 0);
+  std::vector<bool> assigned(cells, false);
+  for (const ColorBox_t &box : boxes) {
+    unsigned long long n = 0, r = 0, g = 0, b = 0;
+    for (size_t i = box.begin; i < box.end; ++i) {
+      int cell = used[i];
+      n += count[cell];
+      r += sums[3 * cell];
+      g += sums[3 * cell + 1];
+      b += sums[3 * cell + 2];
+      lookup[cell] = static_cast<uchar>(palette.size());
+      assigned[cell] = true;
+    }
+    palette.push_back(qRgb(static_cast<int>(r / n), static_cast<int>(g / n),
+                           static_cast<int>(b / n)));
+  }
+  // свободные цвета занимает равномерная решетка 6x6x6, чтобы цвета,
+  // появившиеся в следующих кадрах, не искажались сильно
+  int spare = std::min(256 - static_cast<int>(palette.size()), 216);
+  for (int i = 0; i < spare; ++i) {
+    int node = i * 216 / spare;
+    palette.push_back(qRgb(node / 36 * 51, node / 6 % 6 * 51, node % 6 * 51));
+  }
+  parallelFor(cells, 1024, [&](size_t begin, size_t end) {
+    for (size_t cell = begin; cell < end; ++cell) {
+      if (assigned[cell]) continue;
+      int r = (cellChannel(static_cast<int>(cell), 0) << 3) | 4;
+      int g = (cellChannel(static_cast<int>(cell), 1) << 3) | 4;
+      int b = (cellChannel(static_cast<int>(cell), 2) << 3) | 4;
+      int best = 0, bestDistance = std::numeric_limits<int>::max();
+      for (size_t p = 0; p < palette.size(); ++p) {
+        int dr = qRed(palette[p]) - r, dg = qGreen(palette[p]) - g;
+        int db = qBlue(palette[p]) - b;
+        int distance = dr * dr + dg * dg + db * db;
+        if (distance < bestDistance) {
+          bestDistance = distance;
+          best = static_cast<int>(p);
+        }
+      }
+      lookup[cell] = static_cast<uchar>(best);
+    }
+  });
+}
+
+/**
+ * @brief Перевод пикселей кадра в индексы общей палитры
+ *
+ * @param frame Кадр в формате QImage::Format_RGB32.
+ * @param lookup Таблица ячеек, построенная buildPalette.
+ * @param indices Индекс палитры для каждого пикселя.
+ */
+void GifEncoder::mapToPalette(const QImage &frame,
+                              const std::vector<uchar> &lookup,
+                              std::vector<uchar> &indices) {
+  indices.resize(static_cast<size_t>(frame.width()) * frame.height());
+  std::vector<unsigned short> keys(frame.width());
+  for (int y = 0; y < frame.height(); ++y) {
+    cellKeys(reinterpret_cast<const QRgb *>(frame.constScanLine(y)),
+             frame.width(), keys.data());
+    uchar *out = &indices[static_cast<size_t>(y) * frame.width()];
+    for (int x = 0; x < frame.width(); ++x) out[x] = lookup[keys[x]];
+  }
+}
+
+/**
+ * @brief Ограничивающий прямоугольник пикселей, изменившихся с прошлого
+ * кадра
+ *
+ * @param previous Индексы прошлого кадра.
+ * @param current Индексы текущего кадра.
+ * @param size Размер кадров.
+ * @return Прямоугольник изменений (пустой, если кадры совпадают).
+ */
+QRect GifEncoder::changedRect(const std::vector<uchar> &previous,
+                              const std::vector<uchar> &current,
+                              const QSize &size) {
+  int width = size.width();
+  int top = -1, bottom = -1, left = width, right = -1;
+  for (int y = 0; y < size.height(); ++y) {
+    const uchar *a = &previous[static_cast<size_t>(y) * width];
+    const uchar *b = &current[static_cast<size_t>(y) * width];
+    if (std::memcmp(a, b, width) == 0) continue;
+    if (top < 0) top = y;
+    bottom = y;
+    int first = 0, last = width - 1;
+    while (a[first] == b[first]) ++first;
+    while (a[last] == b[last]) --last;
+    left = std::min(left, first);
+    right = std::max(right, last);
+  }
+  if (top < 0) return QRect();
+  return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+/**
+ * @brief Сжатие индексов пикселей LZW с кодами переменной длины
+ *
+ * Словарь хранится в хеш-таблице на 8192 ячейки (ключ - префикс и
+ * следующий индекс); при заполнении 4096 кодов словарь сбрасывается
+ * кодом очистки. Результат разбит на блоки GIF по 255 байт.
+ *
+ * @param indices Индексы пикселей.
+ * @param minCodeSize Минимальная длина кода (бит на индекс).
+ * @param out Байты данных изображения (дописываются).
+ */
+void GifEncoder::lzwEncode(const std::vector<uchar> &indices, int minCodeSize,
+                           std::vector<uchar> &out) {
+  const int clearCode = 1 << minCodeSize;
+  const unsigned int kTableSize = 8192;
+  // ключ + 1, 0 - пустая ячейка
+  std::vector<unsigned int> keys(kTableSize, 0);
+  std::vector<unsigned short> codes(kTableSize, 0);
+  int codeSize = minCodeSize + 1;
+  int maxCode = clearCode + 1;
+  unsigned int bitBuffer = 0;
+  int bitCount = 0;
+  uchar block[255];
+  int blockSize = 0;
+
+  out.push_back(static_cast<uchar>(minCodeSize));
+  auto putByte = [&](uchar value) {
+    block[blockSize++] = value;
+    if (blockSize == 255) {
+      out.push_back(255);
+      out.insert(out.end(), block, block + 255);
+      blockSize = 0;
+    }
+  };
+  auto putCode = [&](int code, int size) {
+    bitBuffer |= static_cast<unsigned int>(code) << bitCount;
+    bitCount += size;
+    while (bitCount >= 8) {
+      putByte(static_cast<uchar>(bitBuffer & 0xff));
+      bitBuffer >>= 8;
+      bitCount -= 8;
+    }
+  };
+  auto slotOf = [](unsigned int key) {
+    return (key * 2654435761u) >> 19;  // 13 старших бит
+  };
+
+  putCode(clearCode, codeSize);
+  int current = -1;
+  for (uchar value : indices) {
+    if (current < 0) {
+      current = value;
+      continue;
+    }
+    unsigned int key = (static_cast<unsigned int>(current) << 8) | value;
+    unsigned int slot = slotOf(key);
+    while (keys[slot] != 0 && keys[slot] != key + 1)
+      slot = (slot + 1) % kTableSize;
+    if (keys[slot] != 0) {
+      current = codes[slot];
+      continue;
+    }
+    putCode(current, codeSize);
+    keys[slot] = key + 1;
+    codes[slot] = static_cast<unsigned short>(++maxCode);
+    if (maxCode >= (1 << codeSize)) ++codeSize;
+    if (maxCode == 4095) {
+      putCode(clearCode, codeSize);
+      std::fill(keys.begin(), keys.end(), 0);
+      codeSize = minCodeSize + 1;
+      maxCode = clearCode + 1;
+    }
+    current = value;
+  }
+  if (current >= 0) putCode(current, codeSize);
+  putCode(clearCode, codeSize);
+  putCode(clearCode + 1, minCodeSize + 1);
+  if (bitCount > 0) putByte(static_cast<uchar>(bitBuffer & 0xff));
+  if (blockSize > 0) {
+    out.push_back(static_cast<uchar>(blockSize));
+    out.insert(out.end(), block, block + blockSize);
+  }
+  out.push_back(0);
+}
+
+/**
+ * @brief Дописывание 16-битного числа (младший байт первым)
+ */
+static void putWord(std::vector<uchar> &out, int value) {
+  out.push_back(static_cast<uchar>(value & 0xff));
+  out.push_back(static_cast<uchar>((value >> 8) & 0xff));
+}
+
+/**
+ * @brief Заголовок файла GIF с общей палитрой и повтором анимации
+ *
+ * @param size Размер кадра.
+ * @param loops Число повторов (0 - бесконечно).
+ * @param palette Общая палитра (дополняется черным до 256 цветов).
+ * @return Байты заголовка.
+ */
+std::vector<uchar> GifEncoder::header(const QSize &size, int loops,
+                                      const std::vector<QRgb> &palette) {
+  std::vector<uchar> out = {'G', 'I', 'F', '8', '9', 'a'};
+  putWord(out, size.width());
+  putWord(out, size.height());
+  out.insert(out.end(), {0xf7, 0, 0});  // общая палитра из 256 цветов
+  for (int i = 0; i < 256; ++i) {
+    QRgb color = i < static_cast<int>(palette.size()) ? palette[i] : 0;
+    out.insert(out.end(), {static_cast<uchar>(qRed(color)),
+                           static_cast<uchar>(qGreen(color)),
+                           static_cast<uchar>(qBlue(color))});
+  }
+  const char *netscape = "NETSCAPE2.0";
+  out.insert(out.end(), {0x21, 0xff, 11});
+  out.insert(out.end(), netscape, netscape + 11);
+  out.insert(out.end(), {3, 1});
+  putWord(out, loops);
+  out.push_back(0);
+  return out;
+}
+
+/**
+ * @brief Кодирование прямоугольника кадра поверх предыдущего кадра
+ *
+ * Пиксели вне прямоугольника остаются от предыдущего кадра (способ
+ * удаления 1), поэтому в файл попадают только изменения.
+ *
+ * @param indices Индексы всего кадра в общей палитре.
+ * @param size Размер кадра.
+ * @param rect Записываемая часть кадра.
+ * @param delay Длительность кадра в сотых долях секунды.
+ * @return Блоки кадра: управление показом, описание, данные.
+ */
+std::vector<uchar> GifEncoder::encodeFrame(const std::vector<uchar> &indices,
+                                           const QSize &size,
+                                           const QRect &rect, int delay) {
+  std::vector<uchar> out = {0x21, 0xf9, 4, 0x04};
+  putWord(out, delay);
+  out.insert(out.end(), {0, 0});
+  out.push_back(0x2c);
+  putWord(out, rect.x());
+  putWord(out, rect.y());
+  putWord(out, rect.width());
+  putWord(out, rect.height());
+  out.push_back(0);  // без своей палитры
+  std::vector<uchar> part;
+  part.reserve(static_cast<size_t>(rect.width()) * rect.height());
+  for (int y = rect.top(); y <= rect.bottom(); ++y) {
+    const uchar *row =
+        &indices[static_cast<size_t>(y) * size.width() + rect.x()];
+    part.insert(part.end(), row, row + rect.width());
+  }
+  lzwEncode(part, 8, out);
+  return out;
+}
+
+/**
+ * @brief Деструктор: остановка потоков, если запись не была завершена
+ */
+GifStreamWriter::~GifStreamWriter() {
+  if (!workers_.empty()) finish();
+}
+
+/**
+ * @brief Создание файла и запуск потоков кодирования по числу ядер
+ *
+ * Заголовок с общей палитрой записывается вместе с первым кадром.
+ *
+ * @param filePath Путь к файлу GIF.
+ * @param size Размер кадра в файле.
+ * @param fps Частота кадров.
+ * @return false, если файл не удалось создать.
+ */
+bool GifStreamWriter::open(const QString &filePath, const QSize &size,
+                           int fps) {
+  return open(filePath, size, fps, 0);
+}
+
+/**
+ * @brief Создание файла и запуск заданного числа потоков кодирования
+ *
+ * @param filePath Путь к файлу GIF.
+ * @param size Размер кадра в файле.
+ * @param fps Частота кадров.
+ * @param workers Число потоков (0 - по числу ядер).
+ * @return false, если файл не удалось создать.
+ */
+bool GifStreamWriter::open(const QString &filePath, const QSize &size,
+                           int fps, int workers) {
+  if (size.isEmpty() || fps <= 0 || !workers_.empty()) return false;
+  file.open(filePath.toStdString(), std::ios::binary | std::ios::trunc);
+  if (!file) {
+    qWarning() << "Failed to open file:" << filePath;
+    return false;
+  }
+  frameSize = size;
+  delay = std::max(1, static_cast<int>(std::lround(100.0 / fps)));
+  palette.clear();
+  lookup.clear();
+  nextFrame = nextToWrite = 0;
+  bytesWritten_ = 0;
+  encodeNs = 0;
+  closing = false;
+  int count = workers > 0
+                  ? workers
+                  : static_cast<int>(
+                        std::max(1u, std::thread::hardware_concurrency()));
+  for (int i = 0; i < count; ++i)
+    workers_.emplace_back(&GifStreamWriter::workerLoop, this);
+  return true;
+}
+
+/**
+ * @brief Запись заголовка с палитрой, построенной по кадру
+ *
+ * @param frame Кадр нужного размера в формате QImage::Format_RGB32.
+ */
+void GifStreamWriter::writeHeader(const QImage &frame) {
+  QElapsedTimer clock;
+  clock.start();
+  GifEncoder::buildPalette(frame, palette, lookup);
+  std::vector<uchar> start = GifEncoder::header(frameSize, 0, palette);
+  file.write(reinterpret_cast<const char *>(start.data()),
+             static_cast<std::streamsize>(start.size()));
+  bytesWritten_ += static_cast<long long>(start.size());
+  encodeNs += clock.nsecsElapsed();
+}
+
+/**
+ * @brief Передача кадра на кодирование
+ *
+ * Кадр разделяет данные с переданным QImage. По первому кадру строится
+ * общая палитра. Если в очереди уже kMaxQueuedFrames кадров, вызов ждет,
+ * пока один из них не будет взят.
+ *
+ * @param frame Кадр любого размера и формата.
+ */
+void GifStreamWriter::push(const QImage &frame) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (workers_.empty()) return;
+  if (nextFrame == 0) {
+    // рабочие потоки ждут первого кадра, поэтому палитра строится без гонок
+    QImage first = scaledFrame(frame, frameSize);
+    writeHeader(first);
+    queue.emplace_back(nextFrame++, first);
+    queueChanged.notify_all();
+    return;
+  }
+  queueChanged.wait(lock, [this] { return queue.size() < kMaxQueuedFrames; });
+  queue.emplace_back(nextFrame++, frame);
+  queueChanged.notify_all();
+}
+
+/**
+ * @brief Цикл рабочего потока: кодирование кадров и запись по порядку
+ *
+ * Кадр сравнивается с предыдущим после перевода в индексы палитры;
+ * предыдущий кадр взят из очереди раньше, поэтому его индексы будут
+ * готовы без взаимного ожидания потоков.
+ */
+void GifStreamWriter::workerLoop() {
+  for (;;) {
+    std::unique_lock<std::mutex> lock(mutex);
+    queueChanged.wait(lock, [this] { return closing || !queue.empty(); });
+    if (queue.empty()) return;
+    std::pair<int, QImage> job = std::move(queue.front());
+    queue.pop_front();
+    queueChanged.notify_all();
+    lock.unlock();
+
+    QElapsedTimer clock;
+    clock.start();
+    auto indices = std::make_shared<std::vector<uchar>>();
+    GifEncoder::mapToPalette(scaledFrame(job.second, frameSize), lookup,
+                             *indices);
+    qint64 elapsed = clock.nsecsElapsed();
+    lock.lock();
+    quantized[job.first] = indices;
+    queueChanged.notify_all();
+    queueChanged.wait(lock, [this, &job] {
+      return job.first == 0 || quantized.count(job.first - 1) > 0;
+    });
+    std::shared_ptr<const std::vector<uchar>> previous =
+        job.first > 0 ? quantized[job.first - 1] : nullptr;
+    lock.unlock();
+
+    clock.start();
+    QRect rect = QRect(QPoint(0, 0), frameSize);
+    if (previous) {
+      rect = GifEncoder::changedRect(*previous, *indices, frameSize);
+      // у кадра без изменений остается один пиксель, чтобы сохранить паузу
+      if (rect.isEmpty()) rect = QRect(0, 0, 1, 1);
+    }
+    std::vector<uchar> bytes =
+        GifEncoder::encodeFrame(*indices, frameSize, rect, delay);
+    elapsed += clock.nsecsElapsed();
+
+    lock.lock();
+    if (previous) quantized.erase(job.first - 1);
+    encodeNs += elapsed;
+    encoded.emplace(job.first, std::move(bytes));
+    // кадры, закодированные раньше предыдущих, ждут своей очереди
+    for (auto next = encoded.find(nextToWrite); next != encoded.end();
+         next = encoded.find(nextToWrite)) {
+      file.write(reinterpret_cast<const char *>(next->second.data()),
+                 static_cast<std::streamsize>(next->second.size()));
+      bytesWritten_ += static_cast<long long>(next->second.size());
+      encoded.erase(next);
+      ++nextToWrite;
+    }
+  }
+}
+
+/**
+ * @brief Ожидание кодирования всех кадров и закрытие файла
+ *
+ * @return true, если все кадры записаны.
+ */
+bool GifStreamWriter::finish() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    closing = true;
+  }
+  queueChanged.notify_all();
+  for (std::thread &worker : workers_) worker.join();
+  workers_.clear();
+  quantized.clear();
+  if (!file.is_open()) return false;
+  if (nextFrame == 0) writeHeader(QImage());
+  file.put(0x3b);
+  ++bytesWritten_;
+  file.close();
+  return !file.fail() && nextToWrite == nextFrame;
+}
+
+/**
+ * @brief Число кадров, уже записанных в файл
+ */
+int GifStreamWriter::framesWritten() const { return nextToWrite; }
+
+/**
+ * @brief Размер записанного файла в байтах
+ */
+long long GifStreamWriter::bytesWritten() const { return bytesWritten_; }
+
+/**
+ * @brief Суммарное время построения палитры и кодирования кадров во всех
+ * потоках, мс
+ */
+double GifStreamWriter::encodeMilliseconds() const { return encodeNs / 1.0e6; }
+
+/**
+ * @brief Конструктор кольцевого буфера
+ *
+ * @param capacity Число ячеек (не меньше одной).
+ */
+FrameRing::FrameRing(size_t capacity) : frames(std::max<size_t>(capacity, 1)) {}
+
+/**
+ * @brief Добавление кадра без ожидания
+ *
+ * @param frame Кадр (данные разделяются с переданным QImage).
+ * @return false, если буфер заполнен или закрыт и кадр отброшен.
+ */
+bool FrameRing::tryPush(const QImage &frame) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (closed || count == frames.size()) {
+      ++dropped_;
+      return false;
+    }
+    frames[(head + count) % frames.size()] = frame;
+    ++count;
+    ++pushed_;
+  }
+  available.notify_one();
+  return true;
+}
+
+/**
+ * @brief Извлечение самого старого кадра
+ *
+ * Ждет, пока в буфере не появится кадр или буфер не будет закрыт.
+ *
+ * @param frame Извлеченный кадр.
+ * @return false, если буфер закрыт и пуст.
+ */
+bool FrameRing::pop(QImage &frame) {
+  std::unique_lock<std::mutex> lock(mutex);
+  available.wait(lock, [this] { return closed || count > 0; });
+  if (count == 0) return false;
+  frame = std::move(frames[head]);
+  frames[head] = QImage();
+  head = (head + 1) % frames.size();
+  --count;
+  return true;
+}
+
+/**
+ * @brief Закрытие буфера: новые кадры не принимаются, ожидание pop
+ * прерывается после выдачи оставшихся кадров
+ */
+void FrameRing::close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+  }
+  available.notify_all();
+}
+
+/**
+ * @brief Число принятых кадров
+ */
+long long FrameRing::pushed() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return pushed_;
+}
+
+/**
+ * @brief Число кадров, отброшенных из-за переполнения
+ */
+long long FrameRing::dropped() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return dropped_;
+}
+
+/**
+ * @brief Яркость BT.601 в диапазоне 16..235
+ */
+static inline uchar lumaOf(QRgb pixel) {
+  return static_cast<uchar>(
+      ((66 * qRed(pixel) + 129 * qGreen(pixel) + 25 * qBlue(pixel) + 128) >>
+       8) +
+      16);
+}
+
+/**
+ * @brief Перевод двух строк в YUV 4:2:0, начиная со столбца first
+ *
+ * Цветность считается по среднему квадрата 2x2; у нечетной ширины или
+ * высоты крайний пиксель повторяется.
+ */
+static void yuvRowsScalar(const QRgb *row0, const QRgb *row1, int first,
+                          int width, uchar *luma0, uchar *luma1, uchar *u,
+                          uchar *v) {
+  for (int x = first; x < width; x += 2) {
+    int right = std::min(x + 1, width - 1);
+    luma0[x] = lumaOf(row0[x]);
+    luma1[x] = lumaOf(row1[x]);
+    if (x + 1 < width) {
+      luma0[x + 1] = lumaOf(row0[x + 1]);
+      luma1[x + 1] = lumaOf(row1[x + 1]);
+    }
+    QRgb quad[4] = {row0[x], row0[right], row1[x], row1[right]};
+    int r = 2, g = 2, b = 2;
+    for (QRgb pixel : quad) {
+      r += qRed(pixel);
+      g += qGreen(pixel);
+      b += qBlue(pixel);
+    }
+    r >>= 2;
+    g >>= 2;
+    b >>= 2;
+    u[x / 2] =
+        static_cast<uchar>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+    v[x / 2] =
+        static_cast<uchar>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+  }
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+/**
+ * @brief Взвешенная сумма каналов со сдвигом для 8 пикселей
+ */
+__attribute__((target("avx2"))) static inline __m256i weightedAvx2(
+    __m256i r, __m256i g, __m256i b, int wr, int wg, int wb, int offset) {
+  __m256i sum = _mm256_add_epi32(
+      _mm256_add_epi32(_mm256_mullo_epi32(r, _mm256_set1_epi32(wr)),
+                       _mm256_mullo_epi32(g, _mm256_set1_epi32(wg))),
+      _mm256_add_epi32(_mm256_mullo_epi32(b, _mm256_set1_epi32(wb)),
+                       _mm256_set1_epi32(128)));
+  return _mm256_add_epi32(_mm256_srai_epi32(sum, 8),
+                          _mm256_set1_epi32(offset));
+}
+
+/**
+ * @brief Сумма каналов соседних пар пикселей двух строк (4 пары)
+ */
+__attribute__((target("avx2"))) static inline __m256i pairSumsAvx2(
+    __m256i top, __m256i bottom) {
+  __m256i sum = _mm256_add_epi32(top, bottom);
+  __m256i pairs = _mm256_hadd_epi32(sum, sum);
+  return _mm256_permutevar8x32_epi32(pairs,
+                                     _mm256_setr_epi32(0, 1, 4, 5, 0, 1, 4, 5));
+}
+
+/**
+ * @brief Запись младших байтов первых count 32-битных значений
+ */
+__attribute__((target("avx2"))) static inline void storeBytesAvx2(
+    __m256i values, uchar *out, int count) {
+  __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(values),
+                                   _mm256_extracti128_si256(values, 1));
+  __m128i bytes = _mm_packus_epi16(words, words);
+  if (count == 8) {
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out), bytes);
+  } else {
+    int packed = _mm_cvtsi128_si32(bytes);
+    std::memcpy(out, &packed, 4);
+  }
+}
+
+/**
+ * @brief Перевод двух строк в YUV 4:2:0 по 8 пикселей командами AVX2
+ *
+ * Результат совпадает с yuvRowsScalar: целочисленные операции те же.
+ *
+ * @return Число обработанных столбцов (кратно 8).
+ */
+__attribute__((target("avx2"))) static int yuvRowsAvx2(
+    const QRgb *row0, const QRgb *row1, int width, uchar *luma0,
+    uchar *luma1, uchar *u, uchar *v) {
+  const __m256i mask = _mm256_set1_epi32(0xff);
+  const __m256i two = _mm256_set1_epi32(2);
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m256i p0 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row0 + x));
+    __m256i p1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row1 + x));
+    __m256i r0 = _mm256_and_si256(_mm256_srli_epi32(p0, 16), mask);
+    __m256i g0 = _mm256_and_si256(_mm256_srli_epi32(p0, 8), mask);
+    __m256i b0 = _mm256_and_si256(p0, mask);
+    __m256i r1 = _mm256_and_si256(_mm256_srli_epi32(p1, 16), mask);
+    __m256i g1 = _mm256_and_si256(_mm256_srli_epi32(p1, 8), mask);
+    __m256i b1 = _mm256_and_si256(p1, mask);
+    storeBytesAvx2(weightedAvx2(r0, g0, b0, 66, 129, 25, 16), luma0 + x, 8);
+    storeBytesAvx2(weightedAvx2(r1, g1, b1, 66, 129, 25, 16), luma1 + x, 8);
+    __m256i r = _mm256_srai_epi32(
+        _mm256_add_epi32(pairSumsAvx2(r0, r1), two), 2);
+    __m256i g = _mm256_srai_epi32(
+        _mm256_add_epi32(pairSumsAvx2(g0, g1), two), 2);
+    __m256i b = _mm256_srai_epi32(
+        _mm256_add_epi32(pairSumsAvx2(b0, b1), two), 2);
+    storeBytesAvx2(weightedAvx2(r, g, b, -38, -74, 112, 128), u + x / 2, 4);
+    storeBytesAvx2(weightedAvx2(r, g, b, 112, -94, -18, 128), v + x / 2, 4);
+  }
+  return x;
+}
+#endif
+
+/**
+ * @brief Перевод кадра в плоскости Y, U, V формата 4:2:0 (BT.601)
+ *
+ * Пары строк обрабатываются параллельно, внутри строки - по 8 пикселей
+ * командами AVX2, если процессор их поддерживает.
+ *
+ * @param frame Кадр в формате QImage::Format_RGB32.
+ * @param planes Плоскости Y, U и V подряд.
+ * @param vectorized false - всегда используется скалярный расчет.
+ */
+void Y4mStreamWriter::convertToYuv420(const QImage &frame,
+                                      std::vector<uchar> &planes,
+                                      bool vectorized) {
+  int width = frame.width(), height = frame.height();
+  size_t chromaWidth = static_cast<size_t>(width + 1) / 2;
+  size_t chromaHeight = static_cast<size_t>(height + 1) / 2;
+  size_t lumaSize = static_cast<size_t>(width) * height;
+  planes.resize(lumaSize + 2 * chromaWidth * chromaHeight);
+  uchar *luma = planes.data();
+  uchar *uPlane = luma + lumaSize;
+  uchar *vPlane = uPlane + chromaWidth * chromaHeight;
+  bool useAvx2 = vectorized && hasAvx2();
+  parallelFor(chromaHeight, 64, [&](size_t begin, size_t end) {
+    for (size_t pair = begin; pair < end; ++pair) {
+      int y = static_cast<int>(2 * pair);
+      int next = std::min(y + 1, height - 1);
+      const QRgb *row0 = reinterpret_cast<const QRgb *>(frame.constScanLine(y));
+      const QRgb *row1 =
+          reinterpret_cast<const QRgb *>(frame.constScanLine(next));
+      uchar *luma0 = luma + static_cast<size_t>(y) * width;
+      uchar *luma1 = luma + static_cast<size_t>(next) * width;
+      uchar *u = uPlane + pair * chromaWidth;
+      uchar *v = vPlane + pair * chromaWidth;
+      int first = 0;
+#if defined(__x86_64__) && defined(__GNUC__)
+      if (useAvx2) first = yuvRowsAvx2(row0, row1, width, luma0, luma1, u, v);
+#else
+      (void)useAvx2;
+#endif
+      yuvRowsScalar(row0, row1, first, width, luma0, luma1, u, v);
+    }
+  });
+}
+
+/**
+ * @brief Создание файла Y4M и запись заголовка потока
+ *
+ * @param filePath Путь к файлу.
+ * @param size Размер кадра в файле.
+ * @param fps Частота кадров.
+ * @return false, если файл не удалось создать.
+ */
+bool Y4mStreamWriter::open(const QString &filePath, const QSize &size,
+                           int fps) {
+  if (size.isEmpty() || fps <= 0) return false;
+  file.open(filePath.toStdString(), std::ios::binary | std::ios::trunc);
+  if (!file) {
+    qWarning() << "Failed to open file:" << filePath;
+    return false;
+  }
+  frameSize = size;
+  encodeNs = 0;
+  std::string header = "YUV4MPEG2 W" + std::to_string(size.width()) + " H" +
+                       std::to_string(size.height()) + " F" +
+                       std::to_string(fps) + ":1 Ip A1:1 C420jpeg\n";
+  file.write(header.data(), static_cast<std::streamsize>(header.size()));
+  bytesWritten_ = static_cast<long long>(header.size());
+  return static_cast<bool>(file);
+}
+
+/**
+ * @brief Перевод кадра в YUV и запись в файл
+ *
+ * @param frame Кадр любого размера и формата (масштабируется).
+ */
+void Y4mStreamWriter::push(const QImage &frame) {
+  if (!file.is_open()) return;
+  QElapsedTimer clock;
+  clock.start();
+  convertToYuv420(scaledFrame(frame, frameSize), planes);
+  encodeNs += clock.nsecsElapsed();
+  file.write("FRAME\n", 6);
+  file.write(reinterpret_cast<const char *>(planes.data()),
+             static_cast<std::streamsize>(planes.size()));
+  bytesWritten_ += 6 + static_cast<long long>(planes.size());
+}
+
+/**
+ * @brief Закрытие файла
+ *
+ * @return true, если все кадры записаны.
+ */
+bool Y4mStreamWriter::finish() {
+  if (!file.is_open()) return false;
+  file.close();
+  return !file.fail();
+}
+
+/**
+ * @brief Размер записанного файла в байтах
+ */
+long long Y4mStreamWriter::bytesWritten() const { return bytesWritten_; }
+
+/**
+ * @brief Суммарное время перевода кадров в YUV, мс
+ */
+double Y4mStreamWriter::encodeMilliseconds() const { return encodeNs / 1.0e6; }
+
+/**
+ * @brief Дописывание 32-битного числа (младший байт первым)
+ */
+static void putDword(std::vector<uchar> &out, unsigned int value) {
+  putWord(out, static_cast<int>(value & 0xffff));
+  putWord(out, static_cast<int>(value >> 16));
+}
+
+/**
+ * @brief Дописывание кода из четырех символов RIFF
+ */
+static void putFourCc(std::vector<uchar> &out, const char *code) {
+  out.insert(out.end(), code, code + 4);
+}
+
+/**
+ * @brief Запись 32-битного числа по смещению в уже записанной части файла
+ */
+static void patchDword(std::ofstream &file, std::streamoff offset,
+                       unsigned int value) {
+  std::vector<uchar> bytes;
+  putDword(bytes, value);
+  file.seekp(offset);
+  file.write(reinterpret_cast<const char *>(bytes.data()), 4);
+}
+
+// смещения полей заголовка AVI, которые известны только после записи
+static const std::streamoff kAviRiffSize = 4;
+static const std::streamoff kAviMaxBytesPerSec = 36;
+static const std::streamoff kAviTotalFrames = 48;
+static const std::streamoff kAviBufferSize = 60;
+static const std::streamoff kAviStreamLength = 140;
+static const std::streamoff kAviStreamBufferSize = 144;
+static const std::streamoff kAviMoviSize = 216;
+static const std::streamoff kAviMoviStart = 220;  // код 'movi'
+
+/**
+ * @brief Деструктор: удаление временного файла индекса
+ *
+ * Если запись не завершена вызовом finish, файл индекса иначе остался
+ * бы на диске.
+ */
+MjpegAviWriter::~MjpegAviWriter() {
+  if (!index.is_open()) return;
+  index.close();
+  std::remove(indexPath.c_str());
+}
+
+/**
+ * @brief Создание файла AVI и запись заголовков hdrl
+ *
+ * Размеры и число кадров дописываются в заголовки при завершении записи.
+ *
+ * @param filePath Путь к файлу.
+ * @param size Размер кадра в файле.
+ * @param fps Частота кадров.
+ * @return false, если файл не удалось создать.
+ */
+bool MjpegAviWriter::open(const QString &filePath, const QSize &size,
+                          int fps) {
+  if (size.isEmpty() || fps <= 0) return false;
+  file.open(filePath.toStdString(), std::ios::binary | std::ios::trunc);
+  indexPath = filePath.toStdString() + ".idx";
+  index.open(indexPath, std::ios::binary | std::ios::in | std::ios::out |
+                            std::ios::trunc);
+  if (!file || !index) {
+    qWarning() << "Failed to open file:" << filePath;
+    file.close();
+    index.close();
+    std::remove(indexPath.c_str());
+    return false;
+  }
+  frameSize = size;
+  fps_ = fps;
+  frames = 0;
+  largestFrame = 0;
+  limitReached = false;
+  encodeFailed = false;
+  encodeNs = 0;
+  unsigned int width = static_cast<unsigned int>(size.width());
+  unsigned int height = static_cast<unsigned int>(size.height());
+  std::vector<uchar> out;
+  putFourCc(out, "RIFF");
+  putDword(out, 0);
+  putFourCc(out, "AVI ");
+  putFourCc(out, "LIST");
+  putDword(out, 192);
+  putFourCc(out, "hdrl");
+  putFourCc(out, "avih");
+  putDword(out, 56);
+  putDword(out, static_cast<unsigned int>(1000000 / fps));
+  putDword(out, 0);     // байт в секунду
+  putDword(out, 0);     // выравнивание
+  putDword(out, 0x10);  // AVIF_HASINDEX
+  putDword(out, 0);     // число кадров
+  putDword(out, 0);     // начальные кадры
+  putDword(out, 1);     // число потоков
+  putDword(out, 0);     // размер буфера
+  putDword(out, width);
+  putDword(out, height);
+  for (int i = 0; i < 4; ++i) putDword(out, 0);
+  putFourCc(out, "LIST");
+  putDword(out, 116);
+  putFourCc(out, "strl");
+  putFourCc(out, "strh");
+  putDword(out, 56);
+  putFourCc(out, "vids");
+  putFourCc(out, "MJPG");
+  putDword(out, 0);  // флаги
+  putDword(out, 0);  // приоритет и язык
+  putDword(out, 0);  // начальные кадры
+  putDword(out, 1);  // масштаб
+  putDword(out, static_cast<unsigned int>(fps));
+  putDword(out, 0);  // начало
+  putDword(out, 0);  // длина в кадрах
+  putDword(out, 0);  // размер буфера
+  putDword(out, 0xffffffffu);  // качество по умолчанию
+  putDword(out, 0);            // размер отсчета
+  putWord(out, 0);
+  putWord(out, 0);
+  putWord(out, size.width());
+  putWord(out, size.height());
+  putFourCc(out, "strf");
+  putDword(out, 40);
+  putDword(out, 40);
+  putDword(out, width);
+  putDword(out, height);
+  putWord(out, 1);
+  putWord(out, 24);
+  putFourCc(out, "MJPG");
+  putDword(out, width * height * 3);
+  for (int i = 0; i < 4; ++i) putDword(out, 0);
+  putFourCc(out, "LIST");
+  putDword(out, 0);
+  putFourCc(out, "movi");
+  file.write(reinterpret_cast<const char *>(out.data()),
+             static_cast<std::streamsize>(out.size()));
+  bytesWritten_ = static_cast<long long>(out.size());
+  return static_cast<bool>(file);
+}
+
+/**
+ * @brief Сжатие кадра в JPEG и запись в список movi
+ *
+ * Если файл достиг предела размера или кадр не удалось сжать, кадр
+ * отбрасывается и full начинает возвращать true; окно по этому признаку
+ * останавливает запись. После ошибки сжатия finish возвращает false.
+ *
+ * @param frame Кадр любого размера и формата (масштабируется).
+ */
+void MjpegAviWriter::push(const QImage &frame) {
+  if (!file.is_open() || limitReached || encodeFailed) return;
+  QElapsedTimer clock;
+  clock.start();
+  QByteArray jpeg;
+  QBuffer buffer(&jpeg);
+  buffer.open(QIODevice::WriteOnly);
+  bool encoded = scaledFrame(frame, frameSize).save(&buffer, "JPG", quality);
+  encodeNs += clock.nsecsElapsed();
+  if (!encoded) {
+    qWarning() << "Failed to encode an AVI frame, recording stopped";
+    encodeFailed = true;
+    return;
+  }
+  unsigned int size = static_cast<unsigned int>(jpeg.size());
+  unsigned int padded = size + (size & 1);
+  if (bytesWritten_ + 8 + padded + 16 * (frames + 1) + 8 > sizeLimit) {
+    qWarning() << "AVI size limit reached, recording stopped";
+    limitReached = true;
+    return;
+  }
+  std::vector<uchar> entry;
+  putFourCc(entry, "00dc");
+  putDword(entry, 0x10);  // AVIIF_KEYFRAME
+  putDword(entry, static_cast<unsigned int>(bytesWritten_ - kAviMoviStart));
+  putDword(entry, size);
+  index.write(reinterpret_cast<const char *>(entry.data()), 16);
+  std::vector<uchar> chunk;
+  putFourCc(chunk, "00dc");
+  putDword(chunk, size);
+  file.write(reinterpret_cast<const char *>(chunk.data()), 8);
+  file.write(jpeg.constData(), size);
+  if (padded != size) file.put(0);
+  bytesWritten_ += 8 + padded;
+  largestFrame = std::max(largestFrame, size);
+  ++frames;
+}
+
+/**
+ * @brief Запись индекса, размеров в заголовки и закрытие файла
+ *
+ * @return true, если файл записан; false также при ошибке чтения или
+ * записи временного файла индекса и после ошибки сжатия кадра.
+ */
+bool MjpegAviWriter::finish() {
+  if (!file.is_open()) return false;
+  long long moviEnd = bytesWritten_;
+  std::vector<uchar> header;
+  putFourCc(header, "idx1");
+  putDword(header, static_cast<unsigned int>(16 * frames));
+  file.write(reinterpret_cast<const char *>(header.data()), 8);
+  index.flush();
+  bool indexWritten = !index.fail();
+  index.seekg(0);
+  char block[65536];
+  long long indexBytes = 0;
+  while (index.read(block, sizeof(block)) || index.gcount() > 0) {
+    file.write(block, index.gcount());
+    indexBytes += index.gcount();
+  }
+  // чтение до конца файла выставляет failbit, ошибкой считается только
+  // badbit или неполный индекс
+  bool indexRead = !index.bad() && indexBytes == 16 * frames;
+  index.close();
+  std::remove(indexPath.c_str());
+  if (!indexWritten || !indexRead)
+    qWarning() << "Failed to copy AVI index:" << indexPath.c_str();
+  bytesWritten_ += 8 + 16 * frames;
+
+  unsigned int frameCount = static_cast<unsigned int>(frames);
+  unsigned int bufferSize = largestFrame + 8;
+  patchDword(file, kAviRiffSize,
+             static_cast<unsigned int>(bytesWritten_ - 8));
+  patchDword(file, kAviMaxBytesPerSec,
+             bufferSize * static_cast<unsigned int>(fps_));
+  patchDword(file, kAviTotalFrames, frameCount);
+  patchDword(file, kAviBufferSize, bufferSize);
+  patchDword(file, kAviStreamLength, frameCount);
+  patchDword(file, kAviStreamBufferSize, bufferSize);
+  patchDword(file, kAviMoviSize,
+             static_cast<unsigned int>(moviEnd - kAviMoviStart));
+  file.close();
+  return !file.fail() && indexWritten && indexRead && !encodeFailed;
+}
+
+/**
+ * @brief Размер записанного файла в байтах
+ */
+long long MjpegAviWriter::bytesWritten() const { return bytesWritten_; }
+
+/**
+ * @brief Суммарное время сжатия кадров в JPEG, мс
+ */
+double MjpegAviWriter::encodeMilliseconds() const { return encodeNs / 1.0e6; }
+
+/**
+ * @brief Установка качества JPEG
+ *
+ * @param value Качество от 0 до 100.
+ */
+void MjpegAviWriter::setQuality(int value) {
+  quality = std::clamp(value, 0, 100);
+}
+
+/**
+ * @brief Отбрасываются ли новые кадры: достигнут предел размера файла
+ * или кадр не удалось сжать
+ */
+bool MjpegAviWriter::full() const { return limitReached || encodeFailed; }
+
+/**
+ * @brief Установка предела размера файла
+ *
+ * @param bytes Предел в байтах, не больше kMaxFileBytes.
+ */
+void MjpegAviWriter::setSizeLimit(long long bytes) {
+  sizeLimit = std::clamp(bytes, 0LL, kMaxFileBytes);
+}
+
+/**
+ * @brief Число записанных кадров
+ */
+long long MjpegAviWriter::framesWritten() const { return frames; }
+
 }  // namespace s21
\ No newline at end of file
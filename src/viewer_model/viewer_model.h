@@ -42,6 +42,333 @@ class SetBackGroundColor : public SetColor {
                 ModelDefinition_t &modelDefinition) override;
 };
 
+/**
+ * @brief Параллельное выполнение function(begin, end) над частями диапазона
+ *
+ * Диапазон [0, count) делится на части не меньше minChunk элементов, каждая
+ * часть обрабатывается в своем потоке. Малые диапазоны выполняются в
+ * вызывающем потоке.
+ */
+template <typename Function>
+void parallelFor(size_t count, size_t minChunk, Function function) {
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  size_t chunks = std::min(threads, count / std::max<size_t>(minChunk, 1));
+  if (chunks <= 1) {
+    function(size_t(0), count);
+    return;
+  }
+  size_t chunkSize = (count + chunks - 1) / chunks;
+  std::vector<std::thread> workers;
+  workers.reserve(chunks - 1);
+  for (size_t begin = chunkSize; begin < count; begin += chunkSize)
+    workers.emplace_back(function, begin, std::min(begin + chunkSize, count));
+  function(size_t(0), std::min(chunkSize, count));
+  for (std::thread &worker : workers) worker.join();
+}
+
+bool hasAvx2();
+
+/**
+ * @brief Постоянные потоки для параллельных циклов, выполняемых каждый кадр
+ *
+ * Делит диапазон так же, как parallelFor, но потоки создаются один раз при
+ * первом параллельном запуске, а задание передается без выделения памяти.
+ * Вызывающий поток тоже обрабатывает части. run вызывается из одного
+ * потока за раз.
+ */
+class WorkerPool {
+ public:
+  WorkerPool() = default;
+  ~WorkerPool();
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  template <typename Function>
+  void run(size_t count, size_t minChunk, Function function) {
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t chunks = std::min(threads, count / std::max<size_t>(minChunk, 1));
+    if (chunks <= 1) {
+      function(size_t(0), count);
+      return;
+    }
+    execute(count, chunks, &invoke<Function>, &function);
+  }
+
+ private:
+  typedef void (*Task)(void *function, size_t begin, size_t end);
+  template <typename Function>
+  static void invoke(void *function, size_t begin, size_t end) {
+    (*static_cast<Function *>(function))(begin, end);
+  }
+  void execute(size_t count, size_t chunks, Task task, void *function);
+  void processChunks();
+  void work();
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable finished;
+  Task task_ = nullptr;
+  void *function_ = nullptr;
+  size_t count_ = 0;
+  size_t chunks_ = 0;
+  size_t chunkSize = 0;
+  std::atomic<size_t> nextChunk{0};
+  size_t doneChunks = 0;
+  int active = 0;
+  unsigned long long generation = 0;
+  bool stopping = false;
+};
+
+/**
+ * @brief Кэш четырехугольников толстых ребер
+ *
+ * Геометрия четырехугольников зависит только от сетки и ширины ребер,
+ * поэтому пересчитывается лишь при смене поколения сетки или ширины.
+ * Концы ребер хранятся в отдельных массивах по координатам (SoA), чтобы
+ * расчет каждой части ребер векторизовался компилятором.
+ */
+class ThickEdgeCache {
+ public:
+  const std::vector<float> &quads(const std::vector<QVector3D> &vertices,
+                                  const std::vector<unsigned int> &edges,
+                                  unsigned long long generation, float width);
+  int rebuildCount() const;
+
+ private:
+  void gatherEndpoints(const std::vector<QVector3D> &vertices,
+                       const std::vector<unsigned int> &edges);
+  void buildQuads(size_t begin, size_t end, float halfWidth);
+
+  std::vector<float> startX, startY, startZ;
+  std::vector<float> endX, endY, endZ;
+  std::vector<float> corners;
+  unsigned long long cachedGeneration = 0;
+  float cachedWidth = 0;
+  bool valid = false;
+  int rebuilds = 0;
+};
+
+/**
+ * @brief Упрощение треугольной сетки стягиванием ребер
+ *
+ * Стоимость стягивания ребра оценивается квадрикой ошибки (сумма квадратов
+ * расстояний до плоскостей смежных треугольников), ребра стягиваются в
+ * порядке возрастания стоимости до достижения заданного числа треугольников.
+ * Вершины края открытой сетки дополнительно удерживаются плоскостями,
+ * перпендикулярными граничным треугольникам.
+ */
+class MeshSimplifier {
+ public:
+  static LodLevel_t simplify(const std::vector<QVector3D> &vertices,
+                             const std::vector<unsigned int> &triangles,
+                             size_t targetTriangles,
+                             const std::atomic<bool> *cancel = nullptr);
+  static std::vector<LodLevel_t> buildChain(
+      const std::vector<QVector3D> &vertices,
+      const std::vector<unsigned int> &triangles, size_t minTriangles,
+      size_t maxLevels, const std::atomic<bool> *cancel = nullptr);
+  static void buildLevelEdges(LodLevel_t &level);
+};
+
+/**
+ * @brief Запись 24-битного BMP по строкам
+ *
+ * Заголовок с размером кадра пишется при открытии, строки дописываются
+ * полосами сверху вниз (высота в заголовке отрицательная), поэтому кадр
+ * не нужно держать в памяти целиком.
+ */
+class BmpStreamWriter {
+ public:
+  bool open(const QString &filePath, const QSize &size);
+  bool writeRows(const QImage &band);
+  bool close();
+
+ private:
+  std::ofstream file;
+  QSize frameSize;
+  int rowsWritten = 0;
+  std::vector<char> row;
+};
+
+/**
+ * @brief Кодирование анимации GIF: общая палитра, разность кадров и
+ * сжатие LZW
+ *
+ * Палитра из 256 цветов строится медианным сечением по ячейкам 5:5:5 и
+ * общая для всех кадров, поэтому кадр записывается только в пределах
+ * прямоугольника, изменившегося с прошлого кадра.
+ */
+class GifEncoder {
+ public:
+  static void buildPalette(const QImage &frame, std::vector<QRgb> &palette,
+                           std::vector<uchar> &lookup);
+  static void mapToPalette(const QImage &frame,
+                           const std::vector<uchar> &lookup,
+                           std::vector<uchar> &indices);
+  static QRect changedRect(const std::vector<uchar> &previous,
+                           const std::vector<uchar> &current,
+                           const QSize &size);
+  static void lzwEncode(const std::vector<uchar> &indices, int minCodeSize,
+                        std::vector<uchar> &out);
+  static std::vector<uchar> encodeFrame(const std::vector<uchar> &indices,
+                                        const QSize &size, const QRect &rect,
+                                        int delay);
+  static std::vector<uchar> header(const QSize &size, int loops,
+                                   const std::vector<QRgb> &palette);
+};
+
+/**
+ * @brief Приемник кадров записи (GIF или видео)
+ *
+ * Кадры передаются по одному и сразу записываются или кодируются, так что
+ * запись любой длины не накапливает кадры в памяти.
+ */
+class FrameSink {
+ public:
+  virtual ~FrameSink() = default;
+  virtual bool open(const QString &filePath, const QSize &size, int fps) = 0;
+  virtual void push(const QImage &frame) = 0;
+  virtual bool finish() = 0;
+  virtual long long bytesWritten() const = 0;
+  virtual double encodeMilliseconds() const = 0;
+  // true - новые кадры отбрасываются (предел размера или ошибка записи)
+  virtual bool full() const { return false; }
+};
+
+/**
+ * @brief Запись GIF в отдельных потоках по схеме производитель-потребитель
+ *
+ * Поток записи только передает кадры в ограниченную очередь;
+ * рабочие потоки масштабируют и кодируют кадры, а готовые кадры
+ * записываются в файл строго по порядку.
+ */
+class GifStreamWriter : public FrameSink {
+ public:
+  // кадров, ожидающих кодирования; при переполнении push ждет
+  static constexpr size_t kMaxQueuedFrames = 8;
+
+  ~GifStreamWriter();
+  bool open(const QString &filePath, const QSize &size, int fps) override;
+  bool open(const QString &filePath, const QSize &size, int fps,
+            int workers);
+  void push(const QImage &frame) override;
+  bool finish() override;
+  int framesWritten() const;
+  long long bytesWritten() const override;
+  double encodeMilliseconds() const override;
+
+ private:
+  void workerLoop();
+  void writeHeader(const QImage &frame);
+
+  std::ofstream file;
+  QSize frameSize;
+  int delay = 10;
+  std::vector<QRgb> palette;
+  std::vector<uchar> lookup;  // индекс палитры для каждой ячейки 5:5:5
+  std::vector<std::thread> workers_;
+  std::mutex mutex;
+  std::condition_variable queueChanged;
+  std::deque<std::pair<int, QImage>> queue;
+  std::map<int, std::vector<uchar>> encoded;
+  // индексы палитры кадров, еще не сравненных со следующим кадром
+  std::map<int, std::shared_ptr<const std::vector<uchar>>> quantized;
+  int nextFrame = 0;
+  int nextToWrite = 0;
+  bool closing = false;
+  long long bytesWritten_ = 0;
+  qint64 encodeNs = 0;
+};
+
+/**
+ * @brief Кольцевой буфер кадров между захватом и кодированием
+ *
+ * Захват никогда не ждет: если все ячейки заняты, кадр отбрасывается и
+ * учитывается в счетчике. Потребитель ждет кадры в отдельном потоке.
+ */
+class FrameRing {
+ public:
+  explicit FrameRing(size_t capacity = 16);
+  bool tryPush(const QImage &frame);
+  bool pop(QImage &frame);
+  void close();
+  long long pushed() const;
+  long long dropped() const;
+
+ private:
+  std::vector<QImage> frames;
+  size_t head = 0;
+  size_t count = 0;
+  bool closed = false;
+  long long pushed_ = 0;
+  long long dropped_ = 0;
+  mutable std::mutex mutex;
+  std::condition_variable available;
+};
+
+/**
+ * @brief Запись несжатого видео YUV4MPEG2 (4:2:0)
+ *
+ * Кадр переводится в YUV (BT.601) и сразу дописывается в файл; память
+ * занимает только буфер одного кадра.
+ */
+class Y4mStreamWriter : public FrameSink {
+ public:
+  bool open(const QString &filePath, const QSize &size, int fps) override;
+  void push(const QImage &frame) override;
+  bool finish() override;
+  long long bytesWritten() const override;
+  double encodeMilliseconds() const override;
+  static void convertToYuv420(const QImage &frame, std::vector<uchar> &planes,
+                              bool vectorized = true);
+
+ private:
+  std::ofstream file;
+  QSize frameSize;
+  std::vector<uchar> planes;
+  long long bytesWritten_ = 0;
+  qint64 encodeNs = 0;
+};
+
+/**
+ * @brief Запись видео MJPEG в контейнере AVI
+ *
+ * Кадры сжимаются в JPEG и дописываются в список movi; записи индекса
+ * копятся во временном файле и добавляются в конец при завершении.
+ */
+class MjpegAviWriter : public FrameSink {
+ public:
+  // предел размера файла RIFF AVI 1.0
+  static constexpr long long kMaxFileBytes = 0x7fffffffLL;
+
+  ~MjpegAviWriter();
+  bool open(const QString &filePath, const QSize &size, int fps) override;
+  void push(const QImage &frame) override;
+  bool finish() override;
+  long long bytesWritten() const override;
+  double encodeMilliseconds() const override;
+  bool full() const override;
+  void setQuality(int value);
+  void setSizeLimit(long long bytes);
+  long long framesWritten() const;
+
+ private:
+  std::ofstream file;
+  std::fstream index;
+  std::string indexPath;
+  QSize frameSize;
+  int fps_ = 10;
+  int quality = 85;
+  long long sizeLimit = kMaxFileBytes;
+  long long frames = 0;
+  long long bytesWritten_ = 0;
+  unsigned int largestFrame = 0;
+  std::atomic<bool> limitReached{false};
+  std::atomic<bool> encodeFailed{false};
+  qint64 encodeNs = 0;
+};
+
 /**
  * @brief Класс модели вьювера
  *
@@ -54,6 +381,20 @@ class ViewerModel {
   ViewerModel();
   ~ViewerModel();
 
+  // шаги по умолчанию, если значение не задано (равно 0)
+  static constexpr float kDefaultTranslateStep = 0.5f;
+  static constexpr float kDefaultRotateStep = 15.0f;
+  // число ребер, на которое рассчитана одна часть сетки при отсечении
+  static constexpr size_t kChunkEdges = 4096;
+  // число ребер упрощенной модели, рисуемой во время вращения мышью
+  static constexpr size_t kDefaultLodBudget = 1000000;
+  // цепочка упрощенных сеток: уровни вдвое меньше предыдущего, пока число
+  // треугольников не меньше kMinLodTriangles
+  static constexpr size_t kMinLodTriangles = 1000;
+  static constexpr size_t kMaxLodLevels = 6;
+  // площадь экрана в пикселях, на которую нужен хотя бы один треугольник
+  static constexpr float kPixelsPerTriangle = 2.0f;
+
   void translateFigure(const translateAction_t &translateAct,
                        float translateValue);
   void rotateAxis(const rotateAction_t &rotateAct, float rotateValue);
@@ -63,33 +404,99 @@ class ViewerModel {
   void scaleFigure(const ScaleType_t &scaleF, float scaleValue);
   void setFacetWidth(const ScaleType_t &scaleF);
   void setVerticeWidth(const ScaleType_t &scaleF);
+  void setFacetWidthValue(float facetWidth);
+  void setVerticeWidthValue(float verticeWidth);
+  void adjustScale(float scaleDelta, float fovDelta);
+  void applyRotation(const QQuaternion &rotation,
+                     const QVector3D &angles = QVector3D());
 
   void SetColorStrategy(SetColor *strategy, const QColor &color);
   void setFacetColor(const QColor &FacetColor);
   void setVerticeColor(const QColor &VerticeColor);
   void setBackGroundColor(const QColor &backGroundColor);
 
-  std::vector<QVector3D> getVertices();
-  std::vector<unsigned int> getFacets();
+  const std::vector<QVector3D> &getVertices();
+  const std::vector<unsigned int> &getFacets();
+  const std::vector<unsigned int> &getEdges();
+  const std::vector<MeshChunk_t> &getChunks();
+  int collectVisibleEdges(const QMatrix4x4 &mvp,
+                          std::vector<EdgeRange_t> &ranges);
+  static bool isChunkVisible(const MeshChunk_t &chunk, const QMatrix4x4 &mvp);
+  size_t cullSubPixelEdges(const QMatrix4x4 &mvp, const QSizeF &viewport,
+                           float threshold,
+                           const std::vector<EdgeRange_t> &ranges,
+                           std::vector<unsigned int> &kept);
+  const std::vector<unsigned int> &getLodEdges(size_t budget);
+  unsigned long long getLodRevision() const;
+  const std::vector<unsigned int> &getTriangles();
+  float getBoundingRadius() const;
+  const std::vector<LodLevel_t> &getLodChain();
+  unsigned long long getLodChainRevision() const;
+  bool isLodChainBuilding() const;
+  void waitForLodChain();
+  int selectLodLevel(float projectedPixels);
+  bool exportLodLevel(size_t level, const QString &filePath);
+  const std::vector<float> &getThickEdgeQuads();
+  int getThickEdgeRebuildCount() const;
+  unsigned long long getMeshGeneration() const;
   AffineTransform_t getAffineTransform();
   ModelDefinition_t getModelDefinition();
+  const QMatrix4x4 &getModelMatrix();
+  QMatrix4x4 getProjectionMatrix(float aspectRatio);
+  static QMatrix4x4 modelMatrixFor(const AffineTransform_t &transform);
+  static QMatrix4x4 projectionMatrixFor(const AffineTransform_t &transform,
+                                        float aspectRatio);
 
   void MouseButtonMove(QPoint delta);
   void MouseWheelMove(QPoint delta);
+  static QQuaternion arcballRotation(QPoint delta);
+  static QQuaternion rollRotation(QPoint delta);
+  static QVector3D mouseAngles(QPoint delta);
+  static QVector3D rollAngles(QPoint delta);
+  unsigned int getDirtyFlags() const;
+  void clearDirtyFlags(unsigned int flags);
   void loadOBJ(const QString &filePath);
   float makeFloat(const QString &inputText);
 
   // in public section for tests
   void normalizeVertices();
+  void buildEdges();
   void saveModelDefinition();
   void readModelDefinition();
 
  private:
+  void invalidateModelMatrix();
+  void buildChunks();
+  void startLodChainBuild();
+  void cancelLodChainBuild();
+  void markDirty(unsigned int flags);
+
   std::vector<QVector3D> vertices;
   std::vector<unsigned int> facets;
+  std::vector<unsigned int> edges;
+  std::vector<MeshChunk_t> chunks;
+  std::vector<float> projected;
+  std::vector<std::vector<unsigned int>> cullSlices;
+  WorkerPool cullPool;
+  std::vector<unsigned int> triangles;
+  float boundingRadius = 0;
+  std::vector<LodLevel_t> lodChain;
+  unsigned long long lodChainRevision = 0;
+  std::future<std::vector<LodLevel_t>> pendingLodChain;
+  std::shared_ptr<std::atomic<bool>> lodChainCancel;
+  std::vector<unsigned int> lodEdges;
+  unsigned long long lodRevision = 0;
+  unsigned long long lodGeneration = 0;
+  size_t lodBudget = 0;
+  bool lodValid = false;
+  unsigned long long meshGeneration = 0;
+  ThickEdgeCache thickEdgeCache;
   AffineTransform_t affine_transform;
   ModelDefinition_t modelDefinition;
   SetColor *setColor_;
+  QMatrix4x4 modelMatrix;
+  bool modelMatrixValid = false;
+  unsigned int dirtyFlags = DirtyAll;
 };
 
 }  // namespace s21
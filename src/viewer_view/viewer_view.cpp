@@ -11,81 +11,1753 @@ namespace s21 {
  * @param Controller Указатель на контроллер представления.
  */
 OpenGLWidget::OpenGLWidget(ViewerController *Controller)
-    : viewer_controller(Controller), draw_(nullptr){};
+    : viewer_controller(Controller) {
+  // содержимое кадра сохраняется между вызовами paintGL, поэтому кадр без
+  // изменений можно не перерисовывать
+  setUpdateBehavior(QOpenGLWidget::PartialUpdate);
+  frameTimer.setSingleShot(true);
+  connect(&frameTimer, &QTimer::timeout, this, [this]() {
+    frameInFlight = true;
+    update();
+  });
+  connect(this, &QOpenGLWidget::frameSwapped, this,
+          &OpenGLWidget::onFrameSwapped);
+  // после паузы во вращении модель перерисовывается с полной детализацией
+  lodIdleTimer.setSingleShot(true);
+  connect(&lodIdleTimer, &QTimer::timeout, this, [this]() {
+    if (wheelGesture) finishWheelGesture();
+    interacting = false;
+    needsRedraw = true;
+    requestUpdate();
+  });
+  // готовая цепочка упрощенных сеток показывается сразу, а не при
+  // следующем изменении модели
+  lodChainTimer.setInterval(50);
+  connect(&lodChainTimer, &QTimer::timeout, this, [this]() {
+    if (viewer_controller->modelIsLodChainBuilding()) return;
+    lodChainTimer.stop();
+    needsRedraw = true;
+    scheduleFrame();
+  });
+  // тик, пришедший раньше чтения предыдущего кадра, считается потерянным
+  captureTimer.setTimerType(Qt::PreciseTimer);
+  connect(&captureTimer, &QTimer::timeout, this, [this]() {
+    if (captureRequested) ++stats.droppedFrames;
+    captureRequested = true;
+    scheduleFrame();
+  });
+};
+
+/**
+ * @brief Деструктор OpenGL-виджета.
+ *
+ * Освобождает буферы видеопамяти в контексте виджета.
+ */
+OpenGLWidget::~OpenGLWidget() {
+  makeCurrent();
+  retained.destroy();
+  levelRenderer.destroy();
+  accumulation.reset();
+  for (QOpenGLBuffer &buffer : captureBuffers) buffer.destroy();
+  doneCurrent();
+}
+
+/**
+ * @brief Инициализация OpenGL, настройка функций и включение глубинного теста.
+ *
+ * Настроены параметры, необходимые для работы OpenGL, такие как глубинный тест
+ * и цвет фона.
+ */
+void OpenGLWidget::initializeGL() {
+  initializeOpenGLFunctions();
+  glEnable(GL_DEPTH_TEST);
+  glClearColor(0.1f, 0.1f, 0.5f, 1.0f);
+  if (!retained.initialize())
+    qWarning() << "Vertex buffers are unavailable, using immediate mode";
+  else if (!levelRenderer.initialize())
+    qWarning() << "Simplified meshes are unavailable, using the full mesh";
+  renderPass.reset();
+  accumulation.reset();
+  refineRequested = false;
+  culledValid = false;
+  needsRedraw = true;
+  for (int i = 0; i < 2; ++i) {
+    captureBuffers[i].destroy();
+    captureSizes[i] = QSize();
+    capturePending[i] = false;
+  }
+}
+
+/**
+ * @brief Настройка области просмотра для OpenGL.
+ *
+ * Изменяет область отображения в соответствии с размером окна. Вызывается при
+ * изменении размера окна.
+ *
+ * @param w Ширина нового окна.
+ * @param h Высота нового окна.
+ */
+void OpenGLWidget::resizeGL(int w, int h) {
+  glViewport(0, 0, w, h);
+  needsRedraw = true;
+}
+
+/**
+ * @brief Установка бюджета кадра.
+ *
+ * Накопленный ввод применяется не чаще одного раза за бюджет, даже если
+ * кадры успевают выводиться быстрее.
+ *
+ * @param milliseconds Минимальный интервал между кадрами в миллисекундах.
+ */
+void OpenGLWidget::setFrameBudget(int milliseconds) {
+  frameBudgetMs = std::max(0, milliseconds);
+}
+
+/**
+ * @brief Статистика последних кадров (объединенные события ввода, время
+ * кадра).
+ *
+ * @return Структура со статистикой.
+ */
+const FrameStats_t &OpenGLWidget::frameStats() const { return stats; }
+
+/**
+ * @brief Планирование следующего кадра с учетом бюджета.
+ *
+ * Если кадр уже выводится или запланирован, новый не создается: ввод просто
+ * накапливается до следующего вызова paintGL.
+ */
+void OpenGLWidget::scheduleFrame() {
+  if (frameInFlight || frameTimer.isActive()) return;
+  qint64 elapsed = frameClock.isValid() ? frameClock.elapsed() : frameBudgetMs;
+  qint64 remaining = frameBudgetMs - elapsed;
+  if (remaining > 0) {
+    frameTimer.start(static_cast<int>(remaining));
+  } else {
+    frameInFlight = true;
+    update();
+  }
+}
+
+/**
+ * @brief Обработка завершения вывода кадра (синхронизация с vsync).
+ *
+ * Если за время вывода накопился новый ввод, планируется следующий кадр.
+ */
+void OpenGLWidget::onFrameSwapped() {
+  frameInFlight = false;
+  // needsRedraw остается после кадра, если прогрессивная отрисовка не
+  // завершена
+  if (pendingEvents > 0 || needsRedraw || captureRequested ||
+      viewer_controller->modelGetDirtyFlags() != DirtyNone)
+    scheduleFrame();
+}
+
+/**
+ * @brief Запрос перерисовки после изменения модели.
+ *
+ * Кадр планируется, только если в модели что-то изменилось или виджет сам
+ * запросил перерисовку (например, возврат полной детализации после
+ * вращения).
+ */
+void OpenGLWidget::requestUpdate() {
+  if (needsRedraw || viewer_controller->modelGetDirtyFlags() != DirtyNone)
+    scheduleFrame();
+}
+
+/**
+ * @brief Установка бюджета ребер упрощенной модели.
+ *
+ * @param edges Максимальное число ребер во время вращения (0 - отключено).
+ */
+void OpenGLWidget::setLodBudget(size_t edges) {
+  lodBudget_ = edges;
+  needsRedraw = true;
+  requestUpdate();
+}
+
+/**
+ * @brief Текущий бюджет ребер упрощенной модели.
+ */
+size_t OpenGLWidget::lodBudget() const { return lodBudget_; }
+
+/**
+ * @brief Установка паузы, после которой возвращается полная детализация.
+ *
+ * @param milliseconds Время без ввода в миллисекундах.
+ */
+void OpenGLWidget::setLodIdleTimeout(int milliseconds) {
+  lodIdleMs = std::max(0, milliseconds);
+}
+
+/**
+ * @brief Включение отсечения ребер короче порога в пикселях.
+ *
+ * Отсечение применяется к тонким ребрам исходной сетки в буферном режиме.
+ *
+ * @param enabled true - короткие ребра не рисуются.
+ */
+void OpenGLWidget::setSubPixelCulling(bool enabled) {
+  subPixelCulling = enabled;
+  needsRedraw = true;
+  scheduleFrame();
+}
+
+/**
+ * @brief Установка минимальной экранной длины рисуемого ребра.
+ *
+ * @param pixels Порог в пикселях.
+ */
+void OpenGLWidget::setSubPixelThreshold(float pixels) {
+  subPixelThreshold_ = std::max(0.0f, pixels);
+  needsRedraw = true;
+  scheduleFrame();
+}
+
+/**
+ * @brief Текущий порог отсечения коротких ребер в пикселях.
+ */
+float OpenGLWidget::subPixelThreshold() const { return subPixelThreshold_; }
+
+/**
+ * @brief Включение прогрессивной отрисовки.
+ *
+ * Кадр рисуется частями во внеэкранный буфер, пока модель не изменится;
+ * частично накопленное изображение выводится в каждом кадре.
+ *
+ * @param enabled true - ребра накапливаются за несколько кадров.
+ */
+void OpenGLWidget::setProgressiveRendering(bool enabled) {
+  progressiveEnabled = enabled;
+  refineRequested = false;
+  needsRedraw = true;
+  scheduleFrame();
+}
+
+/**
+ * @brief Установка времени, отводимого на часть прогрессивного кадра.
+ *
+ * @param milliseconds Время отрисовки за один вызов paintGL.
+ */
+void OpenGLWidget::setProgressiveBudget(int milliseconds) {
+  progressiveBudgetMs = std::max(1, milliseconds);
+}
+
+/**
+ * @brief Запуск захвата кадров виджета с заданной частотой.
+ *
+ * Кадры передаются в кольцевой буфер без ожидания; кадры, не поместившиеся
+ * в буфер или пропущенные из-за занятости виджета, учитываются в
+ * FrameStats_t::droppedFrames.
+ *
+ * @param ring Буфер для кадров (должен жить до вызова stopCapture).
+ * @param fps Частота захвата.
+ */
+void OpenGLWidget::startCapture(FrameRing *ring, int fps) {
+  captureRing = ring;
+  captureRequested = false;
+  stats.capturedFrames = 0;
+  stats.droppedFrames = 0;
+  captureTimer.start(std::max(1, 1000 / std::max(1, fps)));
+}
+
+/**
+ * @brief Остановка захвата: последний прочитанный кадр забирается из
+ * буфера пикселей, буферы освобождаются.
+ */
+void OpenGLWidget::stopCapture() {
+  captureTimer.stop();
+  captureRequested = false;
+  if (!captureRing) return;
+  makeCurrent();
+  collectCapture(captureIndex ^ 1);
+  for (int i = 0; i < 2; ++i) {
+    captureBuffers[i].destroy();
+    captureSizes[i] = QSize();
+    capturePending[i] = false;
+  }
+  doneCurrent();
+  captureRing = nullptr;
+}
+
+/**
+ * @brief Чтение текущего кадра для записи.
+ *
+ * Копирование запускается в буфер пикселей и выполняется видеокартой
+ * асинхронно; из второго буфера забирается кадр, прочитанный на прошлом
+ * тике. Без поддержки буферов кадр читается напрямую.
+ */
+void OpenGLWidget::readbackFrame() {
+  captureRequested = false;
+  if (!captureRing) return;
+  QSize size = QSize(width(), height()) * devicePixelRatio();
+  if (size.isEmpty()) return;
+  int current = captureIndex;
+  QOpenGLBuffer &buffer = captureBuffers[current];
+  if (!buffer.isCreated() && !buffer.create()) {
+    QImage frame(size, QImage::Format_RGBA8888);
+    for (int y = 0; y < size.height(); ++y)
+      glReadPixels(0, size.height() - 1 - y, size.width(), 1, GL_RGBA,
+                   GL_UNSIGNED_BYTE, frame.scanLine(y));
+    deliverCapture(frame);
+    return;
+  }
+  buffer.setUsagePattern(QOpenGLBuffer::StreamRead);
+  buffer.bind();
+  if (captureSizes[current] != size) {
+    buffer.allocate(size.width() * size.height() * 4);
+    captureSizes[current] = size;
+  }
+  glReadPixels(0, 0, size.width(), size.height(), GL_RGBA, GL_UNSIGNED_BYTE,
+               nullptr);
+  buffer.release();
+  capturePending[current] = true;
+  captureIndex ^= 1;
+  collectCapture(captureIndex);
+}
+
+/**
+ * @brief Перенос прочитанного кадра из буфера пикселей в кольцевой буфер.
+ *
+ * Строки переворачиваются при копировании: OpenGL хранит кадр снизу вверх.
+ *
+ * @param index Номер буфера пикселей.
+ */
+void OpenGLWidget::collectCapture(int index) {
+  if (!capturePending[index]) return;
+  capturePending[index] = false;
+  QOpenGLBuffer &buffer = captureBuffers[index];
+  const QSize &size = captureSizes[index];
+  buffer.bind();
+  const uchar *pixels =
+      static_cast<const uchar *>(buffer.map(QOpenGLBuffer::ReadOnly));
+  if (pixels) {
+    QImage frame(size, QImage::Format_RGBA8888);
+    size_t rowBytes = static_cast<size_t>(size.width()) * 4;
+    for (int y = 0; y < size.height(); ++y)
+      std::memcpy(frame.scanLine(size.height() - 1 - y),
+                  pixels + rowBytes * y, rowBytes);
+    buffer.unmap();
+    deliverCapture(frame);
+  } else {
+    ++stats.droppedFrames;
+  }
+  buffer.release();
+}
+
+/**
+ * @brief Передача кадра в кольцевой буфер без ожидания.
+ *
+ * @param frame Захваченный кадр.
+ */
+void OpenGLWidget::deliverCapture(const QImage &frame) {
+  if (captureRing->tryPush(frame))
+    ++stats.capturedFrames;
+  else
+    ++stats.droppedFrames;
+}
+
+/**
+ * @brief Дорисовка следующей части кадра во внеэкранный буфер.
+ *
+ * Ребра из frame_.edgeRanges рисуются частями по kProgressiveSlice, пока не
+ * истечет бюджет; вершины рисуются один раз после всех ребер. Буфер
+ * очищается при изменении модели, размера, набора ребер или источника
+ * буферов; готовое изображение при перерисовке без изменений копируется
+ * заново. Накопленное изображение копируется в кадр виджета.
+ *
+ * @param modelChanged Были ли в модели изменения с прошлого кадра.
+ * @param paintClock Часы, запущенные в начале paintGL.
+ */
+void OpenGLWidget::drawProgressive(bool modelChanged,
+                                   const QElapsedTimer &paintClock) {
+  QSize size(qRound(frame_.viewport.width()),
+             qRound(frame_.viewport.height()));
+  const std::vector<EdgeRange_t> *ranges = frame_.edgeRanges;
+  size_t total = 0;
+  for (const EdgeRange_t &range : *ranges) total += range.edgeCount;
+  bool reset = modelChanged || !accumulation ||
+               accumulation->size() != size || ranges != progressiveRanges ||
+               total != progressiveTotal ||
+               stats.lodLevel != progressiveLevel ||
+               frame_.retained != progressiveSource;
+  if (!accumulation || accumulation->size() != size)
+    accumulation = std::make_unique<QOpenGLFramebufferObject>(
+        size, QOpenGLFramebufferObject::Depth);
+  accumulation->bind();
+  if (reset) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    progressiveCursor = 0;
+    progressiveRanges = ranges;
+    progressiveTotal = total;
+    progressiveLevel = stats.lodLevel;
+    progressiveSource = frame_.retained;
+    progressiveVertices = false;
+  }
+  frame_.edgeRanges = &sliceRanges;
+  frame_.drawVertices = false;
+  while (progressiveCursor < total) {
+    size_t end = std::min(total, progressiveCursor + kProgressiveSlice);
+    sliceRanges.clear();
+    size_t offset = 0;
+    for (const EdgeRange_t &range : *ranges) {
+      size_t from = std::max(progressiveCursor, offset);
+      size_t to = std::min(end, offset + range.edgeCount);
+      if (from < to) {
+        EdgeRange_t slice;
+        slice.firstEdge = static_cast<unsigned int>(range.firstEdge + from -
+                                                    offset);
+        slice.edgeCount = static_cast<unsigned int>(to - from);
+        sliceRanges.push_back(slice);
+      }
+      offset += range.edgeCount;
+    }
+    renderPass->draw(frame_);
+    progressiveCursor = end;
+    // команды выполняются асинхронно, поэтому время части измеряется после
+    // ее завершения
+    glFinish();
+    if (paintClock.elapsed() >= progressiveBudgetMs) break;
+  }
+  if (progressiveCursor >= total && !progressiveVertices) {
+    frame_.drawEdges = false;
+    frame_.drawVertices = true;
+    renderPass->draw(frame_);
+    progressiveVertices = true;
+  }
+  frame_.edgeRanges = ranges;
+  frame_.drawEdges = true;
+  frame_.drawVertices = true;
+  QOpenGLFramebufferObject::bindDefault();
+  QOpenGLFramebufferObject::blitFramebuffer(nullptr, accumulation.get());
+  stats.progressiveDone =
+      total > 0 ? static_cast<float>(progressiveCursor) / total : 1.0f;
+  refineRequested = !progressiveVertices;
+  if (refineRequested) needsRedraw = true;
+}
+
+/**
+ * @brief Выбор уровня детализации по размеру модели на экране.
+ *
+ * Размер оценивается по описанной сфере модели: ее радиус умножается на
+ * наибольшую экранную длину осей модели в матрице mvp.
+ *
+ * @param mvp Произведение матриц проекции и модели.
+ * @param viewport Размер области вывода в пикселях.
+ * @return Номер уровня или -1 для исходной сетки.
+ */
+int OpenGLWidget::selectLodLevel(const QMatrix4x4 &mvp,
+                                 const QSizeF &viewport) {
+  QVector4D center = mvp.map(QVector4D(0.0f, 0.0f, 0.0f, 1.0f));
+  float w = std::max(std::fabs(center.w()), 1e-6f);
+  float axis = 0.0f;
+  for (int i = 0; i < 3; ++i) {
+    QVector4D column = mvp.column(i);
+    axis = std::max(axis, QVector2D(column.x(), column.y()).length());
+  }
+  // диаметр в NDC равен 2 * r * axis / w, а высота окна - 2 единицам NDC
+  float pixels = viewer_controller->modelGetBoundingRadius() * axis / w *
+                 static_cast<float>(viewport.height());
+  return viewer_controller->modelSelectLodLevel(pixels);
+}
+
+/**
+ * @brief Переход к упрощенной отрисовке на время вращения мышью.
+ *
+ * Каждое событие ввода продлевает упрощенный режим на lodIdleMs.
+ */
+void OpenGLWidget::beginInteractionLod() {
+  interacting = true;
+  lodIdleTimer.start(lodIdleMs);
+}
+
+/**
+ * @brief Самый подробный уровень цепочки, умещающийся в бюджет ребер
+ * упрощенной отрисовки.
+ *
+ * @return Номер уровня или -1, если ни один уровень не умещается.
+ */
+int OpenGLWidget::budgetLodLevel() {
+  const std::vector<LodLevel_t> &chain = viewer_controller->modelGetLodChain();
+  for (size_t level = 0; level < chain.size(); ++level)
+    if (chain[level].edges.size() / 2 <= lodBudget_)
+      return static_cast<int>(level);
+  return -1;
+}
+
+/**
+ * @brief Включение или отключение отрисовки из буферов видеопамяти.
+ *
+ * @param enabled false - всегда использовать стратегии glBegin/glEnd.
+ */
+void OpenGLWidget::setRetainedRendering(bool enabled) {
+  retainedEnabled = enabled;
+  renderPass.reset();
+  needsRedraw = true;
+  update();
+}
+
+/**
+ * @brief Сравнение времени кадра при отрисовке glBegin/glEnd и из буферов.
+ *
+ * Каждый путь отрисовки выполняется заданное число кадров после одного
+ * прогревочного кадра. Время измеряется до завершения glFinish.
+ *
+ * @param frames Число кадров для каждого пути.
+ * @return Среднее время кадра для каждого пути и статистика последнего кадра
+ * (отсечение, уровень детализации).
+ */
+RenderBenchmark_t OpenGLWidget::benchmark(int frames) {
+  RenderBenchmark_t result;
+  result.frames = frames;
+  if (frames <= 0) return result;
+  makeCurrent();
+  result.renderer = QString::fromLatin1(
+      reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+  bool savedMode = retainedEnabled;
+  double *targets[2] = {&result.immediateMs, &result.retainedMs};
+  for (int mode = 0; mode < 2; ++mode) {
+    retainedEnabled = mode == 1;
+    renderPass.reset();
+    needsRedraw = true;
+    paintGL();
+    glFinish();
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < frames; ++i) {
+      needsRedraw = true;
+      paintGL();
+      glFinish();
+    }
+    *targets[mode] = timer.nsecsElapsed() / 1.0e6 / frames;
+  }
+  result.lastFrame = stats;
+  retainedEnabled = savedMode;
+  renderPass.reset();
+  doneCurrent();
+  return result;
+}
+
+/**
+ * @brief Отрисовка одного кадра вне цикла событий.
+ *
+ * Контекст виджета должен быть текущим (makeCurrent). Используется, чтобы
+ * измерить сам кадр без вывода окна на экран.
+ */
+void OpenGLWidget::renderFrame() { paintGL(); }
+
+/**
+ * @brief Установка истории, в которую записываются команды мыши.
+ *
+ * @param history История команд (nullptr - команды не записываются).
+ */
+void OpenGLWidget::setCommandHistory(CommandHistory *history) {
+  history_ = history;
+}
+
+/**
+ * @brief Выполнение команды ввода и запись ее в историю.
+ *
+ * @param command Команда, созданная из накопленного ввода.
+ */
+void OpenGLWidget::runCommand(std::unique_ptr<Command> command) {
+  command->execute();
+  if (history_) history_->push(std::move(command));
+}
+
+/**
+ * @brief Применение накопленного между кадрами ввода к модели.
+ *
+ * Все смещения мыши и шаги колесика, пришедшие с прошлого кадра, выполняются
+ * одной командой на каждый тип действия и записываются в историю.
+ */
+void OpenGLWidget::applyPendingInput() {
+  if (!pendingRotate.isNull())
+    runCommand(std::make_unique<MouseRotateCommand>(
+        viewer_controller, ViewerModel::arcballRotation(pendingRotate),
+        ViewerModel::mouseAngles(pendingRotate)));
+  if (!pendingRoll.isNull())
+    runCommand(std::make_unique<MouseRotateCommand>(
+        viewer_controller, ViewerModel::rollRotation(pendingRoll),
+        ViewerModel::rollAngles(pendingRoll)));
+  if (pendingWheelSteps != 0)
+    runCommand(std::make_unique<ScaleCommand>(
+        viewer_controller, 0.0f, pendingWheelSteps > 0 ? scalePlus : scaleMinus,
+        std::abs(pendingWheelSteps)));
+  stats.coalescedEvents = pendingEvents;
+  stats.maxCoalescedEvents = std::max(stats.maxCoalescedEvents, pendingEvents);
+  pendingRotate = QPoint();
+  pendingRoll = QPoint();
+  pendingWheelSteps = 0;
+  pendingEvents = 0;
+}
+
+/**
+ * @brief Выбор режима вершин для прохода с заданным режимом ребер.
+ *
+ * @param definition Стиль модели.
+ * @param useRetained Доступны ли буферы видеопамяти.
+ * @param sprites Доступны ли точечные спрайты.
+ * @return Проход отрисовки для пары режимов.
+ */
+template <typename FacetDraw>
+static std::unique_ptr<RenderPass> makeRenderPass(
+    const ModelDefinition_t &definition, bool useRetained, bool sprites) {
+  if (definition.verticeType == None)
+    return std::make_unique<StyledRenderPass<FacetDraw, DrawVerticeNone>>();
+  if (sprites)
+    return std::make_unique<StyledRenderPass<FacetDraw, DrawVerticeSprite>>();
+  if (definition.verticeType == Square && useRetained)
+    return std::make_unique<StyledRenderPass<FacetDraw, DrawVerticeBuffer>>();
+  if (definition.verticeType == Square)
+    return std::make_unique<StyledRenderPass<FacetDraw, DrawVerticeSquare>>();
+  return std::make_unique<StyledRenderPass<FacetDraw, DrawVerticeCircle>>();
+}
+
+/**
+ * @brief Выбор режимов ребер и вершин для стиля модели.
+ *
+ * @param definition Стиль модели.
+ * @param retained Отрисовщик из буферов (nullptr - буферы не используются).
+ * @return Проход отрисовки для стиля.
+ */
+static std::unique_ptr<RenderPass> makeStyledPass(
+    const ModelDefinition_t &definition, const RetainedRenderer *retained) {
+  bool useRetained = retained && retained->isValid();
+  bool thickLines = useRetained && retained->hasThickLines();
+  bool sprites = useRetained && retained->hasPointSprites();
+  if (definition.facetWidth == 0 && useRetained)
+    return makeRenderPass<DrawFacetBuffer>(definition, useRetained, sprites);
+  if (definition.facetWidth == 0)
+    return makeRenderPass<DrawFacetZero>(definition, useRetained, sprites);
+  if (thickLines)
+    return makeRenderPass<DrawFacetShader>(definition, useRetained, sprites);
+  return makeRenderPass<DrawFacetThick>(definition, useRetained, sprites);
+}
+
+/**
+ * @brief Сборка прохода отрисовки для текущего стиля модели.
+ *
+ * Режим ребер и режим вершин выбираются один раз при смене стиля, а не в
+ * каждом кадре, поэтому устойчивый кадр не выделяет память.
+ */
+void OpenGLWidget::buildRenderPass() {
+  renderPass = makeStyledPass(modelDefinition_,
+                              retainedEnabled ? &retained : nullptr);
+}
+
+/**
+ * @brief Включение сглаживания ребер
+ *
+ * @param enabled true - ребра рисуются с учетом покрытия пикселей.
+ */
+void SoftwareRenderer::setAntialiasing(bool enabled) { antialiasing = enabled; }
+
+/**
+ * @brief Разрешение векторной растеризации сглаженных ребер
+ *
+ * @param enabled false - всегда используется скалярный код.
+ */
+void SoftwareRenderer::setVectorized(bool enabled) { vectorized = enabled; }
+
+/**
+ * @brief Разрешение разбивать кадр на потоки
+ *
+ * @param enabled false - кадр рисуется в вызывающем потоке (когда
+ * одновременно рисуются несколько кадров).
+ */
+void SoftwareRenderer::setParallel(bool enabled) { parallel = enabled; }
+
+/**
+ * @brief Отрисовка каркаса модели в изображение
+ *
+ * Толщина ребер и размер вершин переводятся в пиксели так же, как в
+ * OpenGLWidget: толщина ребра задана в единицах модели (ортогональная
+ * проекция охватывает 4 единицы по высоте), размер вершины - в пикселях.
+ *
+ * @param vertices Вершины модели.
+ * @param edges Пары индексов вершин.
+ * @param mvp Произведение матриц проекции и модели.
+ * @param definition Стиль отрисовки.
+ * @param size Размер изображения в пикселях.
+ * @return Изображение в формате QImage::Format_RGB32 (пустое, если кадр
+ * слишком велик)
+ */
+QImage SoftwareRenderer::render(const std::vector<QVector3D> &vertices,
+                                const std::vector<unsigned int> &edges,
+                                const QMatrix4x4 &mvp,
+                                const ModelDefinition_t &definition,
+                                const QSize &size) {
+  width = std::max(1, size.width());
+  height = std::max(1, size.height());
+  tilesX = (width + kTileSize - 1) / kTileSize;
+  tilesY = (height + kTileSize - 1) / kTileSize;
+  lineWidth =
+      definition.facetWidth > 0
+          ? std::max(1.0f, definition.facetWidth * height / 4.0f)
+          : 1.0f;
+  pointSize = definition.verticeWidth;
+  verticeType = definition.verticeType;
+  facetColor = definition.facetColor.rgb();
+  verticeColor = definition.verticeColor.rgb();
+
+  QImage image(width, height, QImage::Format_RGB32);
+  if (image.isNull()) return image;  // кадр слишком велик
+  image.fill(definition.backgroundColor.rgb());
+  pixels = image.bits();
+  stride = image.bytesPerLine();
+  depth.assign(static_cast<size_t>(width) * height, 1.0f);
+
+  projectVertices(vertices, mvp);
+  setupSegments(edges);
+  size_t pointCount = verticeType == None ? 0 : vertices.size();
+  binPrimitives(edges.size() / 2, pointCount);
+  forRange(static_cast<size_t>(tilesX) * tilesY, 1,
+           [this](size_t begin, size_t end) {
+             for (size_t tile = begin; tile < end; ++tile)
+               rasterizeTile(static_cast<int>(tile));
+           });
+  pixels = nullptr;
+  return image;
+}
+
+/**
+ * @brief Проекция вершин в координаты отсечения и на экран
+ *
+ * Экранные координаты вершин за ближней плоскостью отсечения заменяются
+ * на NAN, такие вершины не рисуются.
+ *
+ * @param vertices Вершины модели.
+ * @param mvp Произведение матриц проекции и модели.
+ */
+void SoftwareRenderer::projectVertices(const std::vector<QVector3D> &vertices,
+                                       const QMatrix4x4 &mvp) {
+  clip.resize(vertices.size() * 4);
+  points.resize(vertices.size() * 3);
+  float halfWidth = width / 2.0f, halfHeight = height / 2.0f;
+  forRange(vertices.size(), 16384, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      QVector4D c = mvp * QVector4D(vertices[i], 1.0f);
+      float *out = &clip[4 * i];
+      out[0] = c.x();
+      out[1] = c.y();
+      out[2] = c.z();
+      out[3] = c.w();
+      float *point = &points[3 * i];
+      if (c.z() + c.w() < 0.0f || c.w() <= 0.0f) {
+        point[0] = point[1] = point[2] = NAN;
+        continue;
+      }
+      // строки QImage идут сверху вниз, а ось y OpenGL - снизу вверх
+      point[0] = (c.x() / c.w() + 1.0f) * halfWidth;
+      point[1] = (1.0f - c.y() / c.w()) * halfHeight;
+      point[2] = c.z() / c.w() * 0.5f + 0.5f;
+    }
+  });
+}
+
+/**
+ * @brief Отсечение ребер ближней плоскостью и перевод их на экран
+ *
+ * Ребро, целиком лежащее за ближней плоскостью, помечается NAN.
+ *
+ * @param edges Пары индексов вершин.
+ */
+void SoftwareRenderer::setupSegments(const std::vector<unsigned int> &edges) {
+  size_t edgeCount = edges.size() / 2;
+  segments.resize(edgeCount * 6);
+  float halfWidth = width / 2.0f, halfHeight = height / 2.0f;
+  forRange(edgeCount, 16384, [&](size_t begin, size_t end) {
+    for (size_t e = begin; e < end; ++e) {
+      float a[4], b[4];
+      std::copy_n(&clip[4 * edges[2 * e]], 4, a);
+      std::copy_n(&clip[4 * edges[2 * e + 1]], 4, b);
+      float *out = &segments[6 * e];
+      // расстояние до ближней плоскости z = -w
+      float da = a[2] + a[3], db = b[2] + b[3];
+      if (da < 0.0f && db < 0.0f) {
+        out[0] = NAN;
+        continue;
+      }
+      if (da < 0.0f || db < 0.0f) {
+        float *inside = da < 0.0f ? b : a;
+        float *outside = da < 0.0f ? a : b;
+        float dIn = da < 0.0f ? db : da, dOut = da < 0.0f ? da : db;
+        float t = dIn / (dIn - dOut);
+        for (int k = 0; k < 4; ++k)
+          outside[k] = inside[k] + (outside[k] - inside[k]) * t;
+      }
+      for (const float *c : {a, b}) {
+        out[0] = (c[0] / c[3] + 1.0f) * halfWidth;
+        out[1] = (1.0f - c[1] / c[3]) * halfHeight;
+        out[2] = c[2] / c[3] * 0.5f + 0.5f;
+        out += 3;
+      }
+    }
+  });
+}
+
+/**
+ * @brief Распределение примитивов по плиткам по их ограничивающим
+ * прямоугольникам
+ *
+ * Списки плиток хранятся подряд в bins, начало списка плитки - в
+ * binStart (последний элемент - общее число записей).
+ *
+ * @param count Число примитивов.
+ * @param tilesX Число плиток по горизонтали.
+ * @param tilesY Число плиток по вертикали.
+ * @param bounds Функция (индекс, прямоугольник minX, minY, maxX, maxY),
+ * возвращающая false для примитивов, которые не рисуются.
+ * @param binStart Начала списков плиток.
+ * @param bins Индексы примитивов, сгруппированные по плиткам.
+ */
+template <typename Bounds>
+static void binByBounds(size_t count, int tilesX, int tilesY, Bounds bounds,
+                        std::vector<unsigned int> &binStart,
+                        std::vector<unsigned int> &bins) {
+  const int tile = SoftwareRenderer::kTileSize;
+  float limitX = static_cast<float>(tilesX * tile - 1);
+  float limitY = static_cast<float>(tilesY * tile - 1);
+  auto tileRange = [&](size_t i, int range[4]) {
+    float box[4];
+    if (!bounds(i, box)) return false;
+    if (!(box[2] >= 0.0f && box[3] >= 0.0f && box[0] <= limitX &&
+          box[1] <= limitY))
+      return false;
+    range[0] = static_cast<int>(std::max(box[0], 0.0f)) / tile;
+    range[1] = static_cast<int>(std::max(box[1], 0.0f)) / tile;
+    range[2] = static_cast<int>(std::min(box[2], limitX)) / tile;
+    range[3] = static_cast<int>(std::min(box[3], limitY)) / tile;
+    return true;
+  };
+  binStart.assign(static_cast<size_t>(tilesX) * tilesY + 1, 0);
+  int range[4];
+  for (size_t i = 0; i < count; ++i) {
+    if (!tileRange(i, range)) continue;
+    for (int y = range[1]; y <= range[3]; ++y)
+      for (int x = range[0]; x <= range[2]; ++x) ++binStart[y * tilesX + x + 1];
+  }
+  for (size_t t = 1; t < binStart.size(); ++t) binStart[t] += binStart[t - 1];
+  bins.resize(binStart.back());
+  std::vector<unsigned int> fill(binStart.begin(), binStart.end() - 1);
+  for (size_t i = 0; i < count; ++i) {
+    if (!tileRange(i, range)) continue;
+    for (int y = range[1]; y <= range[3]; ++y)
+      for (int x = range[0]; x <= range[2]; ++x)
+        bins[fill[y * tilesX + x]++] = static_cast<unsigned int>(i);
+  }
+}
+
+/**
+ * @brief Распределение ребер и вершин по плиткам экрана
+ *
+ * @param edgeCount Число ребер.
+ * @param pointCount Число рисуемых вершин (0 - вершины не рисуются).
+ */
+void SoftwareRenderer::binPrimitives(size_t edgeCount, size_t pointCount) {
+  float lineExtent = lineWidth / 2.0f + 1.0f;
+  binByBounds(
+      edgeCount, tilesX, tilesY,
+      [&](size_t e, float box[4]) {
+        const float *s = &segments[6 * e];
+        if (std::isnan(s[0])) return false;
+        box[0] = std::min(s[0], s[3]) - lineExtent;
+        box[1] = std::min(s[1], s[4]) - lineExtent;
+        box[2] = std::max(s[0], s[3]) + lineExtent;
+        box[3] = std::max(s[1], s[4]) + lineExtent;
+        return true;
+      },
+      edgeBinStart, edgeBins);
+  float pointExtent = pointSize / 2.0f + 1.0f;
+  binByBounds(
+      pointCount, tilesX, tilesY,
+      [&](size_t i, float box[4]) {
+        const float *p = &points[3 * i];
+        if (std::isnan(p[0])) return false;
+        box[0] = p[0] - pointExtent;
+        box[1] = p[1] - pointExtent;
+        box[2] = p[0] + pointExtent;
+        box[3] = p[1] + pointExtent;
+        return true;
+      },
+      pointBinStart, pointBins);
+}
+
+/**
+ * @brief Растеризация одной плитки: сначала ребра, затем вершины
+ *
+ * @param tile Номер плитки (по строкам).
+ */
+void SoftwareRenderer::rasterizeTile(int tile) {
+  int x = (tile % tilesX) * kTileSize, y = (tile / tilesX) * kTileSize;
+  QRect rect(x, y, std::min(kTileSize, width - x),
+             std::min(kTileSize, height - y));
+  for (unsigned int i = edgeBinStart[tile]; i < edgeBinStart[tile + 1]; ++i)
+    drawSegment(&segments[6 * edgeBins[i]], rect);
+  for (unsigned int i = pointBinStart[tile]; i < pointBinStart[tile + 1]; ++i)
+    drawPoint(&points[3 * pointBins[i]], rect);
+}
+
+/**
+ * @brief Запись пикселя с проверкой глубины (как GL_LESS)
+ */
+void SoftwareRenderer::plot(int x, int y, float z, QRgb color) {
+  float &stored = depth[static_cast<size_t>(y) * width + x];
+  if (!(z < stored)) return;
+  stored = z;
+  reinterpret_cast<QRgb *>(pixels + y * stride)[x] = color;
+}
+
+/**
+ * @brief Растеризация ребра в пределах плитки
+ *
+ * Ребро проходится по главной оси: закрашиваются пиксели, центры которых
+ * лежат в полуинтервале от начала до конца ребра, а по второй оси
+ * рисуется столбец пикселей толщиной lineWidth, как у широких линий
+ * OpenGL без сглаживания.
+ *
+ * @param segment Концы ребра на экране (x0, y0, z0, x1, y1, z1).
+ * @param rect Область плитки.
+ */
+void SoftwareRenderer::drawSegment(const float *segment, const QRect &rect) {
+  if (antialiasing) {
+    drawSmoothSegment(segment, rect);
+    return;
+  }
+  int thickness = std::max(1, static_cast<int>(std::lround(lineWidth)));
+  int below = (thickness - 1) / 2;
+  bool xMajor = std::fabs(segment[3] - segment[0]) >=
+                std::fabs(segment[4] - segment[1]);
+  // главная ось u, вторая ось v
+  int axis = xMajor ? 0 : 1;
+  float u0 = segment[axis], v0 = segment[1 - axis], z0 = segment[2];
+  float u1 = segment[3 + axis], v1 = segment[4 - axis], z1 = segment[5];
+  float du = u1 - u0;
+  if (du == 0.0f) return;
+  int uMin = xMajor ? rect.left() : rect.top();
+  int uEnd = xMajor ? rect.right() + 1 : rect.bottom() + 1;
+  int vMin = xMajor ? rect.top() : rect.left();
+  int vEnd = xMajor ? rect.bottom() + 1 : rect.right() + 1;
+  float from = std::max(std::min(u0, u1) - 0.5f, static_cast<float>(uMin));
+  float to = std::min(std::max(u0, u1) - 0.5f, static_cast<float>(uEnd));
+  int first = static_cast<int>(std::ceil(from));
+  int last = static_cast<int>(std::ceil(to)) - 1;
+  for (int u = first; u <= last; ++u) {
+    float t = (u + 0.5f - u0) / du;
+    float v = v0 + (v1 - v0) * t;
+    if (v < vMin - thickness || v > vEnd + thickness) continue;
+    float z = z0 + (z1 - z0) * t;
+    int vFirst = std::max(vMin, static_cast<int>(std::floor(v)) - below);
+    int vLast = std::min(vEnd - 1, static_cast<int>(std::floor(v)) - below +
+                                       thickness - 1);
+    for (int w = vFirst; w <= vLast; ++w) {
+      if (xMajor)
+        plot(u, w, z, facetColor);
+      else
+        plot(w, u, z, facetColor);
+    }
+  }
+}
+
+/**
+ * @brief Параметры шагов линии по главной оси
+ */
+typedef struct LineSteps {
+  float u0, v0, z0;   // начало ребра
+  float dvdu, dzdu;   // приращения на единицу главной оси
+  float half;         // половина толщины линии
+  float vLow, vHigh;  // пределы второй оси (за ними плитки нет)
+  float uLow, uHigh;  // концы ребра по главной оси
+} LineSteps_t;
+
+/**
+ * @brief Блок из 8 рассчитанных шагов линии
+ */
+typedef struct LineSpan {
+  float depth[8];       // глубина в центре шага
+  int rowFirst[8];      // первая строка (столбец), задетая линией
+  int rowLast[8];       // последняя строка (столбец), задетая линией
+  float coverFirst[8];  // покрытие первой строки
+  float coverLast[8];   // покрытие последней строки
+  float coverInner[8];  // покрытие внутренних строк
+} LineSpan_t;
+
+/**
+ * @brief Буферы кадра, в которые смешиваются пиксели ребра
+ */
+typedef struct BlendTarget {
+  float *depth;      // буфер глубины
+  uchar *pixels;     // пиксели кадра
+  qsizetype stride;  // длина строки кадра в байтах
+  int width;         // ширина кадра
+  QRgb color;        // цвет ребер
+} BlendTarget_t;
+
+/**
+ * @brief Расчет 8 шагов сглаженной линии начиная с first (скалярно)
+ *
+ * Для каждого шага линия занимает по второй оси отрезок толщиной
+ * 2 * half с центром в v; покрытие крайних строк равно длине их
+ * пересечения с этим отрезком. Вдоль главной оси покрытие равно длине
+ * пересечения столбца с ребром, поэтому концы ребра сглаживаются, как в
+ * алгоритме Ву.
+ */
+static void lineStepsScalar(const LineSteps_t &line, int first,
+                            LineSpan_t &span) {
+  for (int lane = 0; lane < 8; ++lane) {
+    float u = static_cast<float>(first + lane);
+    float t = u + 0.5f - line.u0;
+    float v = line.v0 + line.dvdu * t;
+    v = std::min(std::max(v, line.vLow), line.vHigh);
+    float top = v - line.half, bottom = v + line.half;
+    float rowFirst = std::floor(top), rowLast = std::ceil(bottom) - 1.0f;
+    float along = std::min(u + 1.0f, line.uHigh) - std::max(u, line.uLow);
+    span.depth[lane] = line.z0 + line.dzdu * t;
+    span.rowFirst[lane] = static_cast<int>(rowFirst);
+    span.rowLast[lane] = static_cast<int>(rowLast);
+    span.coverFirst[lane] = (std::min(rowFirst + 1.0f, bottom) - top) * along;
+    span.coverLast[lane] = (bottom - std::max(rowLast, top)) * along;
+    span.coverInner[lane] = along;
+  }
+}
+
+/**
+ * @brief Смешивание блока шагов линии с кадром (скалярно)
+ *
+ * Глубина записывается, только если ребро покрывает не меньше половины
+ * пикселя, чтобы края линий не закрывали более далекие ребра.
+ *
+ * @param block Первый шаг блока по главной оси.
+ * @param lanes Число используемых шагов блока.
+ * @param vMin, vEnd Пределы плитки по второй оси.
+ */
+static void blendSpanScalar(const LineSpan_t &span, int block, int lanes,
+                            bool xMajor, int vMin, int vEnd,
+                            const BlendTarget_t &target) {
+  for (int lane = 0; lane < lanes; ++lane) {
+    int u = block + lane;
+    int rowFirst = span.rowFirst[lane], rowLast = span.rowLast[lane];
+    for (int row = std::max(rowFirst, vMin);
+         row <= std::min(rowLast, vEnd - 1); ++row) {
+      float coverage = row == rowFirst  ? span.coverFirst[lane]
+                       : row == rowLast ? span.coverLast[lane]
+                                        : span.coverInner[lane];
+      int x = xMajor ? u : row, y = xMajor ? row : u;
+      float &stored = target.depth[static_cast<size_t>(y) * target.width + x];
+      float z = span.depth[lane];
+      if (!(z < stored) || coverage <= 0.0f) continue;
+      if (coverage >= 0.5f) stored = z;
+      QRgb &pixel =
+          reinterpret_cast<QRgb *>(target.pixels + y * target.stride)[x];
+      auto mix = [coverage](int from, int to) {
+        return static_cast<int>(from + (to - from) * coverage + 0.5f);
+      };
+      pixel = qRgb(mix(qRed(pixel), qRed(target.color)),
+                   mix(qGreen(pixel), qGreen(target.color)),
+                   mix(qBlue(pixel), qBlue(target.color)));
+    }
+  }
+}
 
+#if defined(__x86_64__) && defined(__GNUC__)
 /**
- * @brief Деструктор OpenGL-виджета.
+ * @brief Расчет 8 шагов сглаженной линии командами AVX2
  *
- * Освобождает память, выделенную под объект `draw_`, если он был создан.
+ * Результат совпадает с lineStepsScalar: операции те же и выполняются в
+ * том же порядке.
  */
-OpenGLWidget::~OpenGLWidget() {
-  if (draw_) {
-    delete draw_;
+__attribute__((target("avx2"))) static void lineStepsAvx2(
+    const LineSteps_t &line, int first, LineSpan_t &span) {
+  __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+  __m256 u = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(first)), lane);
+  __m256 t = _mm256_sub_ps(_mm256_add_ps(u, _mm256_set1_ps(0.5f)),
+                           _mm256_set1_ps(line.u0));
+  __m256 v = _mm256_add_ps(_mm256_set1_ps(line.v0),
+                           _mm256_mul_ps(_mm256_set1_ps(line.dvdu), t));
+  v = _mm256_min_ps(_mm256_max_ps(v, _mm256_set1_ps(line.vLow)),
+                    _mm256_set1_ps(line.vHigh));
+  __m256 half = _mm256_set1_ps(line.half);
+  __m256 one = _mm256_set1_ps(1.0f);
+  __m256 top = _mm256_sub_ps(v, half), bottom = _mm256_add_ps(v, half);
+  __m256 rowFirst = _mm256_floor_ps(top);
+  __m256 rowLast = _mm256_sub_ps(_mm256_ceil_ps(bottom), one);
+  __m256 along = _mm256_sub_ps(
+      _mm256_min_ps(_mm256_add_ps(u, one), _mm256_set1_ps(line.uHigh)),
+      _mm256_max_ps(u, _mm256_set1_ps(line.uLow)));
+  __m256 depth = _mm256_add_ps(_mm256_set1_ps(line.z0),
+                               _mm256_mul_ps(_mm256_set1_ps(line.dzdu), t));
+  _mm256_storeu_ps(span.depth, depth);
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(span.rowFirst),
+                      _mm256_cvttps_epi32(rowFirst));
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(span.rowLast),
+                      _mm256_cvttps_epi32(rowLast));
+  _mm256_storeu_ps(
+      span.coverFirst,
+      _mm256_mul_ps(
+          _mm256_sub_ps(_mm256_min_ps(_mm256_add_ps(rowFirst, one), bottom),
+                        top),
+          along));
+  _mm256_storeu_ps(
+      span.coverLast,
+      _mm256_mul_ps(_mm256_sub_ps(bottom, _mm256_max_ps(rowLast, top)), along));
+  _mm256_storeu_ps(span.coverInner, along);
+}
+
+/**
+ * @brief Смешивание блока шагов линии с кадром командами AVX2
+ *
+ * За проход обрабатывается одна строка всех 8 шагов: глубина и цвета
+ * пикселей собираются командами gather, проверка глубины и смешивание
+ * каналов выполняются над всем блоком, прошедшие проверку пиксели
+ * записываются по маске. Результат совпадает с blendSpanScalar.
+ */
+__attribute__((target("avx2"))) static void blendSpanAvx2(
+    const LineSpan_t &span, int block, int lanes, bool xMajor, int vMin,
+    int vEnd, const BlendTarget_t &target) {
+  __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  __m256i active = _mm256_cmpgt_epi32(_mm256_set1_epi32(lanes), laneIndex);
+  __m256i rowFirst =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(span.rowFirst));
+  __m256i rowLast =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(span.rowLast));
+  __m256i u = _mm256_add_epi32(_mm256_set1_epi32(block), laneIndex);
+  __m256i low = _mm256_set1_epi32(vMin - 1), high = _mm256_set1_epi32(vEnd);
+  __m256i depthStride = _mm256_set1_epi32(target.width);
+  __m256i pixelStride =
+      _mm256_set1_epi32(static_cast<int>(target.stride / sizeof(QRgb)));
+  __m256 depth = _mm256_loadu_ps(span.depth);
+  __m256 coverFirst = _mm256_loadu_ps(span.coverFirst);
+  __m256 coverLast = _mm256_loadu_ps(span.coverLast);
+  __m256 coverInner = _mm256_loadu_ps(span.coverInner);
+  __m256 zero = _mm256_setzero_ps(), half = _mm256_set1_ps(0.5f);
+  __m256i channel = _mm256_set1_epi32(0xff);
+  __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xff000000u));
+  int rows = 0;
+  for (int lane = 0; lane < lanes; ++lane)
+    rows = std::max(rows, span.rowLast[lane] - span.rowFirst[lane] + 1);
+  QRgb *pixels = reinterpret_cast<QRgb *>(target.pixels);
+  alignas(32) int depthIndices[8], pixelIndices[8], colors[8];
+  alignas(32) float coverages[8];
+  for (int r = 0; r < rows; ++r) {
+    __m256i row = _mm256_add_epi32(rowFirst, _mm256_set1_epi32(r));
+    __m256i inside =
+        _mm256_and_si256(_mm256_cmpgt_epi32(row, low),
+                         _mm256_cmpgt_epi32(high, row));
+    __m256i valid = _mm256_and_si256(
+        _mm256_andnot_si256(_mm256_cmpgt_epi32(row, rowLast), inside),
+        active);
+    if (_mm256_testz_si256(valid, valid)) continue;
+    __m256 coverage =
+        r == 0 ? coverFirst
+               : _mm256_blendv_ps(
+                     coverInner, coverLast,
+                     _mm256_castsi256_ps(_mm256_cmpeq_epi32(row, rowLast)));
+    __m256i x = xMajor ? u : row, y = xMajor ? row : u;
+    __m256i depthIndex =
+        _mm256_add_epi32(_mm256_mullo_epi32(y, depthStride), x);
+    __m256 stored = _mm256_mask_i32gather_ps(zero, target.depth, depthIndex,
+                                             _mm256_castsi256_ps(valid), 4);
+    __m256 pass = _mm256_and_ps(
+        _mm256_and_ps(_mm256_cmp_ps(depth, stored, _CMP_LT_OQ),
+                      _mm256_cmp_ps(coverage, zero, _CMP_GT_OQ)),
+        _mm256_castsi256_ps(valid));
+    int mask = _mm256_movemask_ps(pass);
+    if (mask == 0) continue;
+    __m256i pixelIndex =
+        _mm256_add_epi32(_mm256_mullo_epi32(y, pixelStride), x);
+    __m256i pixel = _mm256_mask_i32gather_epi32(
+        _mm256_setzero_si256(), reinterpret_cast<const int *>(pixels),
+        pixelIndex, _mm256_castps_si256(pass), 4);
+    __m256i mixed = alpha;
+    for (int shift = 0; shift <= 16; shift += 8) {
+      __m128i count = _mm_cvtsi32_si128(shift);
+      __m256i from = _mm256_and_si256(_mm256_srl_epi32(pixel, count), channel);
+      __m256i to = _mm256_set1_epi32((target.color >> shift) & 0xff);
+      __m256 value = _mm256_add_ps(
+          _mm256_add_ps(
+              _mm256_cvtepi32_ps(from),
+              _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(to, from)),
+                            coverage)),
+          half);
+      mixed = _mm256_or_si256(
+          mixed, _mm256_sll_epi32(_mm256_cvttps_epi32(value), count));
+    }
+    _mm256_store_si256(reinterpret_cast<__m256i *>(depthIndices), depthIndex);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(pixelIndices), pixelIndex);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(colors), mixed);
+    _mm256_store_ps(coverages, coverage);
+    for (; mask != 0; mask &= mask - 1) {
+      int lane = __builtin_ctz(mask);
+      if (coverages[lane] >= 0.5f)
+        target.depth[depthIndices[lane]] = span.depth[lane];
+      pixels[pixelIndices[lane]] = static_cast<QRgb>(colors[lane]);
+    }
   }
 }
+#endif
 
 /**
- * @brief Инициализация OpenGL, настройка функций и включение глубинного теста.
+ * @brief Растеризация сглаженного ребра в пределах плитки
  *
- * Настроены параметры, необходимые для работы OpenGL, такие как глубинный тест
- * и цвет фона.
+ * Ребро обрабатывается блоками по 8 шагов главной оси. Расчет шагов,
+ * проверка глубины и смешивание пикселей выполняются командами AVX2,
+ * если они доступны и разрешены. Толщина линии не округляется до целых
+ * пикселей, а крайние столбцы покрываются пропорционально длине ребра в
+ * них.
+ *
+ * @param segment Концы ребра на экране (x0, y0, z0, x1, y1, z1).
+ * @param rect Область плитки.
  */
-void OpenGLWidget::initializeGL() {
+void SoftwareRenderer::drawSmoothSegment(const float *segment,
+                                         const QRect &rect) {
+  bool xMajor = std::fabs(segment[3] - segment[0]) >=
+                std::fabs(segment[4] - segment[1]);
+  int axis = xMajor ? 0 : 1;
+  float u0 = segment[axis], u1 = segment[3 + axis];
+  float du = u1 - u0;
+  if (du == 0.0f) return;
+  int uMin = xMajor ? rect.left() : rect.top();
+  int uEnd = xMajor ? rect.right() + 1 : rect.bottom() + 1;
+  int vMin = xMajor ? rect.top() : rect.left();
+  int vEnd = xMajor ? rect.bottom() + 1 : rect.right() + 1;
+  LineSteps_t line;
+  line.u0 = u0;
+  line.v0 = segment[1 - axis];
+  line.z0 = segment[2];
+  line.dvdu = (segment[4 - axis] - line.v0) / du;
+  line.dzdu = (segment[5] - line.z0) / du;
+  line.half = std::max(lineWidth, 1.0f) / 2.0f;
+  // за пределами плитки значение не важно, ограничение исключает
+  // переполнение при переводе в целое
+  line.vLow = vMin - line.half - 1.0f;
+  line.vHigh = vEnd + line.half + 1.0f;
+  line.uLow = std::min(u0, u1);
+  line.uHigh = std::max(u0, u1);
+  // столбцы, пересекающиеся с ребром по главной оси
+  float from = std::max(line.uLow, static_cast<float>(uMin));
+  float to = std::min(line.uHigh, static_cast<float>(uEnd));
+  int first = static_cast<int>(std::floor(from));
+  int last = static_cast<int>(std::ceil(to)) - 1;
+  BlendTarget_t target = {depth.data(), pixels, stride, width, facetColor};
+  bool useAvx2 = vectorized && hasAvx2();
+  LineSpan_t span;
+  for (int block = first; block <= last; block += 8) {
+    int lanes = std::min(8, last - block + 1);
+#if defined(__x86_64__) && defined(__GNUC__)
+    if (useAvx2) {
+      lineStepsAvx2(line, block, span);
+      blendSpanAvx2(span, block, lanes, xMajor, vMin, vEnd, target);
+      continue;
+    }
+#else
+    (void)useAvx2;
+#endif
+    lineStepsScalar(line, block, span);
+    blendSpanScalar(span, block, lanes, xMajor, vMin, vEnd, target);
+  }
+}
+
+/**
+ * @brief Растеризация маркера вершины в пределах плитки
+ *
+ * Квадрат закрашивает пиксели, центры которых попадают в квадрат со
+ * стороной pointSize, круг - в круг того же диаметра.
+ *
+ * @param point Вершина на экране (x, y, z).
+ * @param rect Область плитки.
+ */
+void SoftwareRenderer::drawPoint(const float *point, const QRect &rect) {
+  float half = pointSize / 2.0f;
+  int left = std::max(rect.left(),
+                      static_cast<int>(std::ceil(point[0] - half - 0.5f)));
+  int right = std::min(rect.right(),
+                       static_cast<int>(std::ceil(point[0] + half - 0.5f)) - 1);
+  int top = std::max(rect.top(),
+                     static_cast<int>(std::ceil(point[1] - half - 0.5f)));
+  int bottom = std::min(
+      rect.bottom(), static_cast<int>(std::ceil(point[1] + half - 0.5f)) - 1);
+  for (int y = top; y <= bottom; ++y) {
+    for (int x = left; x <= right; ++x) {
+      if (verticeType == Circle) {
+        float dx = x + 0.5f - point[0], dy = y + 0.5f - point[1];
+        if (dx * dx + dy * dy > half * half) continue;
+      }
+      plot(x, y, point[2], verticeColor);
+    }
+  }
+}
+
+/**
+ * @brief Конструктор внеэкранного отрисовщика.
+ *
+ * Контекст OpenGL создается при первом вызове render.
+ *
+ * @param controller Контроллер, из модели которого берутся вершины и ребра.
+ */
+OffscreenRenderer::OffscreenRenderer(ViewerController *controller)
+    : controller_(controller) {}
+
+/**
+ * @brief Деструктор: освобождение буферов в собственном контексте.
+ */
+OffscreenRenderer::~OffscreenRenderer() {
+  if (!contextReady) return;
+  context.makeCurrent(&surface);
+  retained.destroy();
+  target.reset();
+  context.doneCurrent();
+}
+
+/**
+ * @brief Создание контекста OpenGL на внеэкранной поверхности.
+ *
+ * @return false, если OpenGL недоступен (нет дисплея или драйвера).
+ */
+bool OffscreenRenderer::initialize() {
+  if (contextReady) return true;
+  if (contextFailed) return false;
+  surface.setFormat(QSurfaceFormat::defaultFormat());
+  surface.create();
+  context.setFormat(QSurfaceFormat::defaultFormat());
+  if (!surface.isValid() || !context.create() ||
+      !context.makeCurrent(&surface)) {
+    qWarning() << "Offscreen OpenGL is unavailable, using SoftwareRenderer";
+    contextFailed = true;
+    return false;
+  }
   initializeOpenGLFunctions();
+  if (!QOpenGLFramebufferObject::hasOpenGLFramebufferObjects()) {
+    qWarning() << "Framebuffer objects are unavailable, using "
+                  "SoftwareRenderer";
+    context.doneCurrent();
+    contextFailed = true;
+    return false;
+  }
+  if (!retained.initialize())
+    qWarning() << "Vertex buffers are unavailable, using immediate mode";
+  context.doneCurrent();
+  contextReady = true;
+  return true;
+}
+
+/**
+ * @brief Отрисовка модели в изображение без окна.
+ *
+ * Если OpenGL недоступен, а также для толстых ребер без шейдера (кэш
+ * четырехугольников строится по стилю модели, а не по style), кадр
+ * рисуется программным растеризатором.
+ *
+ * @param camera Аффинные преобразования и тип проекции.
+ * @param style Стиль отрисовки.
+ * @param size Размер изображения в пикселях.
+ * @return Изображение в формате QImage::Format_RGB32 (пустое, если кадр
+ * слишком велик).
+ */
+QImage OffscreenRenderer::render(const AffineTransform_t &camera,
+                                 const ModelDefinition_t &style,
+                                 const QSize &size) {
+  QSize imageSize(std::max(1, size.width()), std::max(1, size.height()));
+  return renderRegion(camera, style, imageSize, QRect(QPoint(), imageSize),
+                      imageSize.height());
+}
+
+/**
+ * @brief Матрица проекции части кадра.
+ *
+ * Матрица проекции полного кадра умножается на матрицу, растягивающую
+ * область region на весь буфер (подпирамида видимости).
+ *
+ * @param camera Аффинные преобразования и тип проекции.
+ * @param fullSize Размер полного кадра в пикселях.
+ * @param region Область кадра.
+ */
+QMatrix4x4 OffscreenRenderer::regionProjection(const AffineTransform_t &camera,
+                                               const QSize &fullSize,
+                                               const QRect &region) {
+  float aspectRatio = static_cast<float>(fullSize.width()) /
+                      static_cast<float>(fullSize.height());
+  float scaleX = static_cast<float>(fullSize.width()) / region.width();
+  float scaleY = static_cast<float>(fullSize.height()) / region.height();
+  // центр области в NDC; ось y NDC направлена вверх, строки кадра - вниз
+  float centerX =
+      (region.x() + region.width() / 2.0f) / fullSize.width() * 2.0f - 1.0f;
+  float centerY =
+      1.0f - (region.y() + region.height() / 2.0f) / fullSize.height() * 2.0f;
+  QMatrix4x4 projection;
+  projection.scale(scaleX, scaleY, 1.0f);
+  projection.translate(-centerX, -centerY, 0.0f);
+  projection *= ViewerModel::projectionMatrixFor(camera, aspectRatio);
+  return projection;
+}
+
+/**
+ * @brief Стиль отрисовки части кадра.
+ *
+ * Толщина ребер задана относительно высоты буфера, поэтому она
+ * увеличивается во столько же раз, во сколько кадр выше области. Размер
+ * вершин задан в пикселях окна высотой viewHeight и увеличивается во
+ * столько же раз, во сколько кадр выше окна, так что вершины и ребра
+ * остаются в тех же пропорциях, что и на экране.
+ *
+ * @param style Стиль отрисовки.
+ * @param fullSize Размер полного кадра в пикселях.
+ * @param region Область кадра.
+ * @param viewHeight Высота окна, для которого подобран стиль.
+ */
+ModelDefinition_t OffscreenRenderer::regionStyle(const ModelDefinition_t &style,
+                                                 const QSize &fullSize,
+                                                 const QRect &region,
+                                                 int viewHeight) {
+  ModelDefinition_t result = style;
+  result.facetWidth *= static_cast<float>(fullSize.height()) / region.height();
+  result.verticeWidth *=
+      static_cast<float>(fullSize.height()) / std::max(1, viewHeight);
+  return result;
+}
+
+/**
+ * @brief Отрисовка части кадра большого размера.
+ *
+ * Область рисуется в собственный буфер с подпирамидой видимости и
+ * стилем regionStyle, поэтому склеенные области дают тот же кадр, что и
+ * отрисовка целиком.
+ *
+ * @param camera Аффинные преобразования и тип проекции.
+ * @param style Стиль отрисовки.
+ * @param fullSize Размер полного кадра в пикселях.
+ * @param region Область кадра, которую нужно нарисовать.
+ * @param viewHeight Высота окна, для которого подобран размер вершин.
+ * @return Изображение области в формате QImage::Format_RGB32 (пустое,
+ * если область слишком велика).
+ */
+QImage OffscreenRenderer::renderRegion(const AffineTransform_t &camera,
+                                       const ModelDefinition_t &style,
+                                       const QSize &fullSize,
+                                       const QRect &region, int viewHeight) {
+  QSize imageSize = region.size();
+  QMatrix4x4 projection = regionProjection(camera, fullSize, region);
+  QMatrix4x4 model = ViewerModel::modelMatrixFor(camera);
+  QMatrix4x4 mvp = projection * model;
+  ModelDefinition_t tileStyle =
+      regionStyle(style, fullSize, region, viewHeight);
+
+  const std::vector<QVector3D> &vertices = controller_->modelGetVertices();
+  const std::vector<unsigned int> &edges = controller_->modelGetEdges();
+  bool hardware = initialize();
+  bool thickFallback = style.facetWidth > 0 && !retained.hasThickLines();
+  lastHardware = hardware && !thickFallback;
+  if (!lastHardware)
+    return software.render(vertices, edges, mvp, tileStyle, imageSize);
+
+  context.makeCurrent(&surface);
+  if (!target || target->size() != imageSize)
+    target = std::make_unique<QOpenGLFramebufferObject>(
+        imageSize, QOpenGLFramebufferObject::Depth);
+  if (!target->isValid()) {  // буфер больше допустимого драйвером
+    target.reset();
+    context.doneCurrent();
+    return QImage();
+  }
+  target->bind();
+  glViewport(0, 0, imageSize.width(), imageSize.height());
   glEnable(GL_DEPTH_TEST);
-  glClearColor(0.1f, 0.1f, 0.5f, 1.0f);
+  glClearColor(style.backgroundColor.redF(), style.backgroundColor.greenF(),
+               style.backgroundColor.blueF(), 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  glMatrixMode(GL_PROJECTION);
+  glLoadMatrixf(projection.constData());
+  glMatrixMode(GL_MODELVIEW);
+  glLoadMatrixf(model.constData());
+
+  retained.upload(vertices, edges, controller_->modelGetMeshGeneration());
+  ranges.resize(1);
+  ranges[0].firstEdge = 0;
+  ranges[0].edgeCount = static_cast<unsigned int>(edges.size() / 2);
+  RenderFrame_t frame;
+  frame.facets = &controller_->modelGetFacets();
+  frame.vertices = &vertices;
+  frame.modelDefinition = &tileStyle;
+  frame.controller = controller_;
+  frame.retained = retained.isValid() ? &retained : nullptr;
+  frame.edgeRanges = &ranges;
+  frame.lodEdges = &noEdges;
+  frame.mvp = mvp;
+  frame.viewport = QSizeF(imageSize);
+  makeStyledPass(tileStyle, frame.retained)->draw(frame);
+  glFinish();
+  QImage image = target->toImage().convertToFormat(QImage::Format_RGB32);
+  target->release();
+  context.doneCurrent();
+  return image;
 }
 
 /**
- * @brief Настройка области просмотра для OpenGL.
+ * @brief Подготовка записи кадра произвольного размера в BMP для
+ * выполнения в другом потоке
  *
- * Изменяет область отображения в соответствии с размером окна. Вызывается при
- * изменении размера окна.
+ * Сетка, преобразования и стиль копируются при вызове, как и для ролика.
  *
- * @param w Ширина нового окна.
- * @param h Высота нового окна.
+ * @param controller Контроллер, из модели которого берется сетка и стиль.
+ * @param filePath Путь к файлу BMP.
+ * @param size Размер кадра в пикселях.
+ * @param viewHeight Высота окна, для которого подобран размер вершин.
+ * @return Функция записи; возвращает false, если файл не удалось записать.
+ */
+std::function<bool()> OffscreenRenderer::tiledExport(
+    ViewerController *controller, const QString &filePath, const QSize &size,
+    int viewHeight) {
+  return [filePath, size, viewHeight,
+          vertices = controller->modelGetVertices(),
+          edges = controller->modelGetEdges(),
+          transform = controller->modelGetAffineTransform(),
+          definition = controller->modelGetModelDefinition()]() {
+    return writeTiled(filePath, size, vertices, edges, transform, definition,
+                      viewHeight);
+  };
+}
+
+/**
+ * @brief Отрисовка кадра по частям и запись в BMP по полосам
+ *
+ * Высота полосы выбирается так, чтобы полоса занимала не больше
+ * kExportBandBytes, но не больше kExportTile строк; полоса рисуется
+ * плитками не шире kExportTile и сразу дописывается в файл. Каждая
+ * плитка рисуется с полем в половину маркера вершины или толщины ребра и
+ * обрезается, поэтому маркеры и ребра у швов не обрезаются подпирамидой.
+ *
+ * @param filePath Путь к файлу BMP.
+ * @param size Размер кадра в пикселях.
+ * @param vertices, edges Сетка модели.
+ * @param transform Аффинные преобразования и тип проекции.
+ * @param definition Стиль отрисовки.
+ * @param viewHeight Высота окна, для которого подобран размер вершин.
+ * @return false, если кадр не удалось нарисовать или записать.
+ */
+bool OffscreenRenderer::writeTiled(const QString &filePath, const QSize &size,
+                                   const std::vector<QVector3D> &vertices,
+                                   const std::vector<unsigned int> &edges,
+                                   const AffineTransform_t &transform,
+                                   const ModelDefinition_t &definition,
+                                   int viewHeight) {
+  BmpStreamWriter writer;
+  if (size.isEmpty() || !writer.open(filePath, size)) return false;
+  QRect frame(QPoint(), size);
+  ModelDefinition_t frameStyle =
+      regionStyle(definition, size, frame, viewHeight);
+  float lineWidth = frameStyle.facetWidth * size.height() / 4.0f;
+  int margin = static_cast<int>(std::ceil(
+                   std::max(frameStyle.verticeWidth, lineWidth) / 2.0f)) +
+               1;
+  int bandRows = static_cast<int>(std::clamp<qsizetype>(
+      kExportBandBytes / (qsizetype(size.width()) * 4), 1, kExportTile));
+  QMatrix4x4 model = ViewerModel::modelMatrixFor(transform);
+  SoftwareRenderer renderer;
+  for (int y = 0; y < size.height(); y += bandRows) {
+    int bandHeight = std::min(bandRows, size.height() - y);
+    QImage band(size.width(), bandHeight, QImage::Format_RGB32);
+    if (band.isNull()) return false;
+    for (int x = 0; x < size.width(); x += kExportTile) {
+      QRect region(x, y, std::min(kExportTile, size.width() - x), bandHeight);
+      // за краем кадра поле не нужно: там маркеры обрезаются и целиком
+      QRect expanded =
+          region.adjusted(-margin, -margin, margin, margin).intersected(frame);
+      QImage tile = renderer.render(
+          vertices, edges,
+          regionProjection(transform, size, expanded) * model,
+          regionStyle(definition, size, expanded, viewHeight),
+          expanded.size());
+      if (tile.isNull()) return false;
+      QPoint offset = region.topLeft() - expanded.topLeft();
+      for (int row = 0; row < bandHeight; ++row)
+        std::copy_n(reinterpret_cast<const QRgb *>(
+                        tile.constScanLine(offset.y() + row)) +
+                        offset.x(),
+                    region.width(),
+                    reinterpret_cast<QRgb *>(band.scanLine(row)) + x);
+    }
+    if (!writer.writeRows(band)) return false;
+  }
+  return writer.close();
+}
+
+/**
+ * @brief Был ли последний кадр нарисован через OpenGL.
+ */
+bool OffscreenRenderer::lastFrameHardware() const { return lastHardware; }
+
+/**
+ * @brief Подготовка записи ролика с полным оборотом модели для выполнения
+ * в другом потоке
+ *
+ * Сетка, преобразования и стиль копируются при вызове, поэтому модель
+ * можно менять и загружать заново, пока ролик записывается.
+ *
+ * @param controller Контроллер, из модели которого берется сетка и стиль.
+ * @param filePath Путь к файлу GIF.
+ * @param settings Число кадров, ось, размер и частота кадров.
+ * @return Функция записи; возвращает false, если файл не удалось записать.
  */
-void OpenGLWidget::resizeGL(int w, int h) { glViewport(0, 0, w, h); }
+std::function<bool()> OffscreenRenderer::turntableExport(
+    ViewerController *controller, const QString &filePath,
+    const TurntableSettings_t &settings) {
+  return [filePath, settings, vertices = controller->modelGetVertices(),
+          edges = controller->modelGetEdges(),
+          transform = controller->modelGetAffineTransform(),
+          definition = controller->modelGetModelDefinition()]() {
+    return writeTurntable(filePath, settings, vertices, edges, transform,
+                          definition);
+  };
+}
 
 /**
- * @brief Установка стратегии отрисовки объектов.
+ * @brief Отрисовка и кодирование кадров ролика
  *
- * Смена текущей стратегии отрисовки, основанной на переданных параметрах.
- * Удаляется предыдущая стратегия, если она была установлена.
+ * Кадры не зависят друг от друга, поэтому рисуются программным
+ * растеризатором одновременно, по кадру на поток, без окна и видеокарты.
+ * Стиль ребер и вершин тот же, что в окне (окно рисует только сплошные
+ * ребра). Каждый кадр передается кодировщику GIF, как только готовы он и
+ * все предыдущие, так что отрисовка идет одновременно с кодированием.
+ * Поток берет новый кадр, только если тот отстоит от еще не переданного
+ * не больше чем на два кадра на поток; это ограничивает память.
  *
- * @param strategy Указатель на стратегию отрисовки.
- * @param facets Список индексов граней, используемых для отрисовки.
- * @param vertices Список вершин, используемых для отрисовки.
- * @param modelDefinition Определение модели, содержащее параметры отрисовки.
+ * @param filePath Путь к файлу GIF.
+ * @param settings Число кадров, ось, размер и частота кадров.
+ * @param vertices, edges Сетка модели.
+ * @param transform Аффинные преобразования и тип проекции.
+ * @param definition Стиль отрисовки.
+ * @return false, если файл не удалось записать.
  */
-void OpenGLWidget::drawStrategy(Draw *strategy,
-                                const std::vector<unsigned int> &facets,
-                                const std::vector<QVector3D> &vertices,
-                                const ModelDefinition_t &modelDefinition) {
-  if (draw_) {
-    delete draw_;
+bool OffscreenRenderer::writeTurntable(const QString &filePath,
+                                       const TurntableSettings_t &settings,
+                                       const std::vector<QVector3D> &vertices,
+                                       const std::vector<unsigned int> &edges,
+                                       const AffineTransform_t &transform,
+                                       const ModelDefinition_t &definition) {
+  if (settings.frames <= 0 || settings.size.isEmpty()) return false;
+  GifStreamWriter writer;
+  if (!writer.open(filePath, settings.size, settings.fps)) return false;
+  QVector3D axis(settings.axis == AxisX ? 1.0f : 0.0f,
+                 settings.axis == AxisY ? 1.0f : 0.0f,
+                 settings.axis == AxisZ ? 1.0f : 0.0f);
+  QMatrix4x4 projection = ViewerModel::projectionMatrixFor(
+      transform, static_cast<float>(settings.size.width()) /
+                     static_cast<float>(settings.size.height()));
+  size_t frames = static_cast<size_t>(settings.frames);
+  size_t threads = std::min<size_t>(
+      std::max(1u, std::thread::hardware_concurrency()), frames);
+  size_t window = 2 * threads;
+  std::vector<QImage> rendered(window);
+  std::vector<char> ready(window, 0);
+  size_t nextFrame = 0, nextPush = 0;
+  std::mutex mutex;
+  std::condition_variable changed;
+
+  auto renderFrames = [&]() {
+    SoftwareRenderer renderer;
+    renderer.setParallel(false);
+    renderer.setAntialiasing(settings.antialiased);
+    for (;;) {
+      size_t frame = 0;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]() {
+          return nextFrame >= frames || nextFrame < nextPush + window;
+        });
+        if (nextFrame >= frames) return;
+        frame = nextFrame++;
+      }
+      AffineTransform_t turned = transform;
+      float angle = 360.0f * static_cast<float>(frame) / frames;
+      turned.orientation =
+          QQuaternion::fromAxisAndAngle(axis, angle) * transform.orientation;
+      QImage image =
+          renderer.render(vertices, edges,
+                          projection * ViewerModel::modelMatrixFor(turned),
+                          definition, settings.size);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        rendered[frame % window] = std::move(image);
+        ready[frame % window] = 1;
+      }
+      changed.notify_all();
+    }
+  };
+  std::vector<std::thread> workers;
+  workers.reserve(threads);
+  for (size_t i = 0; i < threads; ++i) workers.emplace_back(renderFrames);
+
+  for (size_t frame = 0; frame < frames; ++frame) {
+    QImage image;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock, [&]() { return ready[frame % window] != 0; });
+      image = std::move(rendered[frame % window]);
+      rendered[frame % window] = QImage();
+      ready[frame % window] = 0;
+      nextPush = frame + 1;
+    }
+    changed.notify_all();
+    writer.push(image);
   }
-  draw_ = strategy;
-  draw_->draw(facets, vertices, modelDefinition);
+  for (std::thread &worker : workers) worker.join();
+  return writer.finish();
+}
+
+/**
+ * @brief Деструктор: ожидание незавершенных задач.
+ *
+ * Отчеты задач, еще стоящие в очереди событий, удаляются вместе с
+ * объектом и не вызываются.
+ */
+BackgroundTasks::~BackgroundTasks() { pool.waitForDone(); }
+
+/**
+ * @brief Запуск задачи в пуле потоков.
+ *
+ * @param task Задача, выполняемая в фоновом потоке.
+ * @param done Отчет о результате, вызываемый в потоке этого объекта.
+ */
+void BackgroundTasks::start(std::function<bool()> task,
+                            std::function<void(bool)> done) {
+  ++pendingTasks;
+  pool.start([this, task = std::move(task), done = std::move(done)]() {
+    bool result = task();
+    // деструктор ждет задачу, поэтому объект еще существует
+    QMetaObject::invokeMethod(
+        this,
+        [this, done, result]() {
+          --pendingTasks;
+          done(result);
+        },
+        Qt::QueuedConnection);
+  });
 }
 
+/**
+ * @brief Число задач, о завершении которых еще не сообщено.
+ */
+int BackgroundTasks::pending() const { return pendingTasks; }
+
+/**
+ * @brief Ожидание завершения всех задач (отчеты остаются в очереди).
+ */
+void BackgroundTasks::waitForDone() { pool.waitForDone(); }
+
 /**
  * @brief Отрисовка граней с обычной толщиной линии.
  *
  * Стандартная отрисовка граней модели, где каждая грань представляется линией,
  * соединяющей вершины в контуре.
  *
- * @param facets Список индексов граней, используемых для отрисовки.
- * @param vertices Список вершин, используемых для отрисовки.
- * @param modelDefinition Определение модели, содержащее параметры отрисовки.
+ * @param frame Данные текущего кадра.
  */
-void DrawFacetZero::draw(const std::vector<unsigned int> &facets,
-                         const std::vector<QVector3D> &vertices,
-                         const ModelDefinition_t &modelDefinition) {
-  (void)modelDefinition;
+void DrawFacetZero::draw(const RenderFrame_t &frame) {
+  const std::vector<QVector3D> &vertices = *frame.vertices;
   glBegin(GL_LINE_LOOP);  // указывает, что надо отрисовать замкнутый контур
                           // соединия по 2 вершины
-  for (unsigned int facet : facets) {
+  for (unsigned int facet : *frame.facets) {
     if (facet < vertices.size()) {
       const QVector3D &v = vertices[facet];  // координаты вершины грани
       glVertex3f(v.x(), v.y(), v.z());
@@ -97,48 +1769,65 @@ void DrawFacetZero::draw(const std::vector<unsigned int> &facets,
 /**
  * @brief Отрисовка граней с увеличенной толщиной линии.
  *
- * В отличие от стандартной отрисовки, здесь каждая грань отрисовывается как
- * прямоугольник с вычисленной перпендикулярной толщиной линии.
- *
- * @param facets Список индексов граней, используемых для отрисовки.
- * @param vertices Список вершин, используемых для отрисовки.
- * @param modelDefinition Определение модели, содержащее параметры отрисовки.
- */
-void DrawFacetThick::draw(const std::vector<unsigned int> &facets,
-                          const std::vector<QVector3D> &vertices,
-                          const ModelDefinition_t &modelDefinition) {
-  for (size_t i = 0; i < facets.size(); ++i) {
-    unsigned int facet1 = facets[i];
-    unsigned int facet2 = facets[(i + 1) % facets.size()];  // Замыкаем контур
-    if (facet1 < vertices.size() && facet2 < vertices.size()) {
-      const QVector3D &v1 = vertices[facet1];
-      const QVector3D &v2 = vertices[facet2];
-      QVector3D direction = v2 - v1;
-      QVector3D arbitraryVector(1, 0, 0);  // Произвольный вектор
-      // Если направление линии коллинеарно с произвольным вектором, выбираем
-      // другой вектор
-      if (QVector3D::dotProduct(direction.normalized(),
-                                arbitraryVector.normalized()) > 0.99f) {
-        arbitraryVector = QVector3D(0, 1, 0);
-      }
-      // Вычисляем перпендикулярный вектор
-      QVector3D perpendicular =
-          QVector3D::crossProduct(direction, arbitraryVector).normalized() *
-          modelDefinition.facetWidth / 2.0f;
-      // Вершины прямоугольника
-      QVector3D p1 = v1 - perpendicular;
-      QVector3D p2 = v1 + perpendicular;
-      QVector3D p3 = v2 + perpendicular;
-      QVector3D p4 = v2 - perpendicular;
-      // Отрисовка прямоугольника
-      glBegin(GL_QUADS);
-      glVertex3f(p1.x(), p1.y(), p1.z());
-      glVertex3f(p2.x(), p2.y(), p2.z());
-      glVertex3f(p3.x(), p3.y(), p3.z());
-      glVertex3f(p4.x(), p4.y(), p4.z());
-      glEnd();
-    }
+ * Каждая грань отрисовывается как прямоугольник. Прямоугольники
+ * рассчитываются моделью только при изменении сетки или толщины, а здесь
+ * выводятся одним вызовом glDrawArrays.
+ *
+ * @param frame Данные текущего кадра.
+ */
+void DrawFacetThick::draw(const RenderFrame_t &frame) {
+  const std::vector<float> &quads = frame.controller->modelGetThickEdgeQuads();
+  if (quads.empty()) return;
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glVertexPointer(3, GL_FLOAT, 0, quads.data());
+  // четыре вершины на ребро, ребра видимых частей идут подряд
+  for (const EdgeRange_t &range : *frame.edgeRanges)
+    glDrawArrays(GL_QUADS, static_cast<GLint>(range.firstEdge * 4),
+                 static_cast<GLsizei>(range.edgeCount * 4));
+  glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+/**
+ * @brief Отрисовка граней обычной толщины из буферов видеопамяти.
+ *
+ * @param frame Данные текущего кадра.
+ */
+void DrawFacetBuffer::draw(const RenderFrame_t &frame) {
+  frame.retained->drawEdges(*frame.edgeRanges);
+}
+
+/**
+ * @brief Отрисовка граней увеличенной толщины шейдером.
+ *
+ * @param frame Данные текущего кадра.
+ */
+void DrawFacetShader::draw(const RenderFrame_t &frame) {
+  // ортогональная проекция охватывает 4 единицы по высоте окна
+  float lineWidth = std::max(
+      1.0f, frame.modelDefinition->facetWidth *
+                static_cast<float>(frame.viewport.height()) / 4.0f);
+  frame.retained->drawThickEdges(*frame.edgeRanges, frame.mvp, frame.viewport,
+                                 lineWidth, frame.modelDefinition->facetColor);
+}
+
+/**
+ * @brief Отрисовка упрощенного набора ребер во время вращения.
+ *
+ * Ребра рисуются тонкими линиями без отсечения, вершины не рисуются.
+ *
+ * @param frame Данные текущего кадра.
+ */
+void DrawFacetLod::draw(const RenderFrame_t &frame) {
+  if (frame.retained) {
+    frame.retained->drawLodEdges();
+    return;
   }
+  const std::vector<unsigned int> &lodEdges = *frame.lodEdges;
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glVertexPointer(3, GL_FLOAT, 0, frame.vertices->data());
+  glDrawElements(GL_LINES, static_cast<GLsizei>(lodEdges.size()),
+                 GL_UNSIGNED_INT, lodEdges.data());
+  glDisableClientState(GL_VERTEX_ARRAY);
 }
 
 /**
@@ -147,17 +1836,12 @@ void DrawFacetThick::draw(const std::vector<unsigned int> &facets,
  * Каждая вершина модели представляется как квадрат, размер которого
  * определяется параметром отрисовки.
  *
- * @param facets Список индексов граней, используемых для отрисовки.
- * @param vertices Список вершин, используемых для отрисовки.
- * @param modelDefinition Определение модели, содержащее параметры отрисовки.
+ * @param frame Данные текущего кадра.
  */
-void DrawVerticeSquare::draw(const std::vector<unsigned int> &facets,
-                             const std::vector<QVector3D> &vertices,
-                             const ModelDefinition_t &modelDefinition) {
-  (void)facets;
-  glPointSize(modelDefinition.verticeWidth);
+void DrawVerticeSquare::draw(const RenderFrame_t &frame) {
+  glPointSize(frame.modelDefinition->verticeWidth);
   glBegin(GL_POINTS);
-  for (const QVector3D &v : vertices) {
+  for (const QVector3D &v : *frame.vertices) {
     glVertex3f(v.x(), v.y(), v.z());
   }
   glEnd();
@@ -169,16 +1853,11 @@ void DrawVerticeSquare::draw(const std::vector<unsigned int> &facets,
  * Каждая вершина модели представляется как круг, размер которого определяется
  * параметром отрисовки.
  *
- * @param facets Список индексов граней, используемых для отрисовки.
- * @param vertices Список вершин, используемых для отрисовки.
- * @param modelDefinition Определение модели, содержащее параметры отрисовки.
+ * @param frame Данные текущего кадра.
  */
-void DrawVerticeCircle::draw(const std::vector<unsigned int> &facets,
-                             const std::vector<QVector3D> &vertices,
-                             const ModelDefinition_t &modelDefinition) {
-  (void)facets;
-  float radius = modelDefinition.verticeWidth / 1000.0f;  // Радиус круга
-  for (const QVector3D &v : vertices) {
+void DrawVerticeCircle::draw(const RenderFrame_t &frame) {
+  float radius = frame.modelDefinition->verticeWidth / 1000.0f;  // Радиус
+  for (const QVector3D &v : *frame.vertices) {
     glBegin(GL_TRIANGLE_FAN);
     glVertex3f(v.x(), v.y(), v.z());
     for (int i = 0; i <= 36; ++i) {
@@ -191,64 +1870,606 @@ void DrawVerticeCircle::draw(const std::vector<unsigned int> &facets,
   }
 }
 
+/**
+ * @brief Отрисовка квадратных вершин из буфера видеопамяти.
+ *
+ * @param frame Данные текущего кадра.
+ */
+void DrawVerticeBuffer::draw(const RenderFrame_t &frame) {
+  frame.retained->drawVertices(frame.modelDefinition->verticeWidth);
+}
+
+/**
+ * @brief Отрисовка вершин точечными спрайтами.
+ *
+ * @param frame Данные текущего кадра.
+ */
+void DrawVerticeSprite::draw(const RenderFrame_t &frame) {
+  frame.retained->drawMarkers(frame.mvp, frame.modelDefinition->verticeWidth,
+                              frame.modelDefinition->verticeType,
+                              frame.modelDefinition->verticeColor);
+}
+
+static_assert(sizeof(QVector3D) == 3 * sizeof(float),
+              "QVector3D must be tightly packed to be uploaded as is");
+
+// Вершинный шейдер толстых ребер: экземпляр - отрезок, вершины - углы
+// четырехугольника. corner.x выбирает конец отрезка, corner.y - сторону.
+static const char *kThickLineVertexShader = R"(#version 330
+layout(location = 0) in vec2 corner;
+layout(location = 1) in vec3 segmentStart;
+layout(location = 2) in vec3 segmentEnd;
+uniform mat4 mvp;
+uniform vec2 viewport;
+uniform float lineWidth;
+void main() {
+  vec4 clipStart = mvp * vec4(segmentStart, 1.0);
+  vec4 clipEnd = mvp * vec4(segmentEnd, 1.0);
+  vec2 direction = clipEnd.xy / clipEnd.w * viewport -
+                   clipStart.xy / clipStart.w * viewport;
+  float len = length(direction);
+  direction = len > 1e-6 ? direction / len : vec2(1.0, 0.0);
+  vec2 normal = vec2(-direction.y, direction.x);
+  vec4 clip = mix(clipStart, clipEnd, corner.x);
+  vec2 offset = normal * corner.y * lineWidth / viewport;
+  gl_Position = clip + vec4(offset * clip.w, 0.0, 0.0);
+}
+)";
+
+static const char *kThickLineFragmentShader = R"(#version 330
+uniform vec4 color;
+out vec4 fragColor;
+void main() { fragColor = color; }
+)";
+
+// Маркеры вершин: размер точки задает шейдер, круг вырезается по
+// gl_PointCoord во фрагментном шейдере.
+static const char *kPointSpriteVertexShader = R"(#version 330
+layout(location = 0) in vec3 position;
+uniform mat4 mvp;
+uniform float pointSize;
+void main() {
+  gl_Position = mvp * vec4(position, 1.0);
+  gl_PointSize = pointSize;
+}
+)";
+
+static const char *kPointSpriteFragmentShader = R"(#version 330
+uniform vec4 color;
+uniform bool roundMarker;
+out vec4 fragColor;
+void main() {
+  if (roundMarker && length(gl_PointCoord - vec2(0.5)) > 0.5) discard;
+  fragColor = color;
+}
+)";
+
+#ifndef GL_PROGRAM_POINT_SIZE
+#define GL_PROGRAM_POINT_SIZE 0x8642
+#endif
+#ifndef GL_POINT_SPRITE
+#define GL_POINT_SPRITE 0x8861
+#endif
+
+/**
+ * @brief Конструктор отрисовщика из буферов видеопамяти.
+ */
+RetainedRenderer::RetainedRenderer()
+    : vertexBuffer(QOpenGLBuffer::VertexBuffer),
+      indexBuffer(QOpenGLBuffer::IndexBuffer),
+      lodIndexBuffer(QOpenGLBuffer::IndexBuffer),
+      culledIndexBuffer(QOpenGLBuffer::IndexBuffer),
+      cornerBuffer(QOpenGLBuffer::VertexBuffer),
+      segmentBuffer(QOpenGLBuffer::VertexBuffer) {}
+
+/**
+ * @brief Создание буферов в текущем контексте OpenGL.
+ *
+ * @return false, если буферы недоступны и нужно использовать стратегии Draw.
+ */
+bool RetainedRenderer::initialize() {
+  initializeOpenGLFunctions();
+  destroy();
+  if (!vertexBuffer.create() || !indexBuffer.create() ||
+      !lodIndexBuffer.create() || !culledIndexBuffer.create()) {
+    destroy();
+    return false;
+  }
+  vertexBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+  indexBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+  lodIndexBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+  culledIndexBuffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+  thickLinesReady = initializeThickLines();
+  if (!thickLinesReady)
+    qWarning() << "Thick line shader is unavailable, using DrawFacetThick";
+  pointSpritesReady = initializePointSprites();
+  if (!pointSpritesReady)
+    qWarning() << "Point sprite shader is unavailable, using Draw strategies";
+  return true;
+}
+
+/**
+ * @brief Проверка, что текущий контекст поддерживает шейдеры GLSL 3.30.
+ */
+bool RetainedRenderer::shadersSupported() {
+  QOpenGLContext *context = QOpenGLContext::currentContext();
+  return context && !context->isOpenGLES() &&
+         context->format().version() >= qMakePair(3, 3);
+}
+
+/**
+ * @brief Сборка шейдера маркеров вершин.
+ *
+ * @return true, если маркеры можно рисовать точечными спрайтами.
+ */
+bool RetainedRenderer::initializePointSprites() {
+  if (!shadersSupported()) return false;
+  return pointSpriteProgram.addShaderFromSourceCode(
+             QOpenGLShader::Vertex, kPointSpriteVertexShader) &&
+         pointSpriteProgram.addShaderFromSourceCode(
+             QOpenGLShader::Fragment, kPointSpriteFragmentShader) &&
+         pointSpriteProgram.link();
+}
+
+/**
+ * @brief Сборка шейдера толстых ребер и буфера углов четырехугольника.
+ *
+ * Для отрисовки экземплярами нужен OpenGL 3.3, на более старых контекстах
+ * толстые ребра рисуются стратегией DrawFacetThick.
+ *
+ * @return true, если путь отрисовки шейдером доступен.
+ */
+bool RetainedRenderer::initializeThickLines() {
+  if (!shadersSupported()) return false;
+  if (!thickLineProgram.addShaderFromSourceCode(QOpenGLShader::Vertex,
+                                                kThickLineVertexShader) ||
+      !thickLineProgram.addShaderFromSourceCode(QOpenGLShader::Fragment,
+                                                kThickLineFragmentShader) ||
+      !thickLineProgram.link())
+    return false;
+  // четырехугольник отрезка рисуется полосой из двух треугольников
+  static const float corners[] = {0.0f, -1.0f, 0.0f, 1.0f,
+                                  1.0f, -1.0f, 1.0f, 1.0f};
+  if (!cornerBuffer.create() || !segmentBuffer.create()) return false;
+  cornerBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+  segmentBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+  cornerBuffer.bind();
+  cornerBuffer.allocate(corners, sizeof(corners));
+  cornerBuffer.release();
+  return true;
+}
+
+/**
+ * @brief Освобождение буферов (контекст OpenGL должен быть текущим).
+ */
+void RetainedRenderer::destroy() {
+  vertexBuffer.destroy();
+  indexBuffer.destroy();
+  lodIndexBuffer.destroy();
+  culledIndexBuffer.destroy();
+  cornerBuffer.destroy();
+  segmentBuffer.destroy();
+  thickLineProgram.removeAllShaders();
+  thickLinesReady = false;
+  pointSpriteProgram.removeAllShaders();
+  pointSpritesReady = false;
+  vertexCount = 0;
+  indexCount = 0;
+  uploaded = false;
+  lodIndexCount = 0;
+  lodUploaded = false;
+  culledActive = false;
+}
+
+/**
+ * @brief Проверка, созданы ли буферы.
+ */
+bool RetainedRenderer::isValid() const {
+  return vertexBuffer.isCreated() && indexBuffer.isCreated();
+}
+
+/**
+ * @brief Проверка, доступна ли отрисовка толстых ребер шейдером.
+ */
+bool RetainedRenderer::hasThickLines() const {
+  return isValid() && thickLinesReady;
+}
+
+/**
+ * @brief Проверка, доступна ли отрисовка маркеров точечными спрайтами.
+ */
+bool RetainedRenderer::hasPointSprites() const {
+  return isValid() && pointSpritesReady;
+}
+
+/**
+ * @brief Загрузка вершин и ребер в видеопамять.
+ *
+ * Загрузка выполняется, только если поколение сетки изменилось с прошлого
+ * вызова, поэтому метод можно вызывать в каждом кадре.
+ *
+ * @param vertices Вершины модели.
+ * @param edges Пары индексов вершин.
+ * @param generation Поколение сетки модели.
+ */
+void RetainedRenderer::upload(const std::vector<QVector3D> &vertices,
+                              const std::vector<unsigned int> &edges,
+                              unsigned long long generation) {
+  if (!isValid() || (uploaded && generation == uploadedGeneration)) return;
+  vertexBuffer.bind();
+  vertexBuffer.allocate(vertices.data(),
+                        static_cast<int>(vertices.size() * sizeof(QVector3D)));
+  vertexBuffer.release();
+  indexBuffer.bind();
+  indexBuffer.allocate(edges.data(),
+                       static_cast<int>(edges.size() * sizeof(unsigned int)));
+  indexBuffer.release();
+  if (thickLinesReady) {
+    // экземпляру нужны оба конца отрезка, поэтому ребра разворачиваются
+    std::vector<QVector3D> segments;
+    segments.reserve(edges.size());
+    for (unsigned int index : edges) segments.push_back(vertices[index]);
+    segmentBuffer.bind();
+    segmentBuffer.allocate(
+        segments.data(), static_cast<int>(segments.size() * sizeof(QVector3D)));
+    segmentBuffer.release();
+  }
+  vertexCount = static_cast<int>(vertices.size());
+  indexCount = static_cast<int>(edges.size());
+  uploadedGeneration = generation;
+  uploaded = true;
+}
+
+/**
+ * @brief Загрузка упрощенного набора ребер в видеопамять.
+ *
+ * @param lodEdges Пары индексов вершин упрощенной модели.
+ * @param revision Версия набора; при совпадении загрузка пропускается.
+ */
+void RetainedRenderer::uploadLod(const std::vector<unsigned int> &lodEdges,
+                                 unsigned long long revision) {
+  if (!isValid() || (lodUploaded && revision == uploadedLodRevision)) return;
+  lodIndexBuffer.bind();
+  int bytes = static_cast<int>(lodEdges.size() * sizeof(unsigned int));
+  lodIndexBuffer.allocate(lodEdges.data(), bytes);
+  lodIndexBuffer.release();
+  lodIndexCount = static_cast<int>(lodEdges.size());
+  uploadedLodRevision = revision;
+  lodUploaded = true;
+}
+
+/**
+ * @brief Загрузка ребер, оставшихся после отсечения коротких.
+ *
+ * Пока набор загружен, drawEdges рисует диапазоны этого набора вместо
+ * исходного буфера индексов.
+ *
+ * @param kept Пары индексов вершин сохраненных ребер.
+ */
+void RetainedRenderer::uploadCulledEdges(
+    const std::vector<unsigned int> &kept) {
+  if (!isValid()) return;
+  culledIndexBuffer.bind();
+  int bytes = static_cast<int>(kept.size() * sizeof(unsigned int));
+  culledIndexBuffer.allocate(kept.data(), bytes);
+  culledIndexBuffer.release();
+  culledActive = true;
+}
+
+/**
+ * @brief Возврат к исходному буферу индексов.
+ */
+void RetainedRenderer::clearCulledEdges() { culledActive = false; }
+
+/**
+ * @brief Подключение буфера вершин как массива координат.
+ */
+void RetainedRenderer::bindVertices() {
+  vertexBuffer.bind();
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glVertexPointer(3, GL_FLOAT, 0, nullptr);
+}
+
+/**
+ * @brief Отключение массива координат.
+ */
+void RetainedRenderer::releaseVertices() {
+  glDisableClientState(GL_VERTEX_ARRAY);
+  vertexBuffer.release();
+}
+
+/**
+ * @brief Отрисовка ребер видимых частей сетки вызовами glDrawElements.
+ *
+ * @param ranges Непрерывные диапазоны видимых ребер, по вызову на диапазон.
+ */
+void RetainedRenderer::drawEdges(const std::vector<EdgeRange_t> &ranges) {
+  if (indexCount == 0 || ranges.empty()) return;
+  QOpenGLBuffer &source = culledActive ? culledIndexBuffer : indexBuffer;
+  bindVertices();
+  source.bind();
+  for (const EdgeRange_t &range : ranges)
+    glDrawElements(GL_LINES, static_cast<GLsizei>(range.edgeCount * 2),
+                   GL_UNSIGNED_INT,
+                   reinterpret_cast<const void *>(range.firstEdge * 2 *
+                                                  sizeof(unsigned int)));
+  source.release();
+  releaseVertices();
+}
+
+/**
+ * @brief Отрисовка упрощенного набора ребер одним вызовом glDrawElements.
+ */
+void RetainedRenderer::drawLodEdges() {
+  if (lodIndexCount == 0) return;
+  bindVertices();
+  lodIndexBuffer.bind();
+  glDrawElements(GL_LINES, lodIndexCount, GL_UNSIGNED_INT, nullptr);
+  lodIndexBuffer.release();
+  releaseVertices();
+}
+
+/**
+ * @brief Отрисовка вершин квадратными точками одним вызовом glDrawArrays.
+ *
+ * @param pointSize Размер точки в пикселях.
+ */
+void RetainedRenderer::drawVertices(float pointSize) {
+  if (vertexCount == 0) return;
+  glPointSize(pointSize);
+  bindVertices();
+  glDrawArrays(GL_POINTS, 0, vertexCount);
+  releaseVertices();
+}
+
+/**
+ * @brief Отрисовка толстых ребер экземплярами отрезков.
+ *
+ * Процессор передает только матрицу и ширину, поэтому работа на кадр не
+ * зависит от числа ребер, а ширина линии в пикселях не меняется при
+ * вращении модели. Для каждого диапазона видимых ребер атрибуты отрезков
+ * смещаются на его начало.
+ *
+ * @param ranges Непрерывные диапазоны видимых ребер.
+ * @param mvp Произведение матриц проекции и модели.
+ * @param viewport Размер области вывода в пикселях.
+ * @param lineWidth Ширина линии в пикселях.
+ * @param color Цвет ребер.
+ */
+void RetainedRenderer::drawThickEdges(const std::vector<EdgeRange_t> &ranges,
+                                      const QMatrix4x4 &mvp,
+                                      const QSizeF &viewport, float lineWidth,
+                                      const QColor &color) {
+  if (!hasThickLines() || indexCount == 0 || ranges.empty()) return;
+  thickLineProgram.bind();
+  thickLineProgram.setUniformValue("mvp", mvp);
+  thickLineProgram.setUniformValue(
+      "viewport", QVector2D(viewport.width(), viewport.height()));
+  thickLineProgram.setUniformValue("lineWidth", lineWidth);
+  thickLineProgram.setUniformValue("color", color);
+  cornerBuffer.bind();
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+  segmentBuffer.bind();
+  const GLsizei stride = 2 * sizeof(QVector3D);
+  glEnableVertexAttribArray(1);
+  glVertexAttribDivisor(1, 1);
+  glEnableVertexAttribArray(2);
+  glVertexAttribDivisor(2, 1);
+  for (const EdgeRange_t &range : ranges) {
+    size_t offset = range.firstEdge * static_cast<size_t>(stride);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<const void *>(offset));
+    glVertexAttribPointer(
+        2, 3, GL_FLOAT, GL_FALSE, stride,
+        reinterpret_cast<const void *>(offset + sizeof(QVector3D)));
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4,
+                          static_cast<GLsizei>(range.edgeCount));
+  }
+  glVertexAttribDivisor(1, 0);
+  glVertexAttribDivisor(2, 0);
+  glDisableVertexAttribArray(0);
+  glDisableVertexAttribArray(1);
+  glDisableVertexAttribArray(2);
+  segmentBuffer.release();
+  thickLineProgram.release();
+}
+
+/**
+ * @brief Отрисовка маркеров вершин одним вызовом glDrawArrays.
+ *
+ * Маркеры берутся из того же буфера вершин, что и ребра. Круглые маркеры
+ * получаются отбрасыванием фрагментов за пределами вписанного круга.
+ *
+ * @param mvp Произведение матриц проекции и модели.
+ * @param pointSize Размер маркера в пикселях.
+ * @param verticeType Форма маркера (Square или Circle).
+ * @param color Цвет маркеров.
+ */
+void RetainedRenderer::drawMarkers(const QMatrix4x4 &mvp, float pointSize,
+                                   VerticeType_t verticeType,
+                                   const QColor &color) {
+  if (!hasPointSprites() || vertexCount == 0) return;
+  glEnable(GL_PROGRAM_POINT_SIZE);
+  glEnable(GL_POINT_SPRITE);
+  pointSpriteProgram.bind();
+  pointSpriteProgram.setUniformValue("mvp", mvp);
+  pointSpriteProgram.setUniformValue("pointSize", pointSize);
+  pointSpriteProgram.setUniformValue("roundMarker",
+                                     GLint(verticeType == Circle));
+  pointSpriteProgram.setUniformValue("color", color);
+  vertexBuffer.bind();
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+  glDrawArrays(GL_POINTS, 0, vertexCount);
+  glDisableVertexAttribArray(0);
+  vertexBuffer.release();
+  pointSpriteProgram.release();
+  glDisable(GL_POINT_SPRITE);
+  glDisable(GL_PROGRAM_POINT_SIZE);
+}
+
 /**
  * @brief Отрисовка модели в соответствии с заданными аффинными
  * преобразованиями.
  *
- * Выполняется очищение буферов, установка матрицы проекции и матрицы модели, а
- * также трансформации модели (масштабирование, повороты, сдвиги). Затем
- * отрисовываются грани и вершины модели.
+ * Если после прошлого кадра модель не менялась, отрисовка пропускается:
+ * содержимое кадра сохраняется (PartialUpdate). Иначе из модели заново
+ * запрашивается только измененное состояние (стиль, проекция), выполняется
+ * очищение буферов и загрузка матриц проекции и модели. Матрица модели
+ * кэшируется в модели и пересчитывается только после изменения
+ * преобразований. Затем отрисовываются грани и вершины модели.
  */
 void OpenGLWidget::paintGL() {
-  AffineTransform_t affineTransform =
-      viewer_controller->modelGetAffineTransform();
-  ModelDefinition_t modelDefinition =
-      viewer_controller->modelGetModelDefinition();
+  QElapsedTimer paintClock;
+  paintClock.start();
+  frameClock.start();
+  applyPendingInput();
+  unsigned int dirty = viewer_controller->modelGetDirtyFlags();
+  if (dirty == DirtyNone && !needsRedraw) {
+    ++stats.skippedFrames;
+    // содержимое кадра сохранилось, его можно захватить без перерисовки
+    if (captureRequested) readbackFrame();
+    return;
+  }
+  if (dirty & DirtyStyle) {
+    modelDefinition_ = viewer_controller->modelGetModelDefinition();
+    renderPass.reset();
+  }
+  if ((dirty & DirtyTransform) || needsRedraw) {
+    float aspectRatio =
+        static_cast<float>(width()) / static_cast<float>(height());
+    projectionMatrix = viewer_controller->modelGetProjectionMatrix(aspectRatio);
+  }
+  viewer_controller->modelClearDirtyFlags(dirty);
+  needsRedraw = false;
+
+  const ModelDefinition_t &modelDefinition = modelDefinition_;
   glClearColor(modelDefinition.backgroundColor.redF(),
                modelDefinition.backgroundColor.greenF(),
                modelDefinition.backgroundColor.blueF(), 1.0f);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);  // очистка буферов
   // настройка проекции
   glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();  // сбрасывает текущую матрицу проекции к единичной матрице
-  // текущая проекция
-  if (affineTransform.projectionType == Parallel) {
-    glOrtho(-2, 2, -2, 2, -2, 2);
-  } else if (affineTransform.projectionType == Perspective) {
-    float aspectRatio =
-        static_cast<float>(width()) / static_cast<float>(height());
-    gluPerspective(affineTransform.fov, aspectRatio, 0.01f, 100.0f);
-  }
-  // режим представления модели
+  glLoadMatrixf(projectionMatrix.constData());
+  // режим представления модели и аффинные преобразования
   glMatrixMode(GL_MODELVIEW);
-  glLoadIdentity();  // сбрасывает текущую матрицу модели к единичной матрице
-  // аффинные преобразования
-  glScalef(affineTransform.scaleFactor, affineTransform.scaleFactor,
-           affineTransform.scaleFactor);
-  glRotatef(affineTransform.rotateAngleX, 1.0f, 0.0f, 0.0f);
-  glRotatef(affineTransform.rotateAngleY, 0.0f, 1.0f, 0.0f);
-  glRotatef(affineTransform.rotateAngleZ, 0.0f, 0.0f, 1.0f);
-  glTranslatef(affineTransform.translateX, affineTransform.translateY,
-               affineTransform.translateZ);
-
-  std::vector<unsigned int> facets = viewer_controller->modelGetFacets();
-  std::vector<QVector3D> vertices = viewer_controller->modelGetVertices();
-  glColor3f(modelDefinition.facetColor.redF(),
-            modelDefinition.facetColor.greenF(),
-            modelDefinition.facetColor.blueF());
-  // Отрисовка ребер с неизмененным кнопками размером
-  if (modelDefinition.facetWidth == 0)
-    drawStrategy(new DrawFacetZero, facets, vertices, modelDefinition);
-  else
-    drawStrategy(new DrawFacetThick, facets, vertices, modelDefinition);
-  // отрисовка вершин в виде точек
-  glColor3f(modelDefinition.verticeColor.redF(),
-            modelDefinition.verticeColor.greenF(),
-            modelDefinition.verticeColor.blueF());
-  if (modelDefinition.verticeType == Square)
-    drawStrategy(new DrawVerticeSquare, facets, vertices, modelDefinition);
-  else if (modelDefinition.verticeType == Circle)
-    drawStrategy(new DrawVerticeCircle, facets, vertices, modelDefinition);
+  glLoadMatrixf(viewer_controller->modelGetModelMatrix().constData());
+
+  // буферы обновляются, только если сменилось поколение сетки
+  bool useRetained = retainedEnabled && retained.isValid();
+  const std::vector<unsigned int> &lodEdges =
+      viewer_controller->modelGetLodEdges(lodBudget_);
+  if (useRetained) {
+    retained.upload(viewer_controller->modelGetVertices(),
+                    viewer_controller->modelGetEdges(),
+                    viewer_controller->modelGetMeshGeneration());
+    retained.uploadLod(lodEdges, viewer_controller->modelGetLodRevision());
+  }
+  if (!renderPass) buildRenderPass();
+  float pixelRatio = static_cast<float>(devicePixelRatio());
+  frame_.facets = &viewer_controller->modelGetFacets();
+  frame_.vertices = &viewer_controller->modelGetVertices();
+  frame_.modelDefinition = &modelDefinition_;
+  frame_.controller = viewer_controller;
+  frame_.retained = useRetained ? &retained : nullptr;
+  frame_.lodEdges = &lodEdges;
+  frame_.mvp = projectionMatrix * viewer_controller->modelGetModelMatrix();
+  frame_.viewport = QSizeF(width() * pixelRatio, height() * pixelRatio);
+  // отсечение частей сетки, целиком лежащих вне пирамиды видимости
+  stats.visibleChunks =
+      viewer_controller->modelCollectVisibleEdges(frame_.mvp, visibleRanges);
+  stats.culledChunks = static_cast<int>(
+      viewer_controller->modelGetChunks().size() - stats.visibleChunks);
+  frame_.edgeRanges = &visibleRanges;
+  // упрощенная сетка подставляется вместо исходной в буферных режимах;
+  // кэш толстых ребер построен по исходной сетке, поэтому с ним она не
+  // используется
+  bool levelCompatible =
+      modelDefinition_.facetWidth == 0 || retained.hasThickLines();
+  bool levelsUsable = useRetained && levelCompatible && levelRenderer.isValid();
+  stats.lodLevel =
+      levelsUsable ? selectLodLevel(frame_.mvp, frame_.viewport) : -1;
+  // сетка больше бюджета во время вращения заменяется уровнем цепочки, а
+  // пока цепочки нет - выборкой ребер
+  bool overBudget = interacting && !lodEdges.empty();
+  int budgetLevel = overBudget && levelsUsable ? budgetLodLevel() : -1;
+  stats.lodLevel = std::max(stats.lodLevel, budgetLevel);
+  bool interactionLod = overBudget && budgetLevel < 0;
+  if (levelsUsable && !lodChainTimer.isActive() &&
+      viewer_controller->modelIsLodChainBuilding())
+    lodChainTimer.start();
+  if (stats.lodLevel >= 0 && !interactionLod) {
+    const LodLevel_t &level =
+        viewer_controller->modelGetLodChain()[stats.lodLevel];
+    levelRenderer.upload(
+        level.vertices, level.edges,
+        viewer_controller->modelGetLodChainRevision() *
+                ViewerModel::kMaxLodLevels +
+            stats.lodLevel);
+    levelRanges.resize(1);
+    levelRanges[0].firstEdge = 0;
+    levelRanges[0].edgeCount =
+        static_cast<unsigned int>(level.edges.size() / 2);
+    frame_.retained = &levelRenderer;
+    frame_.edgeRanges = &levelRanges;
+  }
+  // короткие ребра отбрасываются только для тонких линий исходной сетки:
+  // толстые ребра рисуются из буфера отрезков, а уровни уже упрощены
+  bool cullSubPixel = subPixelCulling && useRetained && !interactionLod &&
+                      stats.lodLevel < 0 && modelDefinition_.facetWidth == 0;
+  stats.subPixelCulled = 0;
+  if (cullSubPixel) {
+    // ребра отбираются и загружаются заново, только если изменились
+    // матрица, область вывода, порог или сетка
+    unsigned long long generation =
+        viewer_controller->modelGetMeshGeneration();
+    if (!culledValid || culledMvp != frame_.mvp ||
+        culledViewport != frame_.viewport ||
+        culledThreshold != subPixelThreshold_ ||
+        culledGeneration != generation) {
+      culledCount = static_cast<long long>(
+          viewer_controller->modelCullSubPixelEdges(
+              frame_.mvp, frame_.viewport, subPixelThreshold_, visibleRanges,
+              keptEdges));
+      retained.uploadCulledEdges(keptEdges);
+      culledMvp = frame_.mvp;
+      culledViewport = frame_.viewport;
+      culledThreshold = subPixelThreshold_;
+      culledGeneration = generation;
+      culledValid = true;
+      progressiveRanges = nullptr;  // набор ребер сменился
+    }
+    stats.subPixelCulled = culledCount;
+    keptRanges.resize(1);
+    keptRanges[0].firstEdge = 0;
+    keptRanges[0].edgeCount = static_cast<unsigned int>(keptEdges.size() / 2);
+    frame_.edgeRanges = &keptRanges;
+  } else if (useRetained) {
+    retained.clearCulledEdges();
+    culledValid = false;
+  }
+  bool progressive = progressiveEnabled && useRetained && !overBudget &&
+                     QOpenGLFramebufferObject::hasOpenGLFramebufferObjects();
+  if (interactionLod) {
+    if (!lodPass)
+      lodPass =
+          std::make_unique<StyledRenderPass<DrawFacetLod, DrawVerticeNone>>();
+    lodPass->draw(frame_);
+  } else if (progressive) {
+    drawProgressive(dirty != DirtyNone, paintClock);
+  } else {
+    renderPass->draw(frame_);
+  }
+  if (!progressive) {
+    // накопленное изображение устарело к следующему включению
+    progressiveRanges = nullptr;
+    refineRequested = false;
+    stats.progressiveDone = 1.0f;
+  }
+  if (captureRequested) readbackFrame();
+  ++stats.totalFrames;
+  stats.frameTimeMs = paintClock.nsecsElapsed() / 1.0e6f;
 }
 
 /**
@@ -263,29 +2484,53 @@ void OpenGLWidget::mousePressEvent(QMouseEvent *event) {
   } else if (event->button() == Qt::MiddleButton) {
     lastMousePos = event->pos();
   }
+  if (wheelGesture) finishWheelGesture();
+  if (history_) history_->beginInteraction();
+}
+
+/**
+ * @brief Завершение перетаскивания: оставшийся ввод применяется, а все
+ * перемещения мыши остаются одной записью истории.
+ *
+ * @param event Событие отпускания кнопки мыши.
+ */
+void OpenGLWidget::mouseReleaseEvent(QMouseEvent *event) {
+  (void)event;
+  applyPendingInput();
+  if (history_) history_->endInteraction();
+  requestUpdate();
 }
 
 /**
  * @brief Обработка движения мыши при зажатой кнопке, выполняется перемещение
  * или вращение модели.
  *
+ * Смещение не применяется сразу, а накапливается до следующего кадра, поэтому
+ * мышь с высокой частотой опроса не порождает лишних изменений состояния.
+ *
  * @param event Событие перемещения мыши, содержащее информацию о текущей
  * позиции мыши.
  */
 void OpenGLWidget::mouseMoveEvent(QMouseEvent *event) {
   QPoint delta = event->pos() - lastMousePos;
   if (event->buttons() & Qt::LeftButton) {
-    viewer_controller->modelMouseButtonMove(delta);
+    pendingRotate += delta;
   } else if (event->buttons() & Qt::MiddleButton) {
-    viewer_controller->modelMouseWheelMove(delta);
+    pendingRoll += delta;
   }
   lastMousePos = event->pos();
-  update();
+  ++pendingEvents;
+  ++stats.totalEvents;
+  beginInteractionLod();
+  scheduleFrame();
 }
 
 /**
  * @brief Обработка колесика мыши для изменения масштаба модели.
  *
+ * Шаги колесика до паузы lodIdleMs сливаются в одну запись истории так же,
+ * как перемещения мыши за одно перетаскивание.
+ *
  * @param event Событие колесика мыши, содержащее информацию о направлении
  * прокрутки.
  */
@@ -293,13 +2538,30 @@ void OpenGLWidget::wheelEvent(QWheelEvent *event) {
   QPoint numDegrees = event->angleDelta() / 8;
   if (!numDegrees.isNull()) {
     if (numDegrees.y() > 0)
-      viewer_controller->modelScaleFigure(scalePlus, 0.0f);
+      ++pendingWheelSteps;
     else
-      viewer_controller->modelScaleFigure(scaleMinus, 0.0f);
-    update();
+      --pendingWheelSteps;
+    ++pendingEvents;
+    ++stats.totalEvents;
+    if (history_ && !wheelGesture && !history_->inInteraction()) {
+      history_->beginInteraction();
+      wheelGesture = true;
+    }
+    beginInteractionLod();
+    scheduleFrame();
   }
 }
 
+/**
+ * @brief Завершение прокрутки колесика: оставшиеся шаги применяются, а вся
+ * прокрутка остается одной записью истории.
+ */
+void OpenGLWidget::finishWheelGesture() {
+  wheelGesture = false;
+  applyPendingInput();
+  if (history_) history_->endInteraction();
+}
+
 /**
  * @brief Конструктор главного окна, инициализирует все компоненты интерфейса.
  *
@@ -308,6 +2570,7 @@ void OpenGLWidget::wheelEvent(QWheelEvent *event) {
 MainWindow::MainWindow(ViewerController *Controller)
     : viewer_controller(Controller) {
   openGL_widget = new OpenGLWidget(viewer_controller);
+  openGL_widget->setCommandHistory(&history);
   QFont font("Arial", 12, QFont::Bold);
   setWindowTitle("3DViewer");
   resize(800, 600);
@@ -362,6 +2625,8 @@ void MainWindow::part1Buttons() {
   buttonScale_p = new QPushButton("Scale+");
   buttonScale_m = new QPushButton("Scale-");
   buttonDefault = new QPushButton("Default Projection");
+  buttonUndo = new QPushButton("Undo");
+  buttonRedo = new QPushButton("Redo");
   translateXInput = new QLineEdit();
   translateYInput = new QLineEdit();
   translateZInput = new QLineEdit();
@@ -376,6 +2641,13 @@ void MainWindow::part1Buttons() {
   rotateYInput->setPlaceholderText("Enter Y angle");
   rotateZInput->setPlaceholderText("Enter Z angle");
   scaleInput->setPlaceholderText("Enter Scale");
+  lodBudgetInput = new QLineEdit();
+  lodBudgetInput->setPlaceholderText("LOD edges (0 - off)");
+  lodBudgetInput->setText(QString::number(openGL_widget->lodBudget()));
+  subPixelInput = new QLineEdit();
+  subPixelInput->setPlaceholderText("Min edge px (0 - off)");
+  subPixelInput->setText("0");
+  progressiveCheck = new QCheckBox("Progressive");
 }
 
 /**
@@ -405,7 +2677,22 @@ void MainWindow::part2Buttons() {
   buttonBackGroundColor = new QPushButton("BackGround Color");
   // Кнопки для part3
   buttonSaveImage = new QPushButton("Save Image");
-  buttonRecordGif = new QPushButton("Record GIF");
+  buttonRecord = new QPushButton("Record");
+  gifSettingsInput = new QLineEdit();
+  gifSettingsInput->setPlaceholderText("Record WxH@fps");
+  gifSettingsInput->setText("640x480@10");
+  buttonTurntable = new QPushButton("Export Turntable");
+  buttonExportLod = new QPushButton("Export LOD");
+  buttonExportLarge = new QPushButton("Export Hi-Res");
+  saveBmpCheck = new QCheckBox("BMP");
+  saveBmpCheck->setChecked(true);
+  saveJpegCheck = new QCheckBox("JPEG");
+  saveJpegCheck->setChecked(true);
+  savePngCheck = new QCheckBox("PNG");
+  saveWebpCheck = new QCheckBox("WebP");
+  // WebP пишется только при наличии плагина imageformats
+  saveWebpCheck->setEnabled(
+      QImageWriter::supportedImageFormats().contains("webp"));
 }
 
 /**
@@ -455,6 +2742,12 @@ void MainWindow::initializeLayouts(QFont font) {
   manageLayout->addLayout(layoutFacetSetngs);
   manageLayout->addLayout(layoutVerticeSetngs);
   manageLayout->addLayout(layoutProjections);
+  manageLayout->addWidget(lodBudgetInput);
+  lodBudgetInput->setFont(font);
+  manageLayout->addWidget(subPixelInput);
+  subPixelInput->setFont(font);
+  manageLayout->addWidget(progressiveCheck);
+  progressiveCheck->setFont(font);
 }
 
 /**
@@ -466,6 +2759,8 @@ void MainWindow::initializeLayouts(QFont font) {
 void MainWindow::initializeButtonLayout(QFont font) {
   buttonLayout->addWidget(buttonDefault);
   buttonDefault->setFont(font);
+  buttonLayout->addWidget(buttonUndo);
+  buttonLayout->addWidget(buttonRedo);
   translateXLayout = new QVBoxLayout();
   translateXLayout->addWidget(buttonTranslateX_p);
   translateXLayout->addWidget(buttonTranslateX_m);
@@ -504,8 +2799,23 @@ void MainWindow::initializeButtonLayout(QFont font) {
   layoutSave = new QVBoxLayout();
   layoutSave->addWidget(buttonSaveImage);
   buttonSaveImage->setFont(font);
-  layoutSave->addWidget(buttonRecordGif);
-  buttonRecordGif->setFont(font);
+  QHBoxLayout *layoutFormats = new QHBoxLayout();
+  for (QCheckBox *check :
+       {saveBmpCheck, saveJpegCheck, savePngCheck, saveWebpCheck}) {
+    layoutFormats->addWidget(check);
+    check->setFont(font);
+  }
+  layoutSave->addLayout(layoutFormats);
+  layoutSave->addWidget(buttonRecord);
+  buttonRecord->setFont(font);
+  layoutSave->addWidget(gifSettingsInput);
+  gifSettingsInput->setFont(font);
+  layoutSave->addWidget(buttonTurntable);
+  buttonTurntable->setFont(font);
+  layoutSave->addWidget(buttonExportLod);
+  buttonExportLod->setFont(font);
+  layoutSave->addWidget(buttonExportLarge);
+  buttonExportLarge->setFont(font);
   buttonLayout->addLayout(layoutSave);
 }
 
@@ -550,6 +2860,12 @@ void MainWindow::initializeConnections() {
           [this]() { scale(scaleInput, scaleMinus); });
   connect(buttonDefault, &QPushButton::clicked, this,
           &MainWindow::defaultModel);
+  connect(buttonUndo, &QPushButton::clicked, this, &MainWindow::undoCommand);
+  connect(buttonRedo, &QPushButton::clicked, this, &MainWindow::redoCommand);
+  QShortcut *undoShortcut = new QShortcut(QKeySequence::Undo, this);
+  connect(undoShortcut, &QShortcut::activated, this, &MainWindow::undoCommand);
+  QShortcut *redoShortcut = new QShortcut(QKeySequence::Redo, this);
+  connect(redoShortcut, &QShortcut::activated, this, &MainWindow::redoCommand);
 }
 
 /**
@@ -587,7 +2903,22 @@ void MainWindow::initializeConnections2() {
           &MainWindow::changeBackGroundColor);
   // Подключение методов 3 пункт
   connect(buttonSaveImage, &QPushButton::clicked, this, &MainWindow::saveImage);
-  connect(buttonRecordGif, &QPushButton::clicked, this, &MainWindow::recordGif);
+  connect(buttonRecord, &QPushButton::clicked, this,
+          &MainWindow::toggleRecording);
+  recordingTimer.setSingleShot(true);
+  connect(&recordingTimer, &QTimer::timeout, this,
+          &MainWindow::finishRecording);
+  connect(buttonTurntable, &QPushButton::clicked, this,
+          &MainWindow::exportTurntable);
+  connect(lodBudgetInput, &QLineEdit::editingFinished, this,
+          &MainWindow::setLodBudget);
+  connect(subPixelInput, &QLineEdit::editingFinished, this,
+          &MainWindow::setSubPixelThreshold);
+  connect(progressiveCheck, &QCheckBox::toggled, openGL_widget,
+          &OpenGLWidget::setProgressiveRendering);
+  connect(buttonExportLod, &QPushButton::clicked, this, &MainWindow::exportLod);
+  connect(buttonExportLarge, &QPushButton::clicked, this,
+          &MainWindow::exportLargeImage);
 }
 
 /**
@@ -598,6 +2929,7 @@ void MainWindow::initializeConnections2() {
  * память.
  */
 MainWindow::~MainWindow() {
+  if (captureRing) stopRecording();
   delete openGL_widget;
   delete groupVertices;
   delete groupProjection;
@@ -614,70 +2946,395 @@ MainWindow::~MainWindow() {
 }
 
 /**
- * @brief Сохраняет изображение с OpenGL-виджета в BMP и JPEG.
+ * @brief Применяет введенный бюджет ребер упрощенной модели.
+ *
+ * @details Бюджет ограничивает число ребер, рисуемых во время вращения
+ * мышью. Некорректный ввод заменяется текущим значением.
+ */
+void MainWindow::setLodBudget() {
+  bool ok = false;
+  qulonglong budget = lodBudgetInput->text().toULongLong(&ok);
+  if (ok)
+    openGL_widget->setLodBudget(static_cast<size_t>(budget));
+  else
+    lodBudgetInput->setText(QString::number(openGL_widget->lodBudget()));
+}
+
+/**
+ * @brief Применяет введенный порог отсечения коротких ребер.
+ *
+ * @details Ребра, проекция которых короче порога в пикселях, не рисуются;
+ * значение 0 отключает отсечение. Некорректный ввод сбрасывается в 0.
+ */
+void MainWindow::setSubPixelThreshold() {
+  bool ok = false;
+  float pixels = subPixelInput->text().toFloat(&ok);
+  if (!ok || pixels <= 0.0f) {
+    subPixelInput->setText("0");
+    openGL_widget->setSubPixelCulling(false);
+    return;
+  }
+  openGL_widget->setSubPixelThreshold(pixels);
+  openGL_widget->setSubPixelCulling(true);
+}
+
+/**
+ * @brief Сохраняет выбранный уровень детализации в файл OBJ.
+ *
+ * @details Уровни строятся в фоне после загрузки модели; если они еще не
+ * готовы или модель слишком мала для упрощения, выводится сообщение.
+ */
+void MainWindow::exportLod() {
+  const std::vector<LodLevel_t> &chain = viewer_controller->modelGetLodChain();
+  if (chain.empty()) {
+    QMessageBox::information(this, "Export LOD",
+                             "Simplified levels are not available yet");
+    return;
+  }
+  bool ok = false;
+  int level = QInputDialog::getInt(
+      this, "Export LOD", "Level (0 - most detailed)", 0, 0,
+      static_cast<int>(chain.size()) - 1, 1, &ok);
+  if (!ok) return;
+  QString filePath = QFileDialog::getSaveFileName(this, "Save OBJ File", "",
+                                                  "OBJ Files (*.obj)");
+  if (filePath.isEmpty()) return;
+  if (!viewer_controller->modelExportLodLevel(static_cast<size_t>(level),
+                                              filePath))
+    QMessageBox::warning(this, "Export LOD", "Failed to write " + filePath);
+}
+
+/**
+ * @brief Сохраняет текущий вид в BMP большого размера.
+ *
+ * @details Ширина выбирается пользователем (по умолчанию 8K), высота
+ * берется по пропорциям окна, вершины увеличиваются вместе с кадром.
+ * Кадр рисуется плитками и записывается в файл по полосам, поэтому
+ * размер кадра не ограничен размером окна и памятью. Запись выполняется
+ * фоновой задачей с копией модели, интерфейс не блокируется; о
+ * завершении сообщается в строке состояния.
+ */
+void MainWindow::exportLargeImage() {
+  bool ok = false;
+  int width = QInputDialog::getInt(this, "Export Hi-Res", "Width in pixels",
+                                   7680, 1, 65536, 1, &ok);
+  if (!ok) return;
+  QString filePath = QFileDialog::getSaveFileName(this, "Save BMP File", "",
+                                                  "BMP Files (*.bmp)");
+  if (filePath.isEmpty()) return;
+  int height = std::max(1, static_cast<int>(std::lround(
+                               static_cast<double>(width) *
+                               openGL_widget->height() /
+                               std::max(1, openGL_widget->width()))));
+  QElapsedTimer timer;
+  timer.start();
+  buttonExportLarge->setEnabled(false);
+  largeExports.start(
+      OffscreenRenderer::tiledExport(viewer_controller, filePath,
+                                     QSize(width, height),
+                                     openGL_widget->height()),
+      [this, filePath, width, height, timer](bool written) {
+        buttonExportLarge->setEnabled(true);
+        if (!written) {
+          statusBar()->clearMessage();
+          QMessageBox::critical(this, "Error", "Failed to write " + filePath);
+          return;
+        }
+        statusBar()->showMessage(QString("%1x%2 image rendered in %3 ms.")
+                                     .arg(width)
+                                     .arg(height)
+                                     .arg(timer.elapsed()));
+      });
+  statusBar()->showMessage("Exporting " + QFileInfo(filePath).fileName() +
+                           "...");
+}
+
+/**
+ * @brief Загружает модель и сравнивает время кадра разных путей отрисовки.
+ *
+ * @param filePath Путь к файлу OBJ.
+ * @param frames Число кадров для каждого пути.
+ * @return Среднее время кадра для каждого пути.
+ */
+RenderBenchmark_t MainWindow::benchmarkRendering(const QString &filePath,
+                                                 int frames) {
+  flushCommands();
+  viewer_controller->Model_loadOBJ(filePath);
+  history.clear();
+  label->setText(QString("file:\n%1\n\nvertices:\n%2\n\nfacets:\n%3")
+                     .arg(filePath)
+                     .arg(viewer_controller->modelGetVertices().size())
+                     .arg(viewer_controller->modelGetFacets().size()));
+  return openGL_widget->benchmark(frames);
+}
+
+/**
+ * @brief Пути файлов изображения для выбранных форматов.
+ *
+ * @param basePath Имя файла без расширения; расширение одного из форматов,
+ * введенное пользователем, отбрасывается.
+ * @param formats Форматы QImageWriter (BMP, JPEG, PNG, WEBP).
+ * @return Пути в порядке formats; для неизвестного формата расширением
+ * служит его имя.
+ */
+QStringList MainWindow::imageSavePaths(QString basePath,
+                                       const QStringList &formats) {
+  static const std::map<QString, QString> suffixes = {{"BMP", ".bmp"},
+                                                      {"JPEG", ".jpg"},
+                                                      {"PNG", ".png"},
+                                                      {"WEBP", ".webp"}};
+  QString suffix = "." + QFileInfo(basePath).suffix().toLower();
+  for (const auto &entry : suffixes)
+    if (suffix == entry.second) basePath.chop(suffix.size());
+  QStringList paths;
+  for (const QString &format : formats) {
+    auto entry = suffixes.find(format);
+    paths << basePath + (entry != suffixes.end() ? entry->second
+                                                 : "." + format.toLower());
+  }
+  return paths;
+}
+
+/**
+ * @brief Сохраняет изображение с OpenGL-виджета в отмеченных форматах.
  *
  * @param Нет параметров.
- * @details Позволяет пользователю выбрать путь сохранения файлов.
- * В случае успешного сохранения изображение записывается в указанном формате.
+ * @details Пользователь выбирает имя файла без расширения, расширение
+ * добавляется для каждого отмеченного формата (BMP, JPEG, PNG, WebP).
+ * Форматы кодируются одновременно фоновыми задачами окна, интерфейс не
+ * блокируется; о завершении сообщается в строке состояния. Все задачи
+ * получают копию QImage, которая разделяет данные кадра (implicit
+ * sharing), поэтому пиксели не копируются.
  */
 void MainWindow::saveImage() {
   QImage image = openGL_widget->grabFramebuffer();
-  QString bmpFilePath = QFileDialog::getSaveFileName(this, "Save BMP File", "",
-                                                     "BMP Files (*.bmp)");
-  if (!bmpFilePath.isEmpty()) {
-    image.save(bmpFilePath, "BMP");
+  struct {
+    QCheckBox *check;
+    const char *format;
+  } checks[] = {{saveBmpCheck, "BMP"},
+                {saveJpegCheck, "JPEG"},
+                {savePngCheck, "PNG"},
+                {saveWebpCheck, "WEBP"}};
+  QStringList formats;
+  for (const auto &entry : checks)
+    if (entry.check->isEnabled() && entry.check->isChecked())
+      formats << entry.format;
+  if (formats.isEmpty()) {
+    statusBar()->showMessage("No image format selected", 3000);
+    return;
+  }
+  QString basePath = QFileDialog::getSaveFileName(this, "Save Image", "",
+                                                  "Image base name (*)");
+  if (basePath.isEmpty()) return;
+  QStringList paths = imageSavePaths(basePath, formats);
+  for (int i = 0; i < paths.size(); ++i) {
+    QString filePath = paths[i];
+    QByteArray format = formats[i].toLatin1();
+    imageSaves.start(
+        [image, filePath, format]() {
+          return image.save(filePath, format.constData());
+        },
+        [this, filePath](bool saved) {
+          QString message = (saved ? "Saved " : "Failed to write ") + filePath;
+          if (imageSaves.pending() > 0)
+            message += QString(", %1 left").arg(imageSaves.pending());
+          statusBar()->showMessage(message, 5000);
+        });
+  }
+  statusBar()->showMessage(
+      QString("Saving %1 image(s)...").arg(imageSaves.pending()));
+}
+
+/**
+ * @brief Начинает или останавливает запись окна в GIF или видео.
+ *
+ * @param Нет параметров.
+ * @details Размер и частота кадров берутся из поля настроек (по умолчанию
+ * 640x480@10), формат - из расширения файла: GIF, несжатое видео Y4M или
+ * MJPEG в AVI. Кадры снимаются виджетом по таймеру, не останавливая
+ * интерфейс; отдельный поток передает их из кольцевого буфера записи.
+ * GIF записывается 5 секунд, видео - до повторного нажатия кнопки или
+ * до предела размера файла.
+ */
+void MainWindow::toggleRecording() {
+  if (captureRing) {
+    finishRecording();
+    return;
+  }
+  QSize size;
+  int fps = 0;
+  if (!readGifSettings(size, fps)) return;
+  QString filter;
+  QString filePath = QFileDialog::getSaveFileName(
+      this, "Save Recording", "",
+      "GIF Files (*.gif);;Y4M Video (*.y4m);;MJPEG AVI (*.avi)", &filter);
+  if (filePath.isEmpty()) return;
+  QString suffix = QFileInfo(filePath).suffix().toLower();
+  if (suffix != "gif" && suffix != "y4m" && suffix != "avi") {
+    suffix = filter.startsWith("Y4M")   ? "y4m"
+             : filter.startsWith("MJPEG") ? "avi"
+                                          : "gif";
+    filePath += "." + suffix;
   }
-  QString jpegFilePath = QFileDialog::getSaveFileName(this, "Save JPEG File",
-                                                      "", "JPEG Files (*.jpg)");
-  if (!jpegFilePath.isEmpty()) {
-    image.save(jpegFilePath, "JPEG");
+
+  if (suffix == "y4m")
+    recorder = std::make_unique<Y4mStreamWriter>();
+  else if (suffix == "avi")
+    recorder = std::make_unique<MjpegAviWriter>();
+  else
+    recorder = std::make_unique<GifStreamWriter>();
+  if (!recorder->open(filePath, size, fps)) {
+    recorder.reset();
+    QMessageBox::critical(this, "Error", "Failed to create " + filePath);
+    return;
+  }
+  // буфер вмещает около секунды записи, если кодировщик не успевает
+  captureRing = std::make_unique<FrameRing>(static_cast<size_t>(fps));
+  captureDrain = std::thread([this, ring = captureRing.get(),
+                              sink = recorder.get()]() {
+    QImage frame;
+    bool reported = false;
+    while (ring->pop(frame)) {
+      sink->push(frame);
+      if (reported || !sink->full()) continue;
+      // поток присоединяется в stopRecording до удаления окна; вызов от
+      // прошлой записи отсеивается проверкой full у нового приемника
+      reported = true;
+      QMetaObject::invokeMethod(
+          this,
+          [this]() {
+            if (captureRing && recorder->full()) finishRecording();
+          },
+          Qt::QueuedConnection);
+    }
+  });
+  recordingPath = filePath;
+  buttonRecord->setText("Stop Recording");
+  openGL_widget->startCapture(captureRing.get(), fps);
+  if (suffix == "gif") {
+    const int seconds = 5;
+    recordingTimer.start(seconds * 1000);
+  }
+  statusBar()->showMessage("Recording " + QFileInfo(filePath).fileName() +
+                           "...");
+}
+
+/**
+ * @brief Читает размер и частоту кадров GIF из поля настроек.
+ *
+ * @param size Размер кадра.
+ * @param fps Частота кадров.
+ * @return false, если настройки некорректны (выводится сообщение).
+ */
+bool MainWindow::readGifSettings(QSize &size, int &fps) {
+  static const QRegularExpression settingsFormat(
+      "^\\s*(\\d+)\\s*[xX]\\s*(\\d+)\\s*@\\s*(\\d+)\\s*$");
+  QRegularExpressionMatch settings =
+      settingsFormat.match(gifSettingsInput->text());
+  size = QSize(640, 480);
+  fps = 10;
+  if (settings.hasMatch()) {
+    size = QSize(settings.captured(1).toInt(), settings.captured(2).toInt());
+    fps = settings.captured(3).toInt();
+  }
+  if (size.isEmpty() || fps <= 0 || fps > 100) {
+    QMessageBox::critical(this, "Error",
+                          "GIF settings must look like 640x480@10.");
+    return false;
   }
+  return true;
+}
+
+/**
+ * @brief Записывает GIF с полным оборотом модели вокруг выбранной оси.
+ *
+ * @param Нет параметров.
+ * @details Размер и частота кадров берутся из поля настроек GIF, число
+ * кадров и ось запрашиваются в диалогах. Кадры рисуются без окна,
+ * параллельно, поэтому запись идет быстрее реального времени. Запись
+ * выполняется фоновой задачей с копией модели, интерфейс не блокируется;
+ * о завершении сообщается в строке состояния.
+ */
+void MainWindow::exportTurntable() {
+  TurntableSettings_t settings;
+  if (!readGifSettings(settings.size, settings.fps)) return;
+  bool ok = false;
+  settings.frames =
+      QInputDialog::getInt(this, "Export Turntable", "Frames per turn:",
+                           settings.frames, 1, 3600, 1, &ok);
+  if (!ok) return;
+  QString axis = QInputDialog::getItem(this, "Export Turntable",
+                                       "Rotation axis:", {"Y", "X", "Z"}, 0,
+                                       false, &ok);
+  if (!ok) return;
+  settings.axis = axis == "X" ? AxisX : axis == "Z" ? AxisZ : AxisY;
+  QString filePath = QFileDialog::getSaveFileName(
+      this, "Save Turntable", "", "GIF Files (*.gif)");
+  if (filePath.isEmpty()) return;
+  QElapsedTimer timer;
+  timer.start();
+  buttonTurntable->setEnabled(false);
+  turntableExports.start(
+      OffscreenRenderer::turntableExport(viewer_controller, filePath, settings),
+      [this, filePath, frames = settings.frames, timer](bool written) {
+        buttonTurntable->setEnabled(true);
+        if (!written) {
+          statusBar()->clearMessage();
+          QMessageBox::critical(this, "Error", "Failed to write " + filePath);
+          return;
+        }
+        statusBar()->showMessage(
+            QString("%1 frames rendered and encoded in %2 ms.")
+                .arg(frames)
+                .arg(timer.elapsed()));
+      });
+  statusBar()->showMessage("Exporting " + QFileInfo(filePath).fileName() +
+                           "...");
 }
 
 /**
- * @brief Записывает анимацию в формате GIF.
+ * @brief Завершает запись и сообщает о результате.
  *
  * @param Нет параметров.
- * @details Делает 50 кадров с задержкой 100 мс и создает GIF с помощью FFmpeg.
- * Если FFmpeg не удается запустить, выводит сообщение об ошибке.
- */
-void MainWindow::recordGif() {
-  QString gifFilePath = QFileDialog::getSaveFileName(this, "Save GIF File", "",
-                                                     "GIF Files (*.gif)");
-  QFileInfo gifFileInfo(gifFilePath);
-  QString gifDir = gifFileInfo.absoluteDir().absolutePath();
-  QString gifFileName = gifFileInfo.baseName();
-  QString framesDir = gifDir + "/" + gifFileName + "_frames";
-  QDir().mkpath(framesDir);
-
-  for (int i = 0; i < 50; ++i) {
-    QImage frame = openGL_widget->grabFramebuffer();
-    QString frameFilePath =
-        framesDir + QString("/frame%1.bmp").arg(i, 4, 10, QLatin1Char('0'));
-    frame.save(frameFilePath, "BMP");
-    QCoreApplication::processEvents();
-    QThread::msleep(100);
-  }
-  QStringList ffmpegArgs;
-  ffmpegArgs << "-y" << "-framerate" << "10" << "-i"
-             << QString("%1/frame%04d.bmp").arg(framesDir) << "-vf"
-             << "scale=640:480" << "-loop" << "0" << gifFilePath;
-  QProcess ffmpegProcess;
-  ffmpegProcess.setProcessChannelMode(QProcess::MergedChannels);
-  ffmpegProcess.start("ffmpeg", ffmpegArgs);
-  if (!ffmpegProcess.waitForStarted()) {
-    QMessageBox::critical(
-        this, "Error",
-        "Failed to start ffmpeg process: " + ffmpegProcess.errorString());
-  }
-  ffmpegProcess.waitForFinished();
-  if (ffmpegProcess.exitCode() != 0) {
-    QString errorOutput = ffmpegProcess.readAllStandardError();
-    QMessageBox::critical(this, "Error", "FFmpeg failed:\n" + errorOutput);
+ * @details Вместе с сообщением выводятся число потерянных кадров, размер
+ * файла, суммарное время кодирования и остановка по пределу размера.
+ */
+void MainWindow::finishRecording() {
+  if (!captureRing) return;
+  bool written = stopRecording();
+  const FrameStats_t &stats = openGL_widget->frameStats();
+  QString summary =
+      QString("%1 frames captured, %2 dropped. %3 KB, encoded in %4 ms.")
+          .arg(stats.capturedFrames)
+          .arg(stats.droppedFrames)
+          .arg(recorder->bytesWritten() / 1024.0, 0, 'f', 1)
+          .arg(recorder->encodeMilliseconds(), 0, 'f', 0);
+  if (written && recorder->full())
+    summary += "\nThe file size limit was reached, recording was stopped.";
+  recorder.reset();
+  statusBar()->showMessage(summary);
+  if (!written) {
+    QMessageBox::critical(this, "Error", "Failed to write " + recordingPath);
     return;
   }
-  QMessageBox::information(this, "Success", "GIF saved successfully.");
-  QDir(framesDir).removeRecursively();
+  QMessageBox::information(this, "Success",
+                           "Recording saved successfully.\n" + summary);
+}
+
+/**
+ * @brief Останавливает захват и дожидается записи всех кадров.
+ *
+ * @return true, если файл записан полностью.
+ */
+bool MainWindow::stopRecording() {
+  recordingTimer.stop();
+  openGL_widget->stopCapture();
+  captureRing->close();
+  captureDrain.join();
+  bool written = recorder->finish();
+  captureRing.reset();
+  buttonRecord->setText("Record");
+  return written;
 }
 
 /**
@@ -690,42 +3347,166 @@ void MainWindow::recordGif() {
 void MainWindow::fileOpenButton() {
   QString file_name = QFileDialog::getOpenFileName(this, "Choose OBJ File", "",
                                                    "OBJ Files (*.obj)");
+  flushCommands();
   viewer_controller->Model_loadOBJ(file_name);
+  history.clear();
   label->setText(QString("file:\n%1\n\nvertices:\n%2\n\nfacets:\n%3")
                      .arg(file_name)
                      .arg(viewer_controller->modelGetVertices().size())
                      .arg(viewer_controller->modelGetFacets().size()));
-  openGL_widget->update();
+  openGL_widget->requestUpdate();
 };
 
+/**
+ * @brief Объединение команды со следующей командой того же вида.
+ *
+ * По умолчанию команды не объединяются.
+ *
+ * @param next Следующая команда в очереди.
+ * @return true, если next поглощена этой командой и выполнять ее не нужно.
+ */
+bool Command::mergeWith(const Command &next) {
+  (void)next;
+  return false;
+}
+
+/**
+ * @brief Ось действия перемещения или вращения.
+ *
+ * Действия перечислены парами "плюс, минус" для каждой из осей X, Y, Z.
+ */
+static int actionAxis(int action) { return action / 2; }
+
+/**
+ * @brief Значение действия со знаком направления.
+ */
+static float signedActionValue(int action, float value) {
+  return action % 2 == 0 ? value : -value;
+}
+
+/**
+ * @brief Действие, противоположное по направлению (пары "плюс, минус").
+ */
+static int oppositeAction(int action) { return action ^ 1; }
+
 /**
  * @brief Класс команды перемещения модели.
  *
  * @param controller Контроллер модели.
- * @param value Величина сдвига.
+ * @param value Величина сдвига (0 - шаг по умолчанию).
  * @param translateAction Направление сдвига.
  * @details Выполняет перемещение модели по выбранной оси на заданное
  * расстояние.
  */
 TranslateCommand::TranslateCommand(ViewerController *controller, float value,
                                    translateAction_t translateAction)
-    : controller_(controller), value(value), trAction(translateAction) {}
+    : controller_(controller),
+      value(value == 0.0f ? ViewerModel::kDefaultTranslateStep : value),
+      trAction(translateAction) {}
 void TranslateCommand::execute() {
+  if (value == 0.0f) return;  // взаимно погашенные сдвиги
   controller_->modelTranslateFigure(trAction, value);
 }
+void TranslateCommand::undo() {
+  if (value == 0.0f) return;
+  controller_->modelTranslateFigure(
+      static_cast<translateAction_t>(oppositeAction(trAction)), value);
+}
+
+/**
+ * @brief Суммирование сдвигов по одной оси.
+ *
+ * @param next Следующая команда в очереди.
+ * @return true, если next - сдвиг по той же оси.
+ */
+bool TranslateCommand::mergeWith(const Command &next) {
+  const auto *other = dynamic_cast<const TranslateCommand *>(&next);
+  if (!other || other->controller_ != controller_ ||
+      actionAxis(other->trAction) != actionAxis(trAction))
+    return false;
+  float sum = signedActionValue(trAction, value) +
+              signedActionValue(other->trAction, other->value);
+  trAction = static_cast<translateAction_t>(actionAxis(trAction) * 2 +
+                                            (sum < 0.0f ? 1 : 0));
+  value = std::abs(sum);
+  return true;
+}
 
 /**
  * @brief Класс команды вращения модели.
  *
  * @param controller Контроллер модели.
- * @param value Угол поворота.
+ * @param value Угол поворота (0 - шаг по умолчанию).
  * @param rotateAction Ось вращения.
  * @details Выполняет вращение модели вокруг указанной оси.
  */
 RotateCommand::RotateCommand(ViewerController *controller, float value,
                              rotateAction_t rotateAction)
-    : controller_(controller), value(value), rtAction(rotateAction) {}
-void RotateCommand::execute() { controller_->modelRotateAxis(rtAction, value); }
+    : controller_(controller),
+      value(value == 0.0f ? ViewerModel::kDefaultRotateStep : value),
+      rtAction(rotateAction) {}
+void RotateCommand::execute() {
+  if (value == 0.0f) return;  // взаимно погашенные повороты
+  controller_->modelRotateAxis(rtAction, value);
+}
+void RotateCommand::undo() {
+  if (value == 0.0f) return;
+  controller_->modelRotateAxis(
+      static_cast<rotateAction_t>(oppositeAction(rtAction)), value);
+}
+
+/**
+ * @brief Суммирование поворотов вокруг одной оси.
+ *
+ * Повороты вокруг одной оси перестановочны, поэтому сумма углов дает тот же
+ * результат, что и последовательное выполнение.
+ *
+ * @param next Следующая команда в очереди.
+ * @return true, если next - поворот вокруг той же оси.
+ */
+bool RotateCommand::mergeWith(const Command &next) {
+  const auto *other = dynamic_cast<const RotateCommand *>(&next);
+  if (!other || other->controller_ != controller_ ||
+      actionAxis(other->rtAction) != actionAxis(rtAction))
+    return false;
+  float sum = signedActionValue(rtAction, value) +
+              signedActionValue(other->rtAction, other->value);
+  rtAction = static_cast<rotateAction_t>(actionAxis(rtAction) * 2 +
+                                         (sum < 0.0f ? 1 : 0));
+  value = std::abs(sum);
+  return true;
+}
+
+/**
+ * @brief Класс команды вращения мышью.
+ *
+ * @param controller Контроллер модели.
+ * @param rotation Приращение поворота в экранных осях.
+ * @param angles Приращение углов rotateAngleX/Y/Z, которое накапливается
+ * так же, как при вращении кнопками.
+ */
+MouseRotateCommand::MouseRotateCommand(ViewerController *controller,
+                                       const QQuaternion &rotation,
+                                       const QVector3D &angles)
+    : controller_(controller), rotation_(rotation), angles_(angles) {}
+void MouseRotateCommand::execute() {
+  controller_->modelApplyRotation(rotation_, angles_);
+}
+void MouseRotateCommand::undo() {
+  controller_->modelApplyRotation(rotation_.conjugated(), -angles_);
+}
+
+/**
+ * @brief Композиция поворотов: следующий поворот применяется после текущего,
+ * приращения углов складываются.
+ */
+bool MouseRotateCommand::mergeWith(const Command &next) {
+  const auto *other = dynamic_cast<const MouseRotateCommand *>(&next);
+  if (!other || other->controller_ != controller_) return false;
+  rotation_ = (other->rotation_ * rotation_).normalized();
+  angles_ += other->angles_;
+  return true;
+}
 
 /**
  * @brief Класс команды масштабирования модели.
@@ -733,12 +3514,56 @@ void RotateCommand::execute() { controller_->modelRotateAxis(rtAction, value); }
  * @param controller Контроллер модели.
  * @param scaleValue Коэффициент масштабирования.
  * @param scaleF Тип масштабирования.
+ * @param steps Число повторений шага (например, щелчков колесика).
  * @details Изменяет размер модели в соответствии с указанным коэффициентом.
+ * Запоминает фактическое изменение масштаба и угла обзора с учетом
+ * ограничений, чтобы отмена вернула модель точно в исходное состояние.
  */
 ScaleCommand::ScaleCommand(ViewerController *controller, float scaleValue,
-                           const ScaleType_t &scaleF)
-    : controller_(controller), sclValue(scaleValue), sclF(scaleF) {}
-void ScaleCommand::execute() { controller_->modelScaleFigure(sclF, sclValue); }
+                           const ScaleType_t &scaleF, int steps)
+    : controller_(controller),
+      sclValue(scaleValue),
+      sclF(scaleF),
+      steps_(steps) {}
+void ScaleCommand::execute() {
+  AffineTransform_t before = controller_->modelGetAffineTransform();
+  for (int i = 0; i < steps_; ++i)
+    controller_->modelScaleFigure(sclF, sclValue);
+  AffineTransform_t after = controller_->modelGetAffineTransform();
+  scaleDelta = after.scaleFactor - before.scaleFactor;
+  fovDelta = after.fov - before.fov;
+}
+void ScaleCommand::undo() {
+  controller_->modelAdjustScale(-scaleDelta, -fovDelta);
+}
+
+/**
+ * @brief Объединение масштабирований в одном направлении.
+ *
+ * Масштаб ограничен сверху и снизу, поэтому объединяются только шаги одного
+ * направления: одинаковые шаги (в том числе шаг по умолчанию, зависящий от
+ * проекции) складываются в число повторений, разные явные значения
+ * суммируются. Фактические изменения уже выполненных команд складываются.
+ *
+ * @param next Следующая команда.
+ * @return true, если next поглощена этой командой.
+ */
+bool ScaleCommand::mergeWith(const Command &next) {
+  const auto *other = dynamic_cast<const ScaleCommand *>(&next);
+  if (!other || other->controller_ != controller_ || other->sclF != sclF)
+    return false;
+  if (other->sclValue == sclValue) {
+    steps_ += other->steps_;
+  } else if (sclValue != 0.0f && other->sclValue != 0.0f && steps_ == 1 &&
+             other->steps_ == 1) {
+    sclValue += other->sclValue;
+  } else {
+    return false;
+  }
+  scaleDelta += other->scaleDelta;
+  fovDelta += other->fovDelta;
+  return true;
+}
 
 /**
  * @brief Класс команды изменения цвета граней модели.
@@ -751,8 +3576,22 @@ ChangeFacetColorCommand::ChangeFacetColorCommand(ViewerController *controller,
                                                  QColor color)
     : controller_(controller), color_(color) {}
 void ChangeFacetColorCommand::execute() {
+  previousColor_ = controller_->modelGetModelDefinition().facetColor;
   controller_->modelSetFacetColor(color_);
 }
+void ChangeFacetColorCommand::undo() {
+  controller_->modelSetFacetColor(previousColor_);
+}
+
+/**
+ * @brief Из нескольких подряд идущих цветов граней остается последний.
+ */
+bool ChangeFacetColorCommand::mergeWith(const Command &next) {
+  const auto *other = dynamic_cast<const ChangeFacetColorCommand *>(&next);
+  if (!other || other->controller_ != controller_) return false;
+  color_ = other->color_;
+  return true;
+}
 
 /**
  * @brief Класс команды изменения толщины граней модели.
@@ -765,7 +3604,13 @@ ChangeFacetWidthCommand::ChangeFacetWidthCommand(ViewerController *controller,
                                                  ScaleType_t scaleType)
     : controller_(controller), scaleType_(scaleType) {}
 void ChangeFacetWidthCommand::execute() {
+  float before = controller_->modelGetModelDefinition().facetWidth;
   controller_->modelSetFacetWidth(scaleType_);
+  widthDelta = controller_->modelGetModelDefinition().facetWidth - before;
+}
+void ChangeFacetWidthCommand::undo() {
+  controller_->modelSetFacetWidthValue(
+      controller_->modelGetModelDefinition().facetWidth - widthDelta);
 }
 
 /**
@@ -778,8 +3623,22 @@ ChangeVerticeColorCommand::ChangeVerticeColorCommand(
     ViewerController *controller, QColor color)
     : controller_(controller), color_(color) {}
 void ChangeVerticeColorCommand::execute() {
+  previousColor_ = controller_->modelGetModelDefinition().verticeColor;
   controller_->modelSetVerticeColor(color_);
 }
+void ChangeVerticeColorCommand::undo() {
+  controller_->modelSetVerticeColor(previousColor_);
+}
+
+/**
+ * @brief Из нескольких подряд идущих цветов вершин остается последний.
+ */
+bool ChangeVerticeColorCommand::mergeWith(const Command &next) {
+  const auto *other = dynamic_cast<const ChangeVerticeColorCommand *>(&next);
+  if (!other || other->controller_ != controller_) return false;
+  color_ = other->color_;
+  return true;
+}
 
 /**
  * @brief Выполняет команду изменения толщины вершин.
@@ -788,9 +3647,168 @@ ChangeVerticeWidthCommand::ChangeVerticeWidthCommand(
     ViewerController *controller, ScaleType_t scaleType)
     : controller_(controller), scaleType_(scaleType) {}
 void ChangeVerticeWidthCommand::execute() {
+  float before = controller_->modelGetModelDefinition().verticeWidth;
   controller_->modelSetVerticeWidth(scaleType_);
+  widthDelta = controller_->modelGetModelDefinition().verticeWidth - before;
+}
+void ChangeVerticeWidthCommand::undo() {
+  controller_->modelSetVerticeWidthValue(
+      controller_->modelGetModelDefinition().verticeWidth - widthDelta);
+}
+
+/**
+ * @brief Класс команды смены типа проекции.
+ *
+ * @param controller Контроллер модели.
+ * @param projectionType Новый тип проекции.
+ */
+ChangeProjectionCommand::ChangeProjectionCommand(
+    ViewerController *controller, ProjectionType_t projectionType)
+    : controller_(controller), projectionType_(projectionType) {}
+void ChangeProjectionCommand::execute() {
+  previousType_ = controller_->modelGetAffineTransform().projectionType;
+  controller_->modelSetProjection(projectionType_);
+}
+void ChangeProjectionCommand::undo() {
+  controller_->modelSetProjection(previousType_);
+}
+
+/**
+ * @brief Класс команды смены типа вершин.
+ *
+ * @param controller Контроллер модели.
+ * @param verticeType Новый тип вершин.
+ */
+ChangeVerticeTypeCommand::ChangeVerticeTypeCommand(
+    ViewerController *controller, VerticeType_t verticeType)
+    : controller_(controller), verticeType_(verticeType) {}
+void ChangeVerticeTypeCommand::execute() {
+  previousType_ = controller_->modelGetModelDefinition().verticeType;
+  controller_->modelSetVerticeType(verticeType_);
+}
+void ChangeVerticeTypeCommand::undo() {
+  controller_->modelSetVerticeType(previousType_);
+}
+
+/**
+ * @brief Класс команды изменения цвета фона.
+ *
+ * @param controller Контроллер модели.
+ * @param color Новый цвет фона.
+ */
+ChangeBackgroundColorCommand::ChangeBackgroundColorCommand(
+    ViewerController *controller, QColor color)
+    : controller_(controller), color_(color) {}
+void ChangeBackgroundColorCommand::execute() {
+  previousColor_ = controller_->modelGetModelDefinition().backgroundColor;
+  controller_->modelSetBackGroundColor(color_);
+}
+void ChangeBackgroundColorCommand::undo() {
+  controller_->modelSetBackGroundColor(previousColor_);
+}
+
+/**
+ * @brief Из нескольких подряд идущих цветов фона остается последний.
+ */
+bool ChangeBackgroundColorCommand::mergeWith(const Command &next) {
+  const auto *other =
+      dynamic_cast<const ChangeBackgroundColorCommand *>(&next);
+  if (!other || other->controller_ != controller_) return false;
+  color_ = other->color_;
+  return true;
+}
+
+/**
+ * @brief Конструктор истории команд.
+ *
+ * @param capacity Максимальное число записей для отмены.
+ */
+CommandHistory::CommandHistory(std::size_t capacity) : capacity_(capacity) {}
+
+/**
+ * @brief Запись выполненной команды в историю.
+ *
+ * Во время взаимодействия команда сливается с последней записью, если это
+ * возможно. Новая команда делает повтор отмененных команд невозможным.
+ *
+ * @param command Выполненная команда.
+ */
+void CommandHistory::push(std::unique_ptr<Command> command) {
+  redoStack.clear();
+  if (interactionActive && interactionHasEntry && !undoStack.empty() &&
+      undoStack.back()->mergeWith(*command))
+    return;
+  undoStack.push_back(std::move(command));
+  interactionHasEntry = interactionActive;
+  if (undoStack.size() > capacity_) undoStack.pop_front();
+}
+
+/**
+ * @brief Отмена последней команды.
+ *
+ * @return true, если команда была отменена.
+ */
+bool CommandHistory::undo() {
+  if (undoStack.empty()) return false;
+  std::unique_ptr<Command> command = std::move(undoStack.back());
+  undoStack.pop_back();
+  command->undo();
+  redoStack.push_back(std::move(command));
+  interactionHasEntry = false;
+  return true;
+}
+
+/**
+ * @brief Повтор последней отмененной команды.
+ *
+ * @return true, если команда была выполнена повторно.
+ */
+bool CommandHistory::redo() {
+  if (redoStack.empty()) return false;
+  std::unique_ptr<Command> command = std::move(redoStack.back());
+  redoStack.pop_back();
+  command->execute();
+  undoStack.push_back(std::move(command));
+  interactionHasEntry = false;
+  return true;
+}
+
+/**
+ * @brief Очистка истории (например, после загрузки новой модели).
+ */
+void CommandHistory::clear() {
+  undoStack.clear();
+  redoStack.clear();
+  interactionHasEntry = false;
+}
+
+/**
+ * @brief Начало непрерывного взаимодействия: следующие команды сливаются в
+ * одну запись.
+ */
+void CommandHistory::beginInteraction() {
+  interactionActive = true;
+  interactionHasEntry = false;
 }
 
+/**
+ * @brief Завершение непрерывного взаимодействия.
+ */
+void CommandHistory::endInteraction() {
+  interactionActive = false;
+  interactionHasEntry = false;
+}
+
+/**
+ * @brief Идет ли непрерывное взаимодействие.
+ */
+bool CommandHistory::inInteraction() const { return interactionActive; }
+
+/**
+ * @brief Число записей, доступных для отмены.
+ */
+std::size_t CommandHistory::size() const { return undoStack.size(); }
+
 /**
  * @brief Выполняет команду трансформации (перемещения, вращения,
  * масштабирования).
@@ -807,8 +3825,7 @@ void MainWindow::executeTransformCommand(QLineEdit *input,
   auto command = std::make_unique<CommandType>(
       viewer_controller, viewer_controller->modelMakeFloat(inputText),
       direction);
-  command->execute();
-  openGL_widget->update();
+  executeCommand(std::move(command));
 }
 
 /**
@@ -843,13 +3860,56 @@ void MainWindow::scale(QLineEdit *input, ScaleType_t scaleType) {
 }
 
 /**
- * @brief Выполняет переданную команду и обновляет OpenGL-виджет.
+ * @brief Ставит команду в очередь текущего кадра.
+ *
+ * Команда объединяется с последней командой очереди, если они одного вида
+ * (например, сдвиги по одной оси суммируются). Очередь выполняется одним
+ * пакетом после обработки текущих событий.
  *
  * @param command Умный указатель на команду.
  */
 void MainWindow::executeCommand(std::unique_ptr<Command> command) {
-  command->execute();
-  openGL_widget->update();
+  if (!commandQueue.empty() && commandQueue.back()->mergeWith(*command)) return;
+  commandQueue.push_back(std::move(command));
+  if (!flushScheduled) {
+    flushScheduled = true;
+    QTimer::singleShot(0, this, &MainWindow::flushCommands);
+  }
+}
+
+/**
+ * @brief Выполняет накопленные команды пакетом и запрашивает одну
+ * перерисовку.
+ *
+ * Вызывается также перед действиями, которые меняют модель напрямую, чтобы
+ * сохранить порядок изменений.
+ */
+void MainWindow::flushCommands() {
+  flushScheduled = false;
+  if (commandQueue.empty()) return;
+  std::vector<std::unique_ptr<Command>> batch;
+  batch.swap(commandQueue);
+  for (auto &command : batch) {
+    command->execute();
+    history.push(std::move(command));
+  }
+  openGL_widget->requestUpdate();
+}
+
+/**
+ * @brief Отменяет последнюю команду.
+ */
+void MainWindow::undoCommand() {
+  flushCommands();
+  if (history.undo()) openGL_widget->requestUpdate();
+}
+
+/**
+ * @brief Повторяет последнюю отмененную команду.
+ */
+void MainWindow::redoCommand() {
+  flushCommands();
+  if (history.redo()) openGL_widget->requestUpdate();
 }
 
 /**
@@ -906,15 +3966,18 @@ void MainWindow::changeVerticeWidth(ScaleType_t scaleType) {
  * @param verticeType Тип вершин.
  */
 void MainWindow::typeVertice(const VerticeType_t &verticeType) {
-  viewer_controller->modelSetVerticeType(verticeType);
-  openGL_widget->update();
+  auto command = std::make_unique<ChangeVerticeTypeCommand>(viewer_controller,
+                                                            verticeType);
+  executeCommand(std::move(command));
 }
 
 /**
  * @brief Сбрасывает параметры модели в значения по умолчанию.
  */
 void MainWindow::defaultModel() {
+  flushCommands();
   viewer_controller->modelSetDefault(1);
+  history.clear();
   translateXInput->clear();
   translateYInput->clear();
   translateZInput->clear();
@@ -922,7 +3985,7 @@ void MainWindow::defaultModel() {
   rotateYInput->clear();
   rotateZInput->clear();
   scaleInput->clear();
-  openGL_widget->update();
+  openGL_widget->requestUpdate();
 }
 
 /**
@@ -931,8 +3994,9 @@ void MainWindow::defaultModel() {
  * @param projectionType Тип проекции.
  */
 void MainWindow::setProjection(const ProjectionType_t &projectionType) {
-  viewer_controller->modelSetProjection(projectionType);
-  openGL_widget->update();
+  auto command = std::make_unique<ChangeProjectionCommand>(viewer_controller,
+                                                           projectionType);
+  executeCommand(std::move(command));
 }
 
 /**
@@ -942,8 +4006,9 @@ void MainWindow::changeBackGroundColor() {
   QColor color =
       QColorDialog::getColor(currentBackGroundColor, this, "BackGround Color");
   if (color.isValid()) {
-    viewer_controller->modelSetBackGroundColor(color);
-    openGL_widget->update();
+    auto command = std::make_unique<ChangeBackgroundColorCommand>(
+        viewer_controller, color);
+    executeCommand(std::move(command));
   }
 }
 
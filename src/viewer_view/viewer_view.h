@@ -5,58 +5,204 @@
 
 namespace s21 {
 
+class RetainedRenderer;
+
 /**
- * @brief Класс, отвечающий за паттерн стратегия для выбора отрисовки в методе
- * OpenGLWidget::paintGL()
+ * @brief Данные кадра, общие для всех этапов отрисовки
  */
-class Draw {
- public:
-  virtual ~Draw() = default;
-  virtual void draw(const std::vector<unsigned int> &facets,
-                    const std::vector<QVector3D> &vertices,
-                    const ModelDefinition_t &modelDefinition) = 0;
-};
+typedef struct RenderFrame {
+  const std::vector<unsigned int> *facets = nullptr;
+  const std::vector<QVector3D> *vertices = nullptr;
+  const ModelDefinition_t *modelDefinition = nullptr;
+  ViewerController *controller = nullptr;
+  RetainedRenderer *retained = nullptr;
+  const std::vector<EdgeRange_t> *edgeRanges = nullptr;  // видимые ребра
+  const std::vector<unsigned int> *lodEdges = nullptr;  // упрощенные ребра
+  QMatrix4x4 mvp;
+  QSizeF viewport;
+  bool drawEdges = true;     // false - проход рисует только вершины
+  bool drawVertices = true;  // false - проход рисует только ребра
+} RenderFrame_t;
 
 /**
  * @brief Класс, отрисовывающий ребра с обычной толщиной
  */
-class DrawFacetZero : public Draw {
+class DrawFacetZero {
  public:
-  void draw(const std::vector<unsigned int> &facets,
-            const std::vector<QVector3D> &vertices,
-            const ModelDefinition_t &modelDefinition) override;
+  static void draw(const RenderFrame_t &frame);
 };
 
 /**
  * @brief Класс, отрисовывающий ребра с измененной толщиной
  */
-class DrawFacetThick : public Draw {
+class DrawFacetThick {
+ public:
+  static void draw(const RenderFrame_t &frame);
+};
+
+/**
+ * @brief Класс, отрисовывающий ребра с обычной толщиной из буферов
+ */
+class DrawFacetBuffer {
  public:
-  void draw(const std::vector<unsigned int> &facets,
-            const std::vector<QVector3D> &vertices,
-            const ModelDefinition_t &modelDefinition) override;
+  static void draw(const RenderFrame_t &frame);
+};
+
+/**
+ * @brief Класс, отрисовывающий ребра с измененной толщиной шейдером
+ */
+class DrawFacetShader {
+ public:
+  static void draw(const RenderFrame_t &frame);
+};
+
+/**
+ * @brief Класс, отрисовывающий упрощенный набор ребер во время вращения
+ */
+class DrawFacetLod {
+ public:
+  static void draw(const RenderFrame_t &frame);
 };
 
 /**
  * @brief Класс, отрисовывающий вершины в форме квадрата
  */
-class DrawVerticeSquare : public Draw {
+class DrawVerticeSquare {
  public:
-  void draw(const std::vector<unsigned int> &facets,
-            const std::vector<QVector3D> &vertices,
-            const ModelDefinition_t &modelDefinition) override;
+  static void draw(const RenderFrame_t &frame);
 };
 
 /**
  * @brief Класс, отрисовывающий вершины в форме круга
  */
-class DrawVerticeCircle : public Draw {
+class DrawVerticeCircle {
+ public:
+  static void draw(const RenderFrame_t &frame);
+};
+
+/**
+ * @brief Класс, отрисовывающий вершины в форме квадрата из буфера
+ */
+class DrawVerticeBuffer {
+ public:
+  static void draw(const RenderFrame_t &frame);
+};
+
+/**
+ * @brief Класс, отрисовывающий вершины точечными спрайтами
+ */
+class DrawVerticeSprite {
+ public:
+  static void draw(const RenderFrame_t &frame);
+};
+
+/**
+ * @brief Класс для режима без отрисовки вершин
+ */
+class DrawVerticeNone {
+ public:
+  static void draw(const RenderFrame_t &) {}
+};
+
+/**
+ * @brief Проход отрисовки модели, собранный из режима ребер и режима вершин
+ */
+class RenderPass {
+ public:
+  virtual ~RenderPass() = default;
+  virtual void draw(const RenderFrame_t &frame) = 0;
+};
+
+/**
+ * @brief Проход отрисовки для конкретной пары режимов
+ *
+ * Режимы подставляются на этапе компиляции, поэтому внутри прохода нет ни
+ * ветвлений по стилю, ни виртуальных вызовов.
+ */
+template <typename FacetDraw, typename VerticeDraw>
+class StyledRenderPass : public RenderPass {
  public:
-  void draw(const std::vector<unsigned int> &facets,
-            const std::vector<QVector3D> &vertices,
-            const ModelDefinition_t &modelDefinition) override;
+  void draw(const RenderFrame_t &frame) override {
+    const ModelDefinition_t &definition = *frame.modelDefinition;
+    if (frame.drawEdges) {
+      glColor3f(definition.facetColor.redF(), definition.facetColor.greenF(),
+                definition.facetColor.blueF());
+      FacetDraw::draw(frame);
+    }
+    if (frame.drawVertices) {
+      glColor3f(definition.verticeColor.redF(),
+                definition.verticeColor.greenF(),
+                definition.verticeColor.blueF());
+      VerticeDraw::draw(frame);
+    }
+  }
 };
 
+/**
+ * @brief Класс отрисовки из буферов видеопамяти (VBO/IBO)
+ *
+ * Вершины и ребра загружаются в видеопамять один раз для каждого поколения
+ * сетки и рисуются одним вызовом glDrawElements/glDrawArrays. Толстые ребра
+ * рисуются экземплярами отрезков, которые вершинный шейдер разворачивает в
+ * четырехугольники заданной ширины в пикселях, а маркеры вершин - точечными
+ * спрайтами из того же буфера вершин. Если буферы или шейдеры создать не
+ * удалось, используются режимы отрисовки glBegin/glEnd.
+ */
+class RetainedRenderer : protected QOpenGLExtraFunctions {
+ public:
+  RetainedRenderer();
+
+  bool initialize();
+  void destroy();
+  bool isValid() const;
+  bool hasThickLines() const;
+  bool hasPointSprites() const;
+  void upload(const std::vector<QVector3D> &vertices,
+              const std::vector<unsigned int> &edges,
+              unsigned long long generation);
+  void uploadLod(const std::vector<unsigned int> &lodEdges,
+                 unsigned long long revision);
+  void uploadCulledEdges(const std::vector<unsigned int> &kept);
+  void clearCulledEdges();
+  void drawEdges(const std::vector<EdgeRange_t> &ranges);
+  void drawLodEdges();
+  void drawVertices(float pointSize);
+  void drawThickEdges(const std::vector<EdgeRange_t> &ranges,
+                      const QMatrix4x4 &mvp, const QSizeF &viewport,
+                      float lineWidth, const QColor &color);
+  void drawMarkers(const QMatrix4x4 &mvp, float pointSize,
+                   VerticeType_t verticeType, const QColor &color);
+
+ private:
+  void bindVertices();
+  void releaseVertices();
+  static bool shadersSupported();
+  bool initializeThickLines();
+  bool initializePointSprites();
+
+  QOpenGLBuffer vertexBuffer;
+  QOpenGLBuffer indexBuffer;
+  QOpenGLBuffer lodIndexBuffer;
+  QOpenGLBuffer culledIndexBuffer;
+  QOpenGLBuffer cornerBuffer;
+  QOpenGLBuffer segmentBuffer;
+  QOpenGLShaderProgram thickLineProgram;
+  bool thickLinesReady = false;
+  QOpenGLShaderProgram pointSpriteProgram;
+  bool pointSpritesReady = false;
+  int vertexCount = 0;
+  int indexCount = 0;
+  unsigned long long uploadedGeneration = 0;
+  bool uploaded = false;
+  int lodIndexCount = 0;
+  unsigned long long uploadedLodRevision = 0;
+  bool lodUploaded = false;
+  bool culledActive = false;
+};
+
+class Command;
+class CommandHistory;
+
 /**
  * @brief Класс виджета OpenGL
  */
@@ -66,31 +212,147 @@ class OpenGLWidget : public QOpenGLWidget, protected QOpenGLFunctions {
   OpenGLWidget(ViewerController *Controller);
   ~OpenGLWidget();
 
+  void setFrameBudget(int milliseconds);
+  const FrameStats_t &frameStats() const;
+  void requestUpdate();
+  void setCommandHistory(CommandHistory *history);
+  void setRetainedRendering(bool enabled);
+  RenderBenchmark_t benchmark(int frames);
+  void renderFrame();
+  void setLodBudget(size_t edges);
+  size_t lodBudget() const;
+  void setLodIdleTimeout(int milliseconds);
+  void setSubPixelCulling(bool enabled);
+  void setSubPixelThreshold(float pixels);
+  float subPixelThreshold() const;
+  void setProgressiveRendering(bool enabled);
+  void setProgressiveBudget(int milliseconds);
+  void startCapture(FrameRing *ring, int fps);
+  void stopCapture();
+
+  static constexpr size_t kProgressiveSlice = 65536;
+
  private:
   void initializeGL() override;
   void resizeGL(int w, int h) override;
   void paintGL() override;
-  void drawStrategy(Draw *strategy, const std::vector<unsigned int> &facets,
-                    const std::vector<QVector3D> &vertices,
-                    const ModelDefinition_t &modelDefinition);
+  void buildRenderPass();
 
   void mousePressEvent(QMouseEvent *event) override;
   void mouseMoveEvent(QMouseEvent *event) override;
+  void mouseReleaseEvent(QMouseEvent *event) override;
   void wheelEvent(QWheelEvent *event) override;
+  void finishWheelGesture();
+  void scheduleFrame();
+  void onFrameSwapped();
+  void applyPendingInput();
+  void runCommand(std::unique_ptr<Command> command);
+  void beginInteractionLod();
+  int selectLodLevel(const QMatrix4x4 &mvp, const QSizeF &viewport);
+  int budgetLodLevel();
+  void drawProgressive(bool modelChanged, const QElapsedTimer &paintClock);
+  void readbackFrame();
+  void collectCapture(int index);
+  void deliverCapture(const QImage &frame);
   ViewerController *viewer_controller;
+  CommandHistory *history_ = nullptr;
   QPoint lastMousePos;
 
-  Draw *draw_;
+  // ввод, накопленный между кадрами
+  QPoint pendingRotate;
+  QPoint pendingRoll;
+  int pendingWheelSteps = 0;
+  int pendingEvents = 0;
+  // прокрутка колесика до паузы занимает одну запись истории
+  bool wheelGesture = false;
+
+  // темп кадров
+  QTimer frameTimer;
+  QElapsedTimer frameClock;
+  int frameBudgetMs = 16;
+  bool frameInFlight = false;
+  FrameStats_t stats;
+
+  // состояние, полученное из модели при последнем изменении
+  ModelDefinition_t modelDefinition_;
+  QMatrix4x4 projectionMatrix;
+  bool needsRedraw = true;
+
+  RetainedRenderer retained;
+  bool retainedEnabled = true;
+
+  // проход отрисовки пересобирается только при смене стиля
+  std::unique_ptr<RenderPass> renderPass;
+  RenderFrame_t frame_;
+  std::vector<EdgeRange_t> visibleRanges;
+
+  // упрощенная отрисовка во время вращения мышью
+  std::unique_ptr<RenderPass> lodPass;
+  QTimer lodIdleTimer;
+  int lodIdleMs = 300;
+  size_t lodBudget_ = ViewerModel::kDefaultLodBudget;
+  bool interacting = false;
+
+  // упрощенные сетки, выбираемые по размеру модели на экране; пока цепочка
+  // строится в фоне, таймер проверяет ее готовность
+  RetainedRenderer levelRenderer;
+  QTimer lodChainTimer;
+  std::vector<EdgeRange_t> levelRanges;
+
+  // отсечение ребер короче порога в пикселях
+  bool subPixelCulling = false;
+  float subPixelThreshold_ = 1.0f;
+  std::vector<unsigned int> keptEdges;
+  std::vector<EdgeRange_t> keptRanges;
+  // состояние, для которого отобраны и загружены keptEdges
+  bool culledValid = false;
+  QMatrix4x4 culledMvp;
+  QSizeF culledViewport;
+  float culledThreshold = 0.0f;
+  unsigned long long culledGeneration = 0;
+  long long culledCount = 0;
+
+  // прогрессивная отрисовка: ребра накапливаются во внеэкранном буфере
+  // частями, умещающимися в бюджет кадра
+  bool progressiveEnabled = false;
+  int progressiveBudgetMs = 12;
+  std::unique_ptr<QOpenGLFramebufferObject> accumulation;
+  std::vector<EdgeRange_t> sliceRanges;
+  size_t progressiveCursor = 0;
+  const std::vector<EdgeRange_t> *progressiveRanges = nullptr;
+  size_t progressiveTotal = 0;
+  int progressiveLevel = -1;
+  const RetainedRenderer *progressiveSource = nullptr;
+  bool progressiveVertices = false;
+  bool refineRequested = false;
+
+  // захват кадров по таймеру: кадр копируется в один из двух буферов
+  // пикселей, а забирается из него на следующем тике, когда копирование
+  // уже завершено и отображение буфера не ждет видеокарту
+  QTimer captureTimer;
+  FrameRing *captureRing = nullptr;
+  bool captureRequested = false;
+  QOpenGLBuffer captureBuffers[2] = {
+      QOpenGLBuffer(QOpenGLBuffer::PixelPackBuffer),
+      QOpenGLBuffer(QOpenGLBuffer::PixelPackBuffer)};
+  QSize captureSizes[2];
+  bool capturePending[2] = {false, false};
+  int captureIndex = 0;
 };
 
 /**
  * @brief Класс, реализующий паттерн команда для афинных преобразований и
  * изменения вершин и ребер
+ *
+ * Команда хранит только приращение, которое она внесла в модель, поэтому
+ * отмена выполняется без снимков AffineTransform и ModelDefinition.
  */
 class Command {
  public:
   virtual ~Command() = default;
   virtual void execute() = 0;
+  virtual void undo() = 0;
+  virtual bool mergeWith(const Command &next);
 };
 
 /**
@@ -101,6 +363,8 @@ class TranslateCommand : public Command {
   TranslateCommand(ViewerController *controller, float value,
                    translateAction_t translateAction);
   void execute() override;
+  void undo() override;
+  bool mergeWith(const Command &next) override;
 
  private:
   ViewerController *controller_;
@@ -116,6 +380,8 @@ class RotateCommand : public Command {
   RotateCommand(ViewerController *controller, float value,
                 rotateAction_t rotateAction);
   void execute() override;
+  void undo() override;
+  bool mergeWith(const Command &next) override;
 
  private:
   ViewerController *controller_;
@@ -123,19 +389,44 @@ class RotateCommand : public Command {
   rotateAction_t rtAction;
 };
 
+/**
+ * @brief Класс, отвечающий за вращение мышью
+ *
+ * Хранит суммарный поворот перетаскивания в виде кватерниона, поэтому все
+ * перемещения мыши за одно перетаскивание занимают одну запись истории.
+ */
+class MouseRotateCommand : public Command {
+ public:
+  MouseRotateCommand(ViewerController *controller, const QQuaternion &rotation,
+                     const QVector3D &angles);
+  void execute() override;
+  void undo() override;
+  bool mergeWith(const Command &next) override;
+
+ private:
+  ViewerController *controller_;
+  QQuaternion rotation_;
+  QVector3D angles_;
+};
+
 /**
  * @brief Класс, отвечающий за масштабирование модели
  */
 class ScaleCommand : public Command {
  public:
   ScaleCommand(ViewerController *controller, float scaleValue,
-               const ScaleType_t &scaleF);
+               const ScaleType_t &scaleF, int steps = 1);
   void execute() override;
+  void undo() override;
+  bool mergeWith(const Command &next) override;
 
  private:
   ViewerController *controller_;
   float sclValue;
   const ScaleType_t sclF;
+  int steps_;
+  float scaleDelta = 0.0f;  // фактическое изменение с учетом ограничений
+  float fovDelta = 0.0f;
 };
 
 /**
@@ -145,10 +436,13 @@ class ChangeFacetColorCommand : public Command {
  public:
   ChangeFacetColorCommand(ViewerController *controller, QColor color);
   void execute() override;
+  void undo() override;
+  bool mergeWith(const Command &next) override;
 
  private:
   ViewerController *controller_;
   QColor color_;
+  QColor previousColor_;
 };
 
 /**
@@ -158,10 +452,12 @@ class ChangeFacetWidthCommand : public Command {
  public:
   ChangeFacetWidthCommand(ViewerController *controller, ScaleType_t scaleType);
   void execute() override;
+  void undo() override;
 
  private:
   ViewerController *controller_;
   ScaleType_t scaleType_;
+  float widthDelta = 0.0f;
 };
 
 /**
@@ -171,10 +467,13 @@ class ChangeVerticeColorCommand : public Command {
  public:
   ChangeVerticeColorCommand(ViewerController *controller, QColor color);
   void execute() override;
+  void undo() override;
+  bool mergeWith(const Command &next) override;
 
  private:
   ViewerController *controller_;
   QColor color_;
+  QColor previousColor_;
 };
 
 /**
@@ -185,10 +484,235 @@ class ChangeVerticeWidthCommand : public Command {
   ChangeVerticeWidthCommand(ViewerController *controller,
                             ScaleType_t scaleType);
   void execute() override;
+  void undo() override;
 
  private:
   ViewerController *controller_;
   ScaleType_t scaleType_;
+  float widthDelta = 0.0f;
+};
+
+/**
+ * @brief Класс, отвечающий за смену типа проекции
+ */
+class ChangeProjectionCommand : public Command {
+ public:
+  ChangeProjectionCommand(ViewerController *controller,
+                          ProjectionType_t projectionType);
+  void execute() override;
+  void undo() override;
+
+ private:
+  ViewerController *controller_;
+  ProjectionType_t projectionType_;
+  ProjectionType_t previousType_ = Parallel;
+};
+
+/**
+ * @brief Класс, отвечающий за смену типа вершин
+ */
+class ChangeVerticeTypeCommand : public Command {
+ public:
+  ChangeVerticeTypeCommand(ViewerController *controller,
+                           VerticeType_t verticeType);
+  void execute() override;
+  void undo() override;
+
+ private:
+  ViewerController *controller_;
+  VerticeType_t verticeType_;
+  VerticeType_t previousType_ = Square;
+};
+
+/**
+ * @brief Класс, отвечающий за установку цвета фона
+ */
+class ChangeBackgroundColorCommand : public Command {
+ public:
+  ChangeBackgroundColorCommand(ViewerController *controller, QColor color);
+  void execute() override;
+  void undo() override;
+  bool mergeWith(const Command &next) override;
+
+ private:
+  ViewerController *controller_;
+  QColor color_;
+  QColor previousColor_;
+};
+
+/**
+ * @brief Класс истории команд для отмены и повтора
+ *
+ * История ограничена по числу записей: при переполнении удаляется самая
+ * старая. Во время непрерывного взаимодействия (перетаскивание мышью)
+ * команды сливаются в одну запись.
+ */
+class CommandHistory {
+ public:
+  explicit CommandHistory(std::size_t capacity = 100);
+
+  void push(std::unique_ptr<Command> command);
+  bool undo();
+  bool redo();
+  void clear();
+  void beginInteraction();
+  void endInteraction();
+  bool inInteraction() const;
+  std::size_t size() const;
+
+ private:
+  std::deque<std::unique_ptr<Command>> undoStack;
+  std::vector<std::unique_ptr<Command>> redoStack;
+  std::size_t capacity_;
+  bool interactionActive = false;
+  bool interactionHasEntry = false;
+};
+
+/**
+ * @brief Программный растеризатор каркаса модели
+ *
+ * Ребра и вершины проецируются на экран и распределяются по квадратным
+ * плиткам; плитки растеризуются параллельно, каждая в свою часть
+ * изображения и буфера глубины, поэтому потокам не нужна синхронизация.
+ * Изображение имеет тот же формат, что и QOpenGLWidget::grabFramebuffer.
+ * Сглаженные ребра рисуются по покрытию пикселей (для толщины 1 - как в
+ * алгоритме Ву, включая концы ребер). Если процессор поддерживает AVX2,
+ * ребро обрабатывается блоками по 8 пикселей: расчет шагов, проверка
+ * глубины и смешивание выполняются векторными командами.
+ */
+class SoftwareRenderer {
+ public:
+  static constexpr int kTileSize = 64;
+
+  void setAntialiasing(bool enabled);
+  void setVectorized(bool enabled);
+  void setParallel(bool enabled);
+  QImage render(const std::vector<QVector3D> &vertices,
+                const std::vector<unsigned int> &edges, const QMatrix4x4 &mvp,
+                const ModelDefinition_t &definition, const QSize &size);
+
+ private:
+  void projectVertices(const std::vector<QVector3D> &vertices,
+                       const QMatrix4x4 &mvp);
+  void setupSegments(const std::vector<unsigned int> &edges);
+  void binPrimitives(size_t edgeCount, size_t pointCount);
+  void rasterizeTile(int tile);
+  void drawSegment(const float *segment, const QRect &rect);
+  void drawSmoothSegment(const float *segment, const QRect &rect);
+  void drawPoint(const float *point, const QRect &rect);
+  void plot(int x, int y, float z, QRgb color);
+  template <typename Function>
+  void forRange(size_t count, size_t minChunk, Function function) {
+    if (parallel)
+      parallelFor(count, minChunk, function);
+    else
+      function(size_t(0), count);
+  }
+
+  int width = 0, height = 0;
+  int tilesX = 0, tilesY = 0;
+  float lineWidth = 1.0f;
+  float pointSize = 0.0f;
+  VerticeType_t verticeType = None;
+  QRgb facetColor = 0, verticeColor = 0;
+  bool antialiasing = false;
+  bool vectorized = true;
+  bool parallel = true;
+  uchar *pixels = nullptr;
+  qsizetype stride = 0;
+
+  std::vector<float> clip;      // x, y, z, w вершин после проекции
+  std::vector<float> points;    // x, y, z вершин на экране
+  std::vector<float> segments;  // x0, y0, z0, x1, y1, z1 ребер на экране
+  std::vector<unsigned int> edgeBinStart, edgeBins;
+  std::vector<unsigned int> pointBinStart, pointBins;
+  std::vector<float> depth;
+};
+
+/**
+ * @brief Отрисовка модели в изображение без окна
+ *
+ * Кадр рисуется теми же проходами, что и в OpenGLWidget, в буфер кадра
+ * на QOffscreenSurface (на машинах без видеокарты - программным OpenGL
+ * Mesa). Если контекст OpenGL создать нельзя, используется
+ * SoftwareRenderer. Ролик с оборотом модели и кадр большого размера
+ * рисуются только SoftwareRenderer в фоновом потоке по копии модели.
+ */
+class OffscreenRenderer : protected QOpenGLFunctions {
+ public:
+  explicit OffscreenRenderer(ViewerController *controller);
+  ~OffscreenRenderer();
+
+  // наибольшая сторона плитки при отрисовке кадра по частям
+  static constexpr int kExportTile = 2048;
+  // наибольший размер полосы кадра в памяти при записи по частям
+  static constexpr qsizetype kExportBandBytes = 64 << 20;
+
+  QImage render(const AffineTransform_t &camera,
+                const ModelDefinition_t &style, const QSize &size);
+  QImage renderRegion(const AffineTransform_t &camera,
+                      const ModelDefinition_t &style, const QSize &fullSize,
+                      const QRect &region, int viewHeight);
+  bool lastFrameHardware() const;
+  static std::function<bool()> tiledExport(ViewerController *controller,
+                                           const QString &filePath,
+                                           const QSize &size, int viewHeight);
+  static std::function<bool()> turntableExport(
+      ViewerController *controller, const QString &filePath,
+      const TurntableSettings_t &settings);
+
+ private:
+  bool initialize();
+  static QMatrix4x4 regionProjection(const AffineTransform_t &camera,
+                                     const QSize &fullSize,
+                                     const QRect &region);
+  static ModelDefinition_t regionStyle(const ModelDefinition_t &style,
+                                       const QSize &fullSize,
+                                       const QRect &region, int viewHeight);
+  static bool writeTiled(const QString &filePath, const QSize &size,
+                         const std::vector<QVector3D> &vertices,
+                         const std::vector<unsigned int> &edges,
+                         const AffineTransform_t &transform,
+                         const ModelDefinition_t &definition, int viewHeight);
+  static bool writeTurntable(const QString &filePath,
+                             const TurntableSettings_t &settings,
+                             const std::vector<QVector3D> &vertices,
+                             const std::vector<unsigned int> &edges,
+                             const AffineTransform_t &transform,
+                             const ModelDefinition_t &definition);
+
+  ViewerController *controller_;
+  QOffscreenSurface surface;
+  QOpenGLContext context;
+  bool contextReady = false;
+  bool contextFailed = false;
+  bool lastHardware = false;
+  std::unique_ptr<QOpenGLFramebufferObject> target;
+  RetainedRenderer retained;
+  std::vector<EdgeRange_t> ranges;
+  std::vector<unsigned int> noEdges;
+  SoftwareRenderer software;
+};
+
+/**
+ * @brief Фоновые задачи окна с отчетом в потоке интерфейса
+ *
+ * Задачи выполняются в собственном пуле потоков, результат передается
+ * функции done очередью событий этого объекта. Деструктор дожидается
+ * всех задач, поэтому после удаления владельца ни задача, ни отчет не
+ * обращаются к нему.
+ */
+class BackgroundTasks : public QObject {
+ public:
+  ~BackgroundTasks();
+
+  void start(std::function<bool()> task, std::function<void(bool)> done);
+  int pending() const;
+  void waitForDone();
+
+ private:
+  QThreadPool pool;
+  int pendingTasks = 0;
 };
 
 /**
@@ -200,6 +724,10 @@ class MainWindow : public QMainWindow {
   MainWindow(ViewerController *Controller);
   ~MainWindow();
 
+  RenderBenchmark_t benchmarkRendering(const QString &filePath, int frames);
+  static QStringList imageSavePaths(QString basePath,
+                                    const QStringList &formats);
+
  private:
   void part1Buttons();
   void part2Buttons();
@@ -209,7 +737,11 @@ class MainWindow : public QMainWindow {
   void initializeConnections2();
 
   void saveImage();
-  void recordGif();
+  void toggleRecording();
+  void finishRecording();
+  bool stopRecording();
+  bool readGifSettings(QSize &size, int &fps);
+  void exportTurntable();
   void fileOpenButton();
   void defaultModel();
   void setProjection(const ProjectionType_t &projectionType);
@@ -223,10 +755,17 @@ class MainWindow : public QMainWindow {
   void scale(QLineEdit *input, ScaleType_t scaleType);
 
   void executeCommand(std::unique_ptr<Command> command);
+  void flushCommands();
+  void undoCommand();
+  void redoCommand();
   void changeFacetColor();
   void changeFacetWidth(ScaleType_t scaleType);
   void changeVerticeColor();
   void changeVerticeWidth(ScaleType_t scaleType);
+  void setLodBudget();
+  void setSubPixelThreshold();
+  void exportLod();
+  void exportLargeImage();
 
   QButtonGroup *groupVertices;
   QHBoxLayout *layout;
@@ -259,8 +798,27 @@ class MainWindow : public QMainWindow {
   QPushButton *buttonVerticeMinus;
   QPushButton *buttonBackGroundColor;
   QPushButton *buttonSaveImage;
-  QPushButton *buttonRecordGif;
+  QPushButton *buttonRecord;
+  QLineEdit *gifSettingsInput;
+  QPushButton *buttonTurntable;
+  // запись: таймер виджета -> кольцевой буфер -> поток -> кодировщик
+  std::unique_ptr<FrameRing> captureRing;
+  std::unique_ptr<FrameSink> recorder;
+  std::thread captureDrain;
+  QString recordingPath;
+  QTimer recordingTimer;
+  QPushButton *buttonExportLarge;
+  QCheckBox *saveBmpCheck;
+  QCheckBox *saveJpegCheck;
+  QCheckBox *savePngCheck;
+  QCheckBox *saveWebpCheck;
+  BackgroundTasks imageSaves;
+  BackgroundTasks turntableExports;
+  BackgroundTasks largeExports;
+  QPushButton *buttonExportLod;
   QPushButton *buttonDefault;
+  QPushButton *buttonUndo;
+  QPushButton *buttonRedo;
   QPushButton *buttonTranslateX_p;
   QPushButton *buttonTranslateX_m;
   QPushButton *buttonTranslateY_p;
@@ -286,9 +844,17 @@ class MainWindow : public QMainWindow {
   QLineEdit *rotateYInput;
   QLineEdit *rotateZInput;
   QLineEdit *scaleInput;
+  QLineEdit *lodBudgetInput;
+  QLineEdit *subPixelInput;
+  QCheckBox *progressiveCheck;
   QColor currentFacetColor;
   QColor currentVerticeColor;
   QColor currentBackGroundColor;
+
+  // команды, накопленные до следующего кадра
+  std::vector<std::unique_ptr<Command>> commandQueue;
+  bool flushScheduled = false;
+  CommandHistory history;
 };
 
 }  // namespace s21